@@ -11,6 +11,8 @@
 #define KLEE_IMMUTABLETREE_H
 
 #include <cassert>
+#include <cstddef>
+#include <utility>
 #include <vector>
 
 namespace klee {
@@ -28,9 +30,11 @@ namespace klee {
   public:
     ImmutableTree();
     ImmutableTree(const ImmutableTree &s);
+    ImmutableTree(ImmutableTree &&s);
     ~ImmutableTree();
 
     ImmutableTree &operator=(const ImmutableTree &s);
+    ImmutableTree &operator=(ImmutableTree &&s);
 
     bool empty() const;
 
@@ -435,9 +439,17 @@ namespace klee {
     : node(s.node->incref()) {
   }
 
+  // A moved-from tree holds no node, so temporaries returned by insert
+  // and friends hand their reference over instead of touching the count.
+  template<class K, class V, class KOV, class CMP>
+  ImmutableTree<K,V,KOV,CMP>::ImmutableTree(ImmutableTree &&s) 
+    : node(s.node) {
+    s.node = 0;
+  }
+
   template<class K, class V, class KOV, class CMP>
   ImmutableTree<K,V,KOV,CMP>::~ImmutableTree() {
-    node->decref(); 
+    if (node) node->decref(); 
   }
 
   template<class K, class V, class KOV, class CMP>
@@ -448,6 +460,12 @@ namespace klee {
     return *this;
   }
 
+  template<class K, class V, class KOV, class CMP>
+  ImmutableTree<K,V,KOV,CMP> &ImmutableTree<K,V,KOV,CMP>::operator=(ImmutableTree &&s) {
+    std::swap(node, s.node);
+    return *this;
+  }
+
   template<class K, class V, class KOV, class CMP>
   bool ImmutableTree<K,V,KOV,CMP>::empty() const {
     return node->isTerminator();
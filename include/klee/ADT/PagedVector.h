@@ -0,0 +1,205 @@
+//===-- PagedVector.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PAGEDVECTOR_H
+#define KLEE_PAGEDVECTOR_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace klee {
+
+/// A vector split into fixed-size pages that are shared between copies.
+///
+/// Copying a PagedVector only copies the page pointers. A page is cloned
+/// the first time it is modified through a vector that shares it, so the
+/// memory held by a copy grows with the number of pages it writes to
+/// rather than with its size.
+///
+/// Every page but the last one holds ElementsPerPage elements, the last
+/// one only holds the remaining elements. A vector shorter than a page
+/// thus takes about as much memory as a plain array.
+template <typename T, size_t PageBytes = 4096> class PagedVector {
+public:
+  static constexpr size_t ElementsPerPage =
+      PageBytes >= sizeof(T) ? PageBytes / sizeof(T) : 1;
+
+private:
+  typedef std::vector<T> Page;
+
+  std::vector<std::shared_ptr<Page>> pages;
+  size_t _size = 0;
+
+  static size_t pageCount(size_t size) {
+    return (size + ElementsPerPage - 1) / ElementsPerPage;
+  }
+
+  /// Returns the page containing element n, cloning it if it is shared.
+  Page &getWriteablePage(size_t n) {
+    std::shared_ptr<Page> &page = pages[n / ElementsPerPage];
+    if (page.use_count() > 1)
+      page = std::make_shared<Page>(*page);
+    return *page;
+  }
+
+  /// Resize the last page to count elements, new elements are initialized
+  /// to value.
+  void resizeLastPage(size_t count, const T &value) {
+    std::shared_ptr<Page> &page = pages.back();
+    if (page->size() == count)
+      return;
+    if (page.use_count() > 1) {
+      auto copy = std::make_shared<Page>();
+      copy->reserve(count);
+      copy->assign(page->begin(),
+                   page->begin() + std::min(count, page->size()));
+      page = std::move(copy);
+    } else if (count > page->capacity()) {
+      // grow geometrically, but never beyond a full page
+      page->reserve(
+          std::min(ElementsPerPage, std::max(count, 2 * page->capacity())));
+    }
+    page->resize(count, value);
+  }
+
+public:
+  PagedVector() = default;
+  explicit PagedVector(size_t size, const T &value = T()) {
+    resize(size, value);
+  }
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+
+  const T &operator[](size_t n) const {
+    assert(n < _size && "PagedVector index out of range");
+    return (*pages[n / ElementsPerPage])[n % ElementsPerPage];
+  }
+
+  void set(size_t n, const T &value) {
+    assert(n < _size && "PagedVector index out of range");
+    getWriteablePage(n)[n % ElementsPerPage] = value;
+  }
+
+  /// Resize to n elements, new elements are initialized to value.
+  void resize(size_t n, const T &value = T()) {
+    if (n <= _size) {
+      pages.resize(pageCount(n));
+      if (!pages.empty())
+        resizeLastPage(n - (pages.size() - 1) * ElementsPerPage, value);
+      _size = n;
+      return;
+    }
+
+    if (!pages.empty()) {
+      size_t first = (pages.size() - 1) * ElementsPerPage;
+      resizeLastPage(std::min(ElementsPerPage, n - first), value);
+    }
+    while (pages.size() < pageCount(n)) {
+      size_t first = pages.size() * ElementsPerPage;
+      pages.push_back(
+          std::make_shared<Page>(std::min(ElementsPerPage, n - first), value));
+    }
+    _size = n;
+  }
+
+  void clear() {
+    pages.clear();
+    _size = 0;
+  }
+
+  /// Approximate number of bytes of heap memory held by the vector,
+  /// including pages shared with copies.
+  size_t getStorageBytes() const {
+    size_t bytes = pages.capacity() * sizeof(std::shared_ptr<Page>);
+    for (const auto &page : pages)
+      bytes += sizeof(Page) + page->capacity() * sizeof(T);
+    return bytes;
+  }
+
+  /// Copy all elements to the array at dst.
+  void copyTo(T *dst) const {
+    for (size_t i = 0; i < pages.size(); ++i)
+      std::copy(pages[i]->begin(), pages[i]->end(), dst + i * ElementsPerPage);
+  }
+
+  /// Overwrite all elements with the array at src. Pages whose contents
+  /// do not change are not cloned.
+  void assign(const T *src) {
+    for (size_t i = 0; i < pages.size(); ++i) {
+      size_t count = pages[i]->size();
+      const T *from = src + i * ElementsPerPage;
+      if (std::equal(from, from + count, pages[i]->begin()))
+        continue;
+      Page &page = getWriteablePage(i * ElementsPerPage);
+      std::copy_n(from, count, page.begin());
+    }
+  }
+
+  /// Compare all elements with the array at other.
+  bool equals(const T *other) const {
+    for (size_t i = 0; i < pages.size(); ++i)
+      if (!std::equal(pages[i]->begin(), pages[i]->end(),
+                      other + i * ElementsPerPage))
+        return false;
+    return true;
+  }
+};
+
+/// A BitArray stored in shared pages, see PagedVector.
+class PagedBitArray {
+private:
+  PagedVector<uint32_t> bits;
+  unsigned _size = 0;
+
+  static size_t length(unsigned size) { return (size + 31) / 32; }
+
+public:
+  PagedBitArray() = default;
+  explicit PagedBitArray(unsigned size, bool value = false)
+      : bits(length(size), value ? 0xFFFFFFFF : 0), _size(size) {}
+
+  unsigned size() const { return _size; }
+
+  /// See PagedVector::getStorageBytes.
+  size_t getStorageBytes() const { return bits.getStorageBytes(); }
+
+  void resize(unsigned newSize, bool value = false) {
+    unsigned oldSize = _size;
+    bits.resize(length(newSize), value ? 0xFFFFFFFF : 0);
+    _size = newSize;
+    // bits of the last old word beyond the old size are undefined
+    for (unsigned i = oldSize; i < newSize && i % 32; i++)
+      set(i, value);
+  }
+
+  bool get(unsigned idx) const {
+    return (bool)((bits[idx / 32] >> (idx & 0x1F)) & 1);
+  }
+  void set(unsigned idx) {
+    bits.set(idx / 32, bits[idx / 32] | (1 << (idx & 0x1F)));
+  }
+  void unset(unsigned idx) {
+    bits.set(idx / 32, bits[idx / 32] & ~(1 << (idx & 0x1F)));
+  }
+  void set(unsigned idx, bool value) {
+    if (value)
+      set(idx);
+    else
+      unset(idx);
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_PAGEDVECTOR_H */
@@ -0,0 +1,352 @@
+//===-- PersistentHashMap.h -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PERSISTENTHASHMAP_H
+#define KLEE_PERSISTENTHASHMAP_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+/// An immutable map implemented as a hash array mapped trie.
+///
+/// Offers the lookup/insert/replace/remove subset of ImmutableMap's
+/// interface with the same sharing semantics: updates return a new map
+/// that shares all untouched nodes with the old one. Each trie level
+/// consumes 5 bits of the key's hash, so lookups visit a handful of
+/// small nodes instead of a path through a balanced binary tree.
+/// Iteration order is unspecified.
+template <class K, class D, class Hash = std::hash<K>,
+          class Equal = std::equal_to<K>>
+class PersistentHashMap {
+public:
+  typedef K key_type;
+  typedef std::pair<K, D> value_type;
+
+private:
+  static const unsigned BitsPerLevel = 5;
+  static const unsigned HashBits = sizeof(size_t) * 8;
+
+  struct Node;
+  typedef std::shared_ptr<const Node> NodePtr;
+
+  /// A trie node. Values and children are indexed by the population
+  /// count of the corresponding bitmap below their hash fragment. Once
+  /// all hash bits are consumed, a node is a collision node and keeps
+  /// its values in a plain list.
+  struct Node {
+    uint32_t valueMap = 0;
+    uint32_t childMap = 0;
+    std::vector<value_type> values;
+    std::vector<NodePtr> children;
+  };
+
+  NodePtr root;
+  size_t elements = 0;
+
+  PersistentHashMap(NodePtr root, size_t elements)
+      : root(std::move(root)), elements(elements) {}
+
+  static size_t hashOf(const key_type &key) { return Hash()(key); }
+
+  static uint32_t bitFor(size_t hash, unsigned shift) {
+    return 1u << ((hash >> shift) & 31);
+  }
+
+  static unsigned indexOf(uint32_t map, uint32_t bit) {
+    return __builtin_popcount(map & (bit - 1));
+  }
+
+  static bool isCollisionLevel(unsigned shift) { return shift >= HashBits; }
+
+  /// Build a subtrie holding exactly two values with distinct keys.
+  static NodePtr mergeValues(const value_type &a, size_t hashA,
+                             const value_type &b, size_t hashB,
+                             unsigned shift) {
+    auto node = std::make_shared<Node>();
+    if (isCollisionLevel(shift)) {
+      node->values = {a, b};
+      return node;
+    }
+    uint32_t bitA = bitFor(hashA, shift), bitB = bitFor(hashB, shift);
+    if (bitA == bitB) {
+      node->childMap = bitA;
+      node->children.push_back(
+          mergeValues(a, hashA, b, hashB, shift + BitsPerLevel));
+    } else {
+      node->valueMap = bitA | bitB;
+      if (bitA < bitB)
+        node->values = {a, b};
+      else
+        node->values = {b, a};
+    }
+    return node;
+  }
+
+  static NodePtr insert(const NodePtr &node, const value_type &value,
+                        size_t hash, unsigned shift, bool overwrite,
+                        bool &added) {
+    if (isCollisionLevel(shift)) {
+      for (size_t i = 0; i < node->values.size(); ++i) {
+        if (Equal()(node->values[i].first, value.first)) {
+          if (!overwrite)
+            return node;
+          auto copy = std::make_shared<Node>(*node);
+          copy->values[i] = value;
+          return copy;
+        }
+      }
+      auto copy = std::make_shared<Node>(*node);
+      copy->values.push_back(value);
+      added = true;
+      return copy;
+    }
+
+    uint32_t bit = bitFor(hash, shift);
+    if (node->valueMap & bit) {
+      unsigned index = indexOf(node->valueMap, bit);
+      const value_type &existing = node->values[index];
+      if (Equal()(existing.first, value.first)) {
+        if (!overwrite)
+          return node;
+        auto copy = std::make_shared<Node>(*node);
+        copy->values[index] = value;
+        return copy;
+      }
+      // push both values one level down
+      NodePtr child = mergeValues(existing, hashOf(existing.first), value,
+                                  hash, shift + BitsPerLevel);
+      auto copy = std::make_shared<Node>(*node);
+      copy->values.erase(copy->values.begin() + index);
+      copy->valueMap &= ~bit;
+      copy->childMap |= bit;
+      copy->children.insert(
+          copy->children.begin() + indexOf(copy->childMap, bit), child);
+      added = true;
+      return copy;
+    }
+
+    if (node->childMap & bit) {
+      unsigned index = indexOf(node->childMap, bit);
+      const NodePtr &child = node->children[index];
+      NodePtr newChild =
+          insert(child, value, hash, shift + BitsPerLevel, overwrite, added);
+      if (newChild == child)
+        return node;
+      auto copy = std::make_shared<Node>(*node);
+      copy->children[index] = newChild;
+      return copy;
+    }
+
+    auto copy = std::make_shared<Node>(*node);
+    copy->valueMap |= bit;
+    copy->values.insert(copy->values.begin() + indexOf(copy->valueMap, bit),
+                        value);
+    added = true;
+    return copy;
+  }
+
+  /// Returns the node without key, or nullptr if the node became empty.
+  static NodePtr remove(const NodePtr &node, const key_type &key, size_t hash,
+                        unsigned shift, bool &removed) {
+    if (isCollisionLevel(shift)) {
+      for (size_t i = 0; i < node->values.size(); ++i) {
+        if (Equal()(node->values[i].first, key)) {
+          removed = true;
+          if (node->values.size() == 1)
+            return nullptr;
+          auto copy = std::make_shared<Node>(*node);
+          copy->values.erase(copy->values.begin() + i);
+          return copy;
+        }
+      }
+      return node;
+    }
+
+    uint32_t bit = bitFor(hash, shift);
+    if (node->valueMap & bit) {
+      unsigned index = indexOf(node->valueMap, bit);
+      if (!Equal()(node->values[index].first, key))
+        return node;
+      removed = true;
+      if (node->values.size() == 1 && node->children.empty())
+        return nullptr;
+      auto copy = std::make_shared<Node>(*node);
+      copy->values.erase(copy->values.begin() + index);
+      copy->valueMap &= ~bit;
+      return copy;
+    }
+
+    if (node->childMap & bit) {
+      unsigned index = indexOf(node->childMap, bit);
+      const NodePtr &child = node->children[index];
+      NodePtr newChild = remove(child, key, hash, shift + BitsPerLevel, removed);
+      if (newChild == child)
+        return node;
+      auto copy = std::make_shared<Node>(*node);
+      if (!newChild) {
+        copy->children.erase(copy->children.begin() + index);
+        copy->childMap &= ~bit;
+        if (copy->values.empty() && copy->children.empty())
+          return nullptr;
+      } else if (newChild->children.empty() && newChild->values.size() == 1) {
+        // keep the trie canonical: inline children holding a single value
+        copy->children.erase(copy->children.begin() + index);
+        copy->childMap &= ~bit;
+        copy->valueMap |= bit;
+        copy->values.insert(copy->values.begin() +
+                                indexOf(copy->valueMap, bit),
+                            newChild->values.front());
+      } else {
+        copy->children[index] = newChild;
+      }
+      return copy;
+    }
+
+    return node;
+  }
+
+public:
+  class iterator {
+    friend class PersistentHashMap;
+
+    struct Frame {
+      const Node *node;
+      size_t value;
+      size_t child;
+    };
+    std::vector<Frame> stack;
+
+    explicit iterator(const Node *root) {
+      if (root) {
+        stack.push_back({root, 0, 0});
+        settle();
+      }
+    }
+
+    /// Move to the next position that holds a value.
+    void settle() {
+      while (!stack.empty()) {
+        Frame &top = stack.back();
+        if (top.value < top.node->values.size())
+          return;
+        if (top.child < top.node->children.size()) {
+          const Node *child = top.node->children[top.child++].get();
+          stack.push_back({child, 0, 0});
+          continue;
+        }
+        stack.pop_back();
+      }
+    }
+
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename PersistentHashMap::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const value_type *pointer;
+    typedef const value_type &reference;
+
+    iterator() = default;
+
+    reference operator*() const {
+      const Frame &top = stack.back();
+      return top.node->values[top.value];
+    }
+    pointer operator->() const { return &**this; }
+
+    iterator &operator++() {
+      assert(!stack.empty() && "incrementing end iterator");
+      ++stack.back().value;
+      settle();
+      return *this;
+    }
+
+    bool operator==(const iterator &b) const {
+      if (stack.empty() || b.stack.empty())
+        return stack.empty() == b.stack.empty();
+      return stack.back().node == b.stack.back().node &&
+             stack.back().value == b.stack.back().value;
+    }
+    bool operator!=(const iterator &b) const { return !(*this == b); }
+  };
+
+  PersistentHashMap() = default;
+
+  bool empty() const { return elements == 0; }
+  size_t size() const { return elements; }
+  size_t count(const key_type &key) const { return lookup(key) ? 1 : 0; }
+
+  const value_type *lookup(const key_type &key) const {
+    size_t hash = hashOf(key);
+    const Node *node = root.get();
+    for (unsigned shift = 0; node; shift += BitsPerLevel) {
+      if (isCollisionLevel(shift)) {
+        for (const value_type &value : node->values)
+          if (Equal()(value.first, key))
+            return &value;
+        return nullptr;
+      }
+      uint32_t bit = bitFor(hash, shift);
+      if (node->valueMap & bit) {
+        const value_type &value = node->values[indexOf(node->valueMap, bit)];
+        return Equal()(value.first, key) ? &value : nullptr;
+      }
+      if (!(node->childMap & bit))
+        return nullptr;
+      node = node->children[indexOf(node->childMap, bit)].get();
+    }
+    return nullptr;
+  }
+
+  /// Add value unless its key is already bound.
+  PersistentHashMap insert(const value_type &value) const {
+    return update(value, false);
+  }
+
+  /// Add value, replacing an existing binding of its key.
+  PersistentHashMap replace(const value_type &value) const {
+    return update(value, true);
+  }
+
+  PersistentHashMap remove(const key_type &key) const {
+    if (!root)
+      return *this;
+    bool removed = false;
+    NodePtr newRoot = remove(root, key, hashOf(key), 0, removed);
+    return PersistentHashMap(newRoot, removed ? elements - 1 : elements);
+  }
+
+  iterator begin() const { return iterator(root.get()); }
+  iterator end() const { return iterator(); }
+
+private:
+  PersistentHashMap update(const value_type &value, bool overwrite) const {
+    size_t hash = hashOf(value.first);
+    if (!root) {
+      auto node = std::make_shared<Node>();
+      node->valueMap = bitFor(hash, 0);
+      node->values.push_back(value);
+      return PersistentHashMap(node, 1);
+    }
+    bool added = false;
+    NodePtr newRoot = insert(root, value, hash, 0, overwrite, added);
+    return PersistentHashMap(newRoot, added ? elements + 1 : elements);
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_PERSISTENTHASHMAP_H */
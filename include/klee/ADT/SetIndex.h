@@ -0,0 +1,331 @@
+//===-- SetIndex.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SETINDEX_H
+#define KLEE_SETINDEX_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+/// A bounded map from sets of K to V that answers subset and superset
+/// queries without scanning the whole map.
+///
+/// Every distinct element is numbered and the entries are stored in a trie
+/// over the sorted numbers of their elements. A subset query walks only the
+/// trie paths made of elements of the key. For each element the index also
+/// lists the entries containing it, so a superset query only visits the
+/// entries containing the rarest element of the key. Once the map holds
+/// more entries than its capacity, the least recently used entries are
+/// dropped; entries returned by a lookup count as used.
+///
+/// Queries visit candidates in insertion order, so results do not depend
+/// on hashing.
+template <class K, class V, class Hash = std::hash<K>,
+          class Equal = std::equal_to<K>, class ValueHash = std::hash<V>>
+class SetIndex {
+  typedef uint32_t ElementId;
+  typedef uint64_t EntryId;
+  typedef std::vector<ElementId> ElementIds;
+
+  struct Entry;
+
+  /// Occurrence of an entry in the list of one of its elements
+  struct Posting {
+    Entry *entry;
+    /// Index of the element in entry->elements
+    std::size_t slot;
+  };
+
+  struct Element {
+    ElementId id;
+    /// Entries containing this element, in no particular order
+    std::vector<Posting> postings;
+  };
+
+  struct Node {
+    Node *parent = nullptr;
+    ElementId label = 0;
+    std::map<ElementId, std::unique_ptr<Node>> children;
+    /// The entry whose elements are the labels on the path to this node
+    Entry *entry = nullptr;
+  };
+
+  struct Entry {
+    EntryId id;
+    ElementIds elements;
+    /// positions[i] is the index of this entry in the list of elements[i]
+    std::vector<std::size_t> positions;
+    Node *node;
+    V value;
+    typename std::list<Entry *>::iterator lruPosition;
+  };
+
+  std::unordered_map<K, Element, Hash, Equal> elements;
+  /// Element of each id, for releasing elements no entry refers to
+  std::unordered_map<ElementId, K> elementKeys;
+  /// Entries by id, which orders them by insertion
+  std::map<EntryId, Entry> entries;
+  Node root;
+  /// Most recently used first
+  std::list<Entry *> lru;
+  ElementId nextElementId = 0;
+  EntryId nextEntryId = 0;
+  std::size_t capacity;
+
+  /// Translate a key to element ids; false if some element is unknown.
+  template <class Set> bool getIds(const Set &key, ElementIds &ids) const {
+    bool complete = true;
+    for (const K &k : key) {
+      auto it = elements.find(k);
+      if (it == elements.end())
+        complete = false;
+      else
+        ids.push_back(it->second.id);
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return complete;
+  }
+
+  Element &getElement(ElementId id) {
+    return elements.find(elementKeys.find(id)->second)->second;
+  }
+
+  /// Returns the trie node for ids, or nullptr if it does not exist and
+  /// create is false.
+  Node *findNode(const ElementIds &ids, bool create) {
+    Node *node = &root;
+    for (ElementId id : ids) {
+      auto it = node->children.find(id);
+      if (it == node->children.end()) {
+        if (!create)
+          return nullptr;
+        std::unique_ptr<Node> child(new Node());
+        child->parent = node;
+        child->label = id;
+        it = node->children.emplace(id, std::move(child)).first;
+      }
+      node = it->second.get();
+    }
+    return node;
+  }
+
+  void touch(Entry &entry) {
+    lru.splice(lru.begin(), lru, entry.lruPosition);
+  }
+
+  void evict(Entry &entry) {
+    for (std::size_t slot = 0; slot < entry.elements.size(); ++slot) {
+      auto keyIt = elementKeys.find(entry.elements[slot]);
+      auto elementIt = elements.find(keyIt->second);
+      std::vector<Posting> &postings = elementIt->second.postings;
+      // move the last posting into the freed position
+      std::size_t position = entry.positions[slot];
+      Posting moved = postings.back();
+      postings[position] = moved;
+      moved.entry->positions[moved.slot] = position;
+      postings.pop_back();
+      if (postings.empty()) {
+        elements.erase(elementIt);
+        elementKeys.erase(keyIt);
+      }
+    }
+
+    // drop the trie nodes no other entry needs
+    Node *node = entry.node;
+    node->entry = nullptr;
+    while (node != &root && !node->entry && node->children.empty()) {
+      Node *parent = node->parent;
+      parent->children.erase(node->label);
+      node = parent;
+    }
+
+    lru.erase(entry.lruPosition);
+    entries.erase(entry.id);
+  }
+
+public:
+  /// \param capacity - The maximum number of entries, 0 means unbounded.
+  explicit SetIndex(std::size_t capacity = 0) : capacity(capacity) {}
+
+  SetIndex(const SetIndex &) = delete;
+  SetIndex &operator=(const SetIndex &) = delete;
+
+  std::size_t size() const { return entries.size(); }
+
+  /// Returns the value stored for exactly the given set, or nullptr.
+  template <class Set> V *lookup(const Set &key) {
+    ElementIds ids;
+    if (!getIds(key, ids))
+      return nullptr;
+    Node *node = findNode(ids, false);
+    if (!node || !node->entry)
+      return nullptr;
+    touch(*node->entry);
+    return &node->entry->value;
+  }
+
+  /// Store value for the given set, replacing an existing value.
+  template <class Set> void insert(const Set &key, const V &value) {
+    ElementIds ids;
+    for (const K &k : key) {
+      auto it = elements.find(k);
+      if (it == elements.end()) {
+        ElementId id = nextElementId++;
+        it = elements.emplace(k, Element{id, {}}).first;
+        elementKeys.emplace(id, k);
+      }
+      ids.push_back(it->second.id);
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    Node *node = findNode(ids, true);
+    if (node->entry) {
+      node->entry->value = value;
+      touch(*node->entry);
+      return;
+    }
+
+    EntryId id = nextEntryId++;
+    Entry &entry = entries[id];
+    entry.id = id;
+    entry.elements = std::move(ids);
+    entry.node = node;
+    entry.value = value;
+    lru.push_front(&entry);
+    entry.lruPosition = lru.begin();
+    node->entry = &entry;
+    entry.positions.reserve(entry.elements.size());
+    for (std::size_t slot = 0; slot < entry.elements.size(); ++slot) {
+      std::vector<Posting> &postings =
+          getElement(entry.elements[slot]).postings;
+      entry.positions.push_back(postings.size());
+      postings.push_back(Posting{&entry, slot});
+    }
+
+    while (capacity && entries.size() > capacity)
+      evict(*lru.back());
+  }
+
+  /// Returns the value of the oldest entry whose set is a subset of key
+  /// and whose value satisfies predicate, or nullptr.
+  template <class Set, class Predicate>
+  V *findSubset(const Set &key, Predicate predicate) {
+    ElementIds ids;
+    getIds(key, ids);
+
+    // visit the trie nodes labelled by increasing elements of key
+    std::vector<Entry *> candidates;
+    std::vector<std::pair<const Node *, std::size_t>> worklist;
+    worklist.emplace_back(&root, 0);
+    while (!worklist.empty()) {
+      const Node *node = worklist.back().first;
+      std::size_t next = worklist.back().second;
+      worklist.pop_back();
+      if (node->entry)
+        candidates.push_back(node->entry);
+
+      if (node->children.size() < ids.size() - next) {
+        for (const auto &child : node->children) {
+          auto it = std::lower_bound(ids.begin() + next, ids.end(),
+                                     child.first);
+          if (it != ids.end() && *it == child.first)
+            worklist.emplace_back(child.second.get(), it - ids.begin() + 1);
+        }
+      } else {
+        for (std::size_t i = next; i < ids.size(); ++i) {
+          auto it = node->children.find(ids[i]);
+          if (it != node->children.end())
+            worklist.emplace_back(it->second.get(), i + 1);
+        }
+      }
+    }
+    return findFirst(candidates, predicate);
+  }
+
+  /// Returns the value of the oldest entry whose set is a superset of key
+  /// and whose value satisfies predicate, or nullptr.
+  template <class Set, class Predicate>
+  V *findSuperset(const Set &key, Predicate predicate) {
+    ElementIds ids;
+    if (!getIds(key, ids))
+      return nullptr;
+
+    std::vector<Entry *> candidates;
+    if (ids.empty()) {
+      for (auto &entry : entries)
+        candidates.push_back(&entry.second);
+    } else {
+      // only entries containing the rarest element of key can match
+      const std::vector<Posting> *rarest = nullptr;
+      for (ElementId elementId : ids) {
+        const auto &postings = getElement(elementId).postings;
+        if (!rarest || postings.size() < rarest->size())
+          rarest = &postings;
+      }
+      for (const Posting &posting : *rarest) {
+        const ElementIds &entryIds = posting.entry->elements;
+        if (entryIds.size() >= ids.size() &&
+            std::includes(entryIds.begin(), entryIds.end(), ids.begin(),
+                          ids.end()))
+          candidates.push_back(posting.entry);
+      }
+    }
+    return findFirst(candidates, predicate);
+  }
+
+  /// Returns the value of the oldest entry satisfying predicate, or
+  /// nullptr. Nothing narrows the candidates here, so every entry may be
+  /// visited, but a value shared by several entries is tested only once.
+  template <class Predicate> V *findAny(Predicate predicate) {
+    std::unordered_set<V, ValueHash> rejected;
+    for (auto &entry : entries) {
+      const V &value = entry.second.value;
+      if (rejected.count(value))
+        continue;
+      if (predicate(value)) {
+        touch(entry.second);
+        return &entry.second.value;
+      }
+      rejected.insert(value);
+    }
+    return nullptr;
+  }
+
+private:
+  template <class Predicate>
+  V *findFirst(std::vector<Entry *> &candidates, Predicate predicate) {
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Entry *a, const Entry *b) { return a->id < b->id; });
+    for (Entry *entry : candidates) {
+      if (predicate(entry->value)) {
+        touch(*entry);
+        return &entry->value;
+      }
+    }
+    return nullptr;
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_SETINDEX_H */
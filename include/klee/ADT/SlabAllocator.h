@@ -0,0 +1,107 @@
+//===-- SlabAllocator.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SLABALLOCATOR_H
+#define KLEE_SLABALLOCATOR_H
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace klee {
+
+/// Allocator for small objects of a few fixed sizes.
+///
+/// Requests are rounded up to a size class (a multiple of Granularity
+/// bytes). Chunks of a size class are carved from slabs of SlabBytes and
+/// returned chunks are kept on a per-class free list, so allocating and
+/// releasing objects of the same size in a loop does not reach malloc.
+/// Slab memory is only returned to the system when the allocator is
+/// destroyed. Requests larger than MaxSize use the global operator new.
+class SlabAllocator {
+public:
+  static const size_t Granularity = 16;
+  static const size_t MaxSize = 512;
+  static const size_t SlabBytes = 64 * 1024;
+
+private:
+  static const size_t ClassCount = MaxSize / Granularity;
+
+  struct FreeChunk {
+    FreeChunk *next;
+  };
+
+  struct SizeClass {
+    FreeChunk *freeList = nullptr;
+    char *slabCursor = nullptr;
+    char *slabEnd = nullptr;
+  };
+
+  std::array<SizeClass, ClassCount> classes;
+  std::vector<std::unique_ptr<char[]>> slabs;
+
+  static size_t classOf(size_t size) {
+    return size ? (size - 1) / Granularity : 0;
+  }
+
+  void *allocateFromSlab(SizeClass &sc, size_t chunkSize) {
+    if (sc.slabCursor + chunkSize > sc.slabEnd) {
+      // the tail of the previous slab is left unused, it is smaller than
+      // a single chunk
+      slabs.emplace_back(new char[SlabBytes]);
+      sc.slabCursor = slabs.back().get();
+      sc.slabEnd = sc.slabCursor + SlabBytes;
+    }
+    void *chunk = sc.slabCursor;
+    sc.slabCursor += chunkSize;
+    return chunk;
+  }
+
+public:
+  SlabAllocator() = default;
+  SlabAllocator(const SlabAllocator &) = delete;
+  SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+  void *allocate(size_t size) {
+    if (size > MaxSize)
+      return ::operator new(size);
+    size_t index = classOf(size);
+    SizeClass &sc = classes[index];
+    if (FreeChunk *chunk = sc.freeList) {
+      sc.freeList = chunk->next;
+      return chunk;
+    }
+    return allocateFromSlab(sc, (index + 1) * Granularity);
+  }
+
+  /// Release a chunk returned by allocate; size has to be the size it was
+  /// allocated with.
+  void deallocate(void *ptr, size_t size) {
+    if (!ptr)
+      return;
+    if (size > MaxSize) {
+      ::operator delete(ptr);
+      return;
+    }
+    SizeClass &sc = classes[classOf(size)];
+    FreeChunk *chunk = static_cast<FreeChunk *>(ptr);
+    chunk->next = sc.freeList;
+    sc.freeList = chunk;
+  }
+
+  /// Returns the number of bytes held in slabs.
+  size_t getSlabBytes() const { return slabs.size() * SlabBytes; }
+};
+
+} // namespace klee
+
+#endif /* KLEE_SLABALLOCATOR_H */
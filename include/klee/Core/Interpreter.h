@@ -48,6 +48,10 @@ public:
   virtual void processTestCase(const ExecutionState &state,
                                const char *err,
                                const char *suffix) = 0;
+
+  /// Receives the answer to Interpreter::requestPathDonation: the path of
+  /// the state that was given away, or null if there was none to spare.
+  virtual void processDonatedPath(const std::vector<bool> *path) {}
 };
 
 class Interpreter {
@@ -85,8 +89,13 @@ public:
     /// symbolic execution on concrete programs.
     unsigned MakeConcreteSymbolic;
 
+    /// Record internal forks and the choices of multi-way branches in
+    /// the paths as well, so that a recorded path determines the state
+    /// completely and can be passed to setPathPrefix.
+    bool ExactPaths;
+
     InterpreterOptions()
-      : MakeConcreteSymbolic(false)
+      : MakeConcreteSymbolic(false), ExactPaths(false)
     {}
   };
 
@@ -130,6 +139,12 @@ public:
   // a user specified path. use null to reset.
   virtual void setReplayPath(const std::vector<bool> *path) = 0;
 
+  // supply a list of branch decisions, recorded with ExactPaths, to take
+  // from the initial state. once they are used up the exploration
+  // continues normally, so this explores the subtree below a recorded
+  // state. use null to reset.
+  virtual void setPathPrefix(const std::vector<bool> *prefix) = 0;
+
   // supply a test case to replay from. this can be used to drive the
   // interpretation down a user specified path. use null to reset.
   virtual void setReplayNondet(const struct KTest *out) = 0;
@@ -147,6 +162,12 @@ public:
 
   virtual void setHaltExecution(bool value) = 0;
 
+  // ask the interpreter to give away one of its pending states at the
+  // next instruction step, see InterpreterHandler::processDonatedPath.
+  // requires ExactPaths and a path writer. safe to call from a signal
+  // handler.
+  virtual void requestPathDonation() = 0;
+
   virtual void setInhibitForking(bool value) = 0;
 
   virtual void prepareForEarlyExit() = 0;
@@ -0,0 +1,102 @@
+//===-- ConstraintPartition.h -----------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CONSTRAINTPARTITION_H
+#define KLEE_CONSTRAINTPARTITION_H
+
+#include "klee/ADT/ImmutableMap.h"
+#include "klee/ADT/ImmutableSet.h"
+#include "klee/Expr/Expr.h"
+
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+/// Splits a growing list of constraints into independent groups, that is
+/// groups of constraints that do not read a common symbolic byte.
+///
+/// Every byte read at a constant index is a node of a union-find structure,
+/// and so is every array read at a symbolic index; reading an array at a
+/// symbolic index joins all its bytes. The nodes read by a constraint are
+/// joined on insertion and the constraint is attached to the resulting
+/// root, so finding the constraints relevant to an expression only needs
+/// the reads of that expression.
+///
+/// All contents are kept in immutable trees, so a copy shares them with the
+/// original and copying takes constant time; adding a constraint to either
+/// one only copies the paths it changes.
+class ConstraintPartition {
+public:
+  typedef std::vector<ref<Expr>> constraints_ty;
+  typedef std::vector<unsigned> group_ty;
+
+private:
+  /// A byte read at a constant index, or a whole array
+  struct Access {
+    const Array *array;
+    unsigned index;
+    bool whole;
+  };
+
+  struct Root {
+    /// Number of nodes in the tree of the root, which is kept balanced
+    unsigned numNodes = 1;
+    unsigned numConstraints = 0;
+    /// Key of the constraints attached to the root in attached
+    unsigned group = 0;
+  };
+
+  /// Nodes of the bytes read at a constant index
+  ImmutableMap<std::pair<const Array *, unsigned>, unsigned> byteNodes;
+  /// Nodes of the arrays read at a symbolic index
+  ImmutableMap<const Array *, unsigned> wholeNodes;
+  /// Parents of the nodes that are not roots
+  ImmutableMap<unsigned, unsigned> parents;
+  ImmutableMap<unsigned, Root> roots;
+  /// Pairs of the group of a root and the index of a constraint attached to
+  /// it. They are not kept in Root, as the values of an immutable tree
+  /// must not hold immutable trees: the order in which the static
+  /// terminator nodes of the trees are destroyed is unspecified.
+  ImmutableSet<std::pair<unsigned, unsigned>> attached;
+  /// Constraints that read no symbolic byte
+  ImmutableSet<unsigned> unattached;
+  unsigned numNodes = 0;
+  unsigned numConstraints = 0;
+
+  static void getAccesses(const ref<Expr> &e, std::vector<Access> &accesses);
+
+  unsigned find(unsigned node) const;
+  unsigned join(unsigned a, unsigned b);
+  unsigned newNode();
+  unsigned getNode(const Access &access);
+  /// Collect the distinct roots of the existing nodes read by e
+  void getRoots(const ref<Expr> &e, std::vector<unsigned> &result) const;
+  void appendConstraints(unsigned root, group_ty &result) const;
+
+public:
+  /// Number of constraints added so far
+  unsigned size() const { return numConstraints; }
+
+  /// Add the constraint with the next index.
+  void add(const ref<Expr> &constraint);
+
+  /// Collect the indices of the constraints that share, directly or
+  /// transitively, a symbolic byte with expr, in ascending order.
+  void getRelevant(const ref<Expr> &expr, group_ty &result) const;
+
+  /// Collect the indices of all constraints grouped into independent
+  /// factors; the first factor holds the constraints relevant to expr,
+  /// possibly none. Factors are ordered by their first constraint.
+  void getFactors(const ref<Expr> &expr, std::vector<group_ty> &result) const;
+};
+
+} // namespace klee
+
+#endif /* KLEE_CONSTRAINTPARTITION_H */
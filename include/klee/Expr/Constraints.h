@@ -10,8 +10,11 @@
 #ifndef KLEE_CONSTRAINTS_H
 #define KLEE_CONSTRAINTS_H
 
+#include "klee/Expr/ConstraintPartition.h"
 #include "klee/Expr/Expr.h"
 
+#include <memory>
+
 namespace klee {
 
 /// Resembles a set of constraints that can be passed around
@@ -36,12 +39,28 @@ public:
 
   void push_back(const ref<Expr> &e);
 
+  /// Collect the constraints that share, directly or transitively, a
+  /// symbolic byte with expr, in their original order.
+  void getRelevantConstraints(const ref<Expr> &expr,
+                              constraints_ty &result) const;
+
+  /// Split the constraints into independent factors, the first of which
+  /// holds the constraints relevant to expr, possibly none.
+  void getIndependentFactors(const ref<Expr> &expr,
+                             std::vector<constraints_ty> &result) const;
+
   bool operator==(const ConstraintSet &b) const {
     return constraints == b.constraints;
   }
 
 private:
+  const ConstraintPartition &getPartition() const;
+
   constraints_ty constraints;
+  /// Independence partition of constraints, built on first use and then
+  /// kept up to date by push_back. Copies of a set share it until one of
+  /// them adds a constraint, which copies it in constant time.
+  mutable std::shared_ptr<ConstraintPartition> partition;
 };
 
 class ExprVisitor;
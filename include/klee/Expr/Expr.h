@@ -91,6 +91,9 @@ Todo: Shouldn't bool \c Xor just be written as not equal?
 class Expr {
 public:
   static unsigned count;
+  /// Whether structurally equal expressions share a single node (see
+  /// intern), set by --intern-exprs
+  static bool internExprs;
   static const unsigned MAGIC_HASH_CONSTANT = 39;
 
   /// The type of an expression is simply its width, in bits. 
@@ -180,6 +183,15 @@ public:
 protected:  
   unsigned hashValue;
 
+private:
+  /// Set while the expression is in the interning table
+  bool interned = false;
+
+  static ref<Expr> lookupOrInsert(const ref<Expr> &e);
+  void removeInterned();
+
+protected:
+
   /// Compares `b` to `this` Expr and determines how they are ordered
   /// (ignoring their kid expressions - i.e. those returned by `getKid()`).
   ///
@@ -206,7 +218,25 @@ protected:
 
 public:
   Expr() { Expr::count++; }
-  virtual ~Expr() { Expr::count--; } 
+  virtual ~Expr() {
+    Expr::count--;
+    if (interned)
+      removeInterned();
+  }
+
+  /// Returns the node structurally equal to e if expressions are interned,
+  /// e itself otherwise. The alloc factories pass every new node through
+  /// here, so equal interned expressions are the same node.
+  ///
+  /// The table of interned nodes does not keep them alive: a node leaves
+  /// it when its last reference goes away.
+  static ref<Expr> intern(const ref<Expr> &e) {
+    return internExprs ? lookupOrInsert(e) : e;
+  }
+
+  /// Interned expressions are equal iff they are the same node. Only nodes
+  /// whose kids are all interned are interned themselves.
+  bool isInterned() const { return interned; }
 
   virtual Kind getKind() const = 0;
   virtual Width getWidth() const = 0;
@@ -418,7 +448,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &src) {
     ref<Expr> r(new NotOptimizedExpr(src));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   static ref<Expr> create(ref<Expr> src);
@@ -580,7 +610,7 @@ public:
   static ref<Expr> alloc(const UpdateList &updates, const ref<Expr> &index) {
     ref<Expr> r(new ReadExpr(updates, index));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   static ref<Expr> create(const UpdateList &updates, ref<Expr> i);
@@ -625,7 +655,7 @@ public:
                          const ref<Expr> &f) {
     ref<Expr> r(new SelectExpr(c, t, f));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   static ref<Expr> create(ref<Expr> c, ref<Expr> t, ref<Expr> f);
@@ -688,7 +718,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {
     ref<Expr> c(new ConcatExpr(l, r));
     c->computeHash();
-    return c;
+    return intern(c);
   }
   
   static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);
@@ -763,7 +793,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e, unsigned o, Width w) {
     ref<Expr> r(new ExtractExpr(e, o, w));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   /// Creates an ExtractExpr with the given bit offset and width
@@ -814,7 +844,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e) {
     ref<Expr> r(new NotExpr(e));
     r->computeHash();
-    return r;
+    return intern(r);
   }
   
   static ref<Expr> create(const ref<Expr> &e);
@@ -891,7 +921,7 @@ public:                                                          \
     static ref<Expr> alloc(const ref<Expr> &e, Width w) {        \
       ref<Expr> r(new _class_kind ## Expr(e, w));                \
       r->computeHash();                                          \
-      return r;                                                  \
+      return intern(r);                                          \
     }                                                            \
     static ref<Expr> create(const ref<Expr> &e, Width w);        \
     Kind getKind() const { return _class_kind; }                 \
@@ -924,7 +954,7 @@ CAST_EXPR_CLASS(ZExt)
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {           \
       ref<Expr> res(new _class_kind##Expr(l, r));                              \
       res->computeHash();                                                      \
-      return res;                                                              \
+      return intern(res);                                                      \
     }                                                                          \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);           \
     Width getWidth() const { return left->getWidth(); }                        \
@@ -973,7 +1003,7 @@ ARITHMETIC_EXPR_CLASS(AShr)
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {           \
       ref<Expr> res(new _class_kind##Expr(l, r));                              \
       res->computeHash();                                                      \
-      return res;                                                              \
+      return intern(res);                                                      \
     }                                                                          \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);           \
     Kind getKind() const { return _class_kind; }                               \
@@ -1076,9 +1106,9 @@ public:
   void toMemory(void *address);
 
   static ref<ConstantExpr> alloc(const llvm::APInt &v) {
-    ref<ConstantExpr> r(new ConstantExpr(v));
+    ref<Expr> r(new ConstantExpr(v));
     r->computeHash();
-    return r;
+    return cast<ConstantExpr>(intern(r));
   }
 
   static ref<ConstantExpr> alloc(const llvm::APFloat &f) {
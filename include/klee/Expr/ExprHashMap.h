@@ -24,6 +24,12 @@ namespace klee {
     
     struct ExprCmp {
       bool operator()(const ref<Expr> &a, const ref<Expr> &b) const {
+        if (a.get() == b.get())
+          return true;
+        // interned nodes have interned kids all the way down, so equal
+        // interned nodes are the same node
+        if (a->isInterned() && b->isInterned())
+          return false;
         return a==b;
       }
     };
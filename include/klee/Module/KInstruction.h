@@ -28,6 +28,17 @@ namespace klee {
   class KModule;
 
 
+  /// KSuccessor - A successor block of a terminator, decoded so that
+  /// control can be transferred to it without any lookup.
+  struct KSuccessor {
+    /// Index of the first instruction of the block in
+    /// KFunction::instructions.
+    unsigned entry;
+    /// Index of the block of the terminator among the incoming blocks of
+    /// the phi nodes the successor starts with, -1 if there are none.
+    int incomingBBIndex;
+  };
+
   /// KInstruction - Intermediate instruction representation used
   /// during execution.
   struct KInstruction {
@@ -42,6 +53,14 @@ namespace klee {
     /// Destination register index.
     unsigned dest;
 
+    /// The opcode of inst, decoded so that dispatch does not need to look
+    /// at the LLVM instruction.
+    unsigned opcode;
+    /// Width in bits of the result, 0 if it is not sized.
+    unsigned width;
+    /// For terminators, the successors in the order of getSuccessor().
+    KSuccessor *successors = nullptr;
+
   public:
     virtual ~KInstruction();
     std::string getSourceLocation() const;
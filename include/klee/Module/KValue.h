@@ -11,6 +11,8 @@
 #define KVALUE_H
 
 #include "klee/Expr/Expr.h"
+
+#include "llvm/ADT/APInt.h"
 #include <llvm/Support/raw_ostream.h>
 
 // Special segments. Memory allocated via alloca and on heap
@@ -28,82 +30,226 @@ namespace llvm {
 
 namespace klee {
   class KValue {
-  public:
-    ref<Expr> value;
-    ref<Expr> pointerSegment;
+    /// The segment or the offset of a value. Concrete values of at most 64
+    /// bits are kept unboxed, so that computing with them does not touch
+    /// the heap; their expression is only built when it is asked for.
+    class Part {
+      mutable ref<Expr> expr;
+      uint64_t constant = 0;
+      /// The width of constant, 0 if the part is only an expression
+      Expr::Width width = 0;
+
+    public:
+      Part() {}
+      Part(const ref<Expr> &e) : expr(e) {
+        if (e.isNull())
+          return;
+        if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
+          if (CE->getWidth() <= 64) {
+            constant = CE->getZExtValue();
+            width = CE->getWidth();
+          }
+        }
+      }
+      Part(uint64_t value, Expr::Width w) {
+        assert(w > 0 && "invalid width");
+        if (w > 64)
+          expr = ConstantExpr::alloc(value, w);
+        else {
+          constant = w < 64 ? value & ((1ULL << w) - 1) : value;
+          width = w;
+        }
+      }
+      Part(const llvm::APInt &value)
+          : Part(value.getZExtValue(), value.getBitWidth()) {}
+
+      bool isConcrete() const { return width; }
+      llvm::APInt getAPValue() const { return llvm::APInt(width, constant); }
+
+      const ref<Expr> &get() const {
+        if (expr.isNull() && width)
+          expr = ConstantExpr::alloc(constant, width);
+        return expr;
+      }
+
+      Expr::Width getWidth() const { return width ? width : expr->getWidth(); }
+
+      bool isConstant() const { return width || isa<ConstantExpr>(expr); }
+
+      bool isZero() const {
+        if (width)
+          return !constant;
+        ConstantExpr *CE = dyn_cast<ConstantExpr>(expr);
+        return CE && CE->isZero();
+      }
+
+      ref<Expr> createIsZero() const {
+        if (width)
+          return ConstantExpr::alloc(!constant, Expr::Bool);
+        return Expr::createIsZero(expr);
+      }
+
+#define _part_binary(op, apOp) \
+      static Part op(const Part &l, const Part &r) { \
+        if (l.width && r.width) { \
+          assert(l.width == r.width && "type mismatch"); \
+          llvm::APInt a = l.getAPValue(), b = r.getAPValue(); \
+          return Part(apOp); \
+        } \
+        return Part(op##Expr::create(l.get(), r.get())); \
+      }
+#define _part_compare(op, apOp) \
+      static Part op(const Part &l, const Part &r) { \
+        if (l.width && r.width) { \
+          assert(l.width == r.width && "type mismatch"); \
+          llvm::APInt a = l.getAPValue(), b = r.getAPValue(); \
+          return Part(apOp, Expr::Bool); \
+        } \
+        return Part(op##Expr::create(l.get(), r.get())); \
+      }
+
+      _part_binary(Add, a + b)
+      _part_binary(Sub, a - b)
+      _part_binary(Mul, a * b)
+      _part_binary(UDiv, a.udiv(b))
+      _part_binary(SDiv, a.sdiv(b))
+      _part_binary(URem, a.urem(b))
+      _part_binary(SRem, a.srem(b))
+      _part_binary(And, a & b)
+      _part_binary(Or, a | b)
+      _part_binary(Xor, a ^ b)
+      _part_binary(Shl, a.shl(b))
+      _part_binary(LShr, a.lshr(b))
+      _part_binary(AShr, a.ashr(b))
+
+      _part_compare(Eq, a == b)
+      _part_compare(Ne, a != b)
+      _part_compare(Ult, a.ult(b))
+      _part_compare(Ule, a.ule(b))
+      _part_compare(Ugt, a.ugt(b))
+      _part_compare(Uge, a.uge(b))
+      _part_compare(Slt, a.slt(b))
+      _part_compare(Sle, a.sle(b))
+      _part_compare(Sgt, a.sgt(b))
+      _part_compare(Sge, a.sge(b))
+
+#undef _part_binary
+#undef _part_compare
+
+      static Part Concat(const Part &l, const Part &r) {
+        if (l.width && r.width && l.width + r.width <= 64)
+          return Part(l.constant << r.width | r.constant, l.width + r.width);
+        return Part(ConcatExpr::create(l.get(), r.get()));
+      }
+
+      static Part Select(const Part &c, const Part &t, const Part &f) {
+        if (c.width)
+          return c.constant ? t : f;
+        return Part(SelectExpr::create(c.get(), t.get(), f.get()));
+      }
+
+      Part Extract(unsigned bitOff, Expr::Width w) const {
+        if (width) {
+          assert(w > 0 && bitOff + w <= width && "invalid extract");
+          return Part(constant >> bitOff, w);
+        }
+        return Part(ExtractExpr::create(expr, bitOff, w));
+      }
+
+      Part ZExt(Expr::Width w) const {
+        if (width && w <= 64)
+          return Part(constant, w);
+        return Part(ZExtExpr::create(get(), w));
+      }
+
+      Part SExt(Expr::Width w) const {
+        if (width && w <= 64)
+          return Part(getAPValue().sextOrTrunc(w));
+        return Part(SExtExpr::create(get(), w));
+      }
+    };
+
+    Part value;
+    Part pointerSegment;
+
+    KValue(const Part &segment, const Part &offset)
+      : value(offset), pointerSegment(segment) {}
 
   public:
     KValue() {}
     KValue(const KValue &other) : value(other.value), pointerSegment(other.pointerSegment) {}
     KValue(ref<Expr> value)
-      : value(value), pointerSegment(ConstantExpr::alloc(VALUES_SEGMENT, value->getWidth())) {}
+      : value(value), pointerSegment(VALUES_SEGMENT, this->value.getWidth()) {}
     KValue(ref<ConstantExpr> value)
-      : value(value), pointerSegment(ConstantExpr::alloc(VALUES_SEGMENT, value->getWidth())) {}
+      : value(ref<Expr>(value)), pointerSegment(VALUES_SEGMENT, this->value.getWidth()) {}
     KValue(ref<Expr> segment, ref<Expr> offset)
       : value(offset), pointerSegment(segment) {}
     KValue(uint64_t segment, ref<Expr> offset)
-      : value(offset), pointerSegment(ConstantExpr::alloc(segment, value->getWidth())) {}
+      : value(offset), pointerSegment(segment, value.getWidth()) {}
     KValue(SpecialSegment segment, const ref<Expr> &offset)
-        : value(offset), pointerSegment(ConstantExpr::alloc(segment, value->getWidth())) {}
+        : value(offset), pointerSegment(segment, value.getWidth()) {}
 
     KValue& operator=(const KValue &other) = default;
 
-    ref<Expr> getValue() const { return value; }
-    ref<Expr> getOffset() const { return value; }
-    ref<Expr> getSegment() const { return pointerSegment; }
+    /// A concrete value in the given segment, kept unboxed if it fits into
+    /// 64 bits.
+    static KValue createConstant(uint64_t value, Expr::Width width,
+                                 uint64_t segment = VALUES_SEGMENT) {
+      return KValue(Part(segment, width), Part(value, width));
+    }
+
+    ref<Expr> getValue() const { return value.get(); }
+    ref<Expr> getOffset() const { return value.get(); }
+    ref<Expr> getSegment() const { return pointerSegment.get(); }
 
     ref<Expr> createIsZero() const {
-      return AndExpr::create(Expr::createIsZero(getSegment()),
-                             Expr::createIsZero(getOffset()));
+      return AndExpr::create(pointerSegment.createIsZero(),
+                             value.createIsZero());
     }
 
     /// Checks if both segment and offset are ConstantExpr and if yes, if they contain zero value
     bool isZero() const {
-      ConstantExpr *segment = dyn_cast<ConstantExpr>(pointerSegment);
-      ConstantExpr *offset = dyn_cast<ConstantExpr>(value);
-      return (segment && offset && segment->isZero() && offset->isZero());
+      return pointerSegment.isZero() && value.isZero();
     }
 
     bool isConstant() const {
-      return isa<ConstantExpr>(value) && isa<ConstantExpr>(pointerSegment);
+      return value.isConstant() && pointerSegment.isConstant();
     }
 
     Expr::Width getWidth() const {
-      return getValue()->getWidth();
+      return value.getWidth();
     }
-    
+
     KValue ZExt(Expr::Width w) const {
-      return KValue(ZExtExpr::create(pointerSegment, w),
-                    ZExtExpr::create(value, w));
+      return KValue(pointerSegment.ZExt(w), value.ZExt(w));
     }
 
     KValue SExt(Expr::Width w) const {
-      return KValue(SExtExpr::create(pointerSegment, w),
-                    SExtExpr::create(value, w));
+      return KValue(pointerSegment.SExt(w), value.SExt(w));
     }
 
 #define _op_seg_different(op) \
      KValue op(const KValue &other) const { \
-      if (getSegment().get()->isZero() && other.getSegment().get()->isZero()) { \
-        return KValue(op##Expr::create(value, other.value)); \
+      if (pointerSegment.isZero() && other.pointerSegment.isZero()) { \
+        return KValue(Part::op(value, other.value)); \
       } else { \
-        KValue retval = KValue(op##Expr::create(value, other.value)); \
-        if (getSegment().get()->isZero()) { \
-          retval.pointerSegment = other.getSegment(); \
+        KValue retval = KValue(Part::op(value, other.value)); \
+        if (pointerSegment.isZero()) { \
+          retval.pointerSegment = other.pointerSegment; \
         } else { \
-          retval.pointerSegment = getSegment(); \
+          retval.pointerSegment = pointerSegment; \
         } \
         return retval; \
       } \
     }
 #define _op_seg_same(op) \
     KValue op(const KValue &other) const { \
-      return KValue(op##Expr::create(pointerSegment, other.pointerSegment), \
-                    op##Expr::create(value, other.value)); \
+      return KValue(Part::op(pointerSegment, other.pointerSegment), \
+                    Part::op(value, other.value)); \
     }
 #define _op_seg_zero(op) \
     KValue op(const KValue &other) const { \
-      return KValue(op##Expr::create(value, other.value)); \
+      return KValue(Part::op(value, other.value)); \
     }
 
     _op_seg_same(Concat);
@@ -112,8 +258,8 @@ namespace klee {
     _op_seg_same(Sub);
     KValue Mul(const KValue &other) const {
       // multiplying pointers doesn't make sense, but we must ensure that identity 1*x==x works
-      return KValue(AddExpr::create(pointerSegment, other.pointerSegment),
-                    MulExpr::create(value, other.value));
+      return KValue(Part::Add(pointerSegment, other.pointerSegment),
+                    Part::Mul(value, other.value));
     }
 
     _op_seg_different(And);
@@ -130,13 +276,13 @@ namespace klee {
 
 #define _op_seg_cmp_lexicographic(cmp) \
     KValue cmp(const KValue &other) const { \
-      if (isa<ConstantExpr>(value) && isa<ConstantExpr>(other.value)) { \
-        return KValue(SelectExpr::create( \
-              EqExpr::create(pointerSegment, other.pointerSegment), \
-              cmp##Expr::create(value, other.value), \
-              cmp##Expr::create(pointerSegment, other.pointerSegment))); \
+      if (value.isConstant() && other.value.isConstant()) { \
+        return KValue(Part::Select( \
+              Part::Eq(pointerSegment, other.pointerSegment), \
+              Part::cmp(value, other.value), \
+              Part::cmp(pointerSegment, other.pointerSegment))); \
       } else { \
-        return KValue(cmp##Expr::create(value, other.value)); \
+        return KValue(Part::cmp(value, other.value)); \
       } \
     }
 
@@ -150,33 +296,49 @@ namespace klee {
     _op_seg_cmp_lexicographic(Sle);
 
     KValue SymbCmp(const KValue &other) const {
-      return KValue(EqExpr::create(value, other.value));
+      return KValue(Part::Eq(value, other.value));
     }
 
     KValue Eq(const KValue &other) const {
-      return KValue(AndExpr::create(
-                      EqExpr::create(pointerSegment, other.pointerSegment),
-                      EqExpr::create(value, other.value)));
+      return KValue(Part::And(
+                      Part::Eq(pointerSegment, other.pointerSegment),
+                      Part::Eq(value, other.value)));
     }
 
     KValue Ne(const KValue &other) const {
-      return KValue(OrExpr::create(
-                      NeExpr::create(pointerSegment, other.pointerSegment),
-                      NeExpr::create(value, other.value)));
+      return KValue(Part::Or(
+                      Part::Ne(pointerSegment, other.pointerSegment),
+                      Part::Ne(value, other.value)));
     }
 
     KValue Select(const KValue &b1, const KValue &b2) const {
-      return KValue(SelectExpr::create(value, b1.pointerSegment, b2.pointerSegment),
-                    SelectExpr::create(value, b1.value, b2.value));
+      return KValue(Part::Select(value, b1.pointerSegment, b2.pointerSegment),
+                    Part::Select(value, b1.value, b2.value));
     }
 
     KValue Extract(unsigned bitOff, Expr::Width width) const {
-      return KValue(ExtractExpr::create(pointerSegment, bitOff, width),
-                    ExtractExpr::create(value, bitOff, width));
+      return KValue(pointerSegment.Extract(bitOff, width),
+                    value.Extract(bitOff, width));
     }
 
     template <class T>
     static KValue concatValues(const T &input) {
+      Expr::Width width = 0;
+      for (const KValue& item : input) {
+        if (!item.value.isConcrete() || !item.pointerSegment.isConcrete()) {
+          width = 0;
+          break;
+        }
+        width += item.getWidth();
+      }
+      if (width && width <= 64) {
+        auto it = std::begin(input);
+        KValue result = *it;
+        for (++it; it != std::end(input); ++it)
+          result = result.Concat(*it);
+        return result;
+      }
+
       std::vector<ref<Expr> > segments;
       std::vector<ref<Expr> > values;
       for (const KValue& item : input) {
@@ -186,15 +348,19 @@ namespace klee {
       return KValue(ConcatExpr::createN(segments.size(), segments.data()),
                     ConcatExpr::createN(values.size(), values.data()));
     }
+
+  private:
+    KValue(const Part &value)
+      : value(value), pointerSegment(VALUES_SEGMENT, value.getWidth()) {}
   };
 
   inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const KValue &kvalue) {
-    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(kvalue.pointerSegment)) {
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(kvalue.getSegment())) {
       if (CE->isZero()) {
-        return os << kvalue.value;
+        return os << kvalue.getValue();
       }
     }
-    return os << kvalue.pointerSegment << ':' << kvalue.value;
+    return os << kvalue.getSegment() << ':' << kvalue.getValue();
   }
 }
 
@@ -27,8 +27,33 @@ namespace klee {
   /// independent of the actual constraints but can be used as a two-way
   /// communication between solver and context of query.
   struct SolverQueryMetaData {
+    /// @brief A satisfying assignment found for the constraints of a state
+    struct Model {
+      std::shared_ptr<const Assignment> assignment;
+      /// @brief Number of leading constraints known to be satisfied
+      std::size_t checked = 0;
+      /// @brief Last of the checked constraints, to notice rewrites
+      ref<Expr> lastChecked;
+    };
+
     /// @brief Costs for all queries issued for this state
     time::Span queryCost;
+
+    /// @brief Last model found for this state, inherited on fork
+    Model lastModel;
+  };
+
+  /// Time spent in the layers of a solver chain while answering queries,
+  /// collected by profiling solvers (see createProfilingSolver).
+  struct SolverLayerTimes {
+    enum Layer { Independent, Caching, CexCaching, Core, NumLayers };
+
+    /// @brief Time spent in each layer itself, without the layers below
+    time::Span times[NumLayers];
+    /// @brief Time of the layers below the innermost running one
+    time::Span nested;
+
+    static const char *getLayerName(Layer layer);
   };
 
   struct Query {
@@ -171,6 +196,24 @@ namespace klee {
     /// \return True on success.
     bool mayBeFalse(const Query&, bool &result);
 
+    /// mayBeTrue - Determine for each of the given expressions whether there
+    /// is a valid assignment for the constraints in which it evaluates to
+    /// true.
+    ///
+    /// Instead of one query per expression, the solver is asked for a model
+    /// of the disjunction of the undecided expressions. Every expression
+    /// true in the model may be true, and once the disjunction cannot be
+    /// satisfied none of the remaining ones can. For mutually exclusive
+    /// expressions this takes one query per feasible expression plus one.
+    ///
+    /// \param [out] results - On success, results[i] is true iff exprs[i]
+    /// may be true
+    ///
+    /// \return True on success.
+    bool mayBeTrue(const ConstraintSet &constraints,
+                   const std::vector<ref<Expr>> &exprs,
+                   std::vector<bool> &results);
+
     /// getValue - Compute one possible value for the given expression.
     ///
     /// \param [out] result - On success, a value for the expression in some
@@ -191,6 +234,17 @@ namespace klee {
     bool getInitialValues(const Query&,
                           std::shared_ptr<const Assignment> &result);
 
+    /// getInitialValues - Like the above, but distinguishes a query without
+    /// a satisfying assignment from a failure.
+    ///
+    /// \param [out] hasSolution - On success, true iff there is a satisfying
+    /// assignment, result is only set then
+    ///
+    /// \return True on success.
+    bool getInitialValues(const Query&,
+                          std::shared_ptr<const Assignment> &result,
+                          bool &hasSolution);
+
     /// getRange - Compute a tight range of possible values for a given
     /// expression.
     ///
@@ -238,6 +292,15 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createCexCachingSolver(Solver *s);
 
+  /// createPersistentCachingSolver - Create a solver which caches query
+  /// results in an SQLite database at the given path. The database is kept
+  /// between runs and queries are matched regardless of the names of their
+  /// arrays.
+  ///
+  /// \param s - The underlying solver to use.
+  /// \param path - The database file, created if it does not exist.
+  Solver *createPersistentCachingSolver(Solver *s, std::string path);
+
   /// createFastCexSolver - Create a "fast counterexample solver", which tries
   /// to quickly compute a satisfying assignment for a constraint set using
   /// value propogation and range analysis.
@@ -265,6 +328,30 @@ namespace klee {
                                     bool logTimedOut);
 
 
+  /// createPortfolioSolver - Create a solver which sends queries to the
+  /// primary solver in a forked process and, on queries that take longer
+  /// than the threshold, races it against the secondary solver in another
+  /// one. The first answer wins and the other process is killed.
+  ///
+  /// \param primary - The solver that answers queries below the threshold.
+  /// \param secondary - The solver raced against the primary.
+  /// \param threshold - How long a query runs on the primary alone.
+  Solver *createPortfolioSolver(Solver *primary, CoreSolverType primaryType,
+                                Solver *secondary,
+                                CoreSolverType secondaryType,
+                                time::Span threshold);
+
+  /// createProfilingSolver - Create a solver which forwards all queries
+  /// and charges the time spent in the given solver to a layer of the chain.
+  /// Time spent in profiling solvers further down the chain is charged to
+  /// their layers instead.
+  ///
+  /// \param s - The underlying solver to use.
+  /// \param layer - The layer the time is charged to.
+  /// \param times - Collects the times of all layers.
+  Solver *createProfilingSolver(Solver *s, SolverLayerTimes::Layer layer,
+                                SolverLayerTimes &times);
+
   /// createDummySolver - Create a dummy solver implementation which always
   /// fails.
   Solver *createDummySolver();
@@ -28,6 +28,8 @@ extern llvm::cl::opt<bool> UseCexCache;
 
 extern llvm::cl::opt<bool> UseBranchCache;
 
+extern llvm::cl::opt<std::string> PersistentQueryCache;
+
 extern llvm::cl::opt<bool> UseIndependentSolver;
 
 extern llvm::cl::opt<bool> DebugValidateSolver;
@@ -42,6 +44,10 @@ extern llvm::cl::opt<bool> UseForkedCoreSolver;
 
 extern llvm::cl::opt<bool> CoreSolverOptimizeDivides;
 
+extern llvm::cl::opt<unsigned> Z3IncrementalSolvers;
+
+extern llvm::cl::opt<unsigned> Z3ConstructCacheSize;
+
 extern llvm::cl::opt<bool> UseAssignmentValidatingSolver;
 
 /// The different query logging solvers that can be switched on/off
@@ -66,6 +72,10 @@ extern llvm::cl::opt<CoreSolverType> CoreSolverToUse;
 
 extern llvm::cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith;
 
+extern llvm::cl::opt<CoreSolverType> PortfolioSolverBackend;
+
+extern llvm::cl::opt<std::string> PortfolioThreshold;
+
 #ifdef ENABLE_METASMT
 
 enum MetaSMTBackendType {
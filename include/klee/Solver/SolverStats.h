@@ -15,6 +15,7 @@
 namespace klee {
 namespace stats {
 
+  extern Statistic cexCacheLookupTime;
   extern Statistic cexCacheTime;
   extern Statistic queries;
   extern Statistic queriesInvalid;
@@ -25,6 +26,13 @@ namespace stats {
   extern Statistic queryCexCacheMisses;
   extern Statistic queryConstructs;
   extern Statistic queryCounterexamples;
+  extern Statistic queryModelHits;
+  extern Statistic queryPersistentCacheHits;
+  extern Statistic queryPersistentCacheMisses;
+  extern Statistic queryPortfolioRaces;
+  extern Statistic queryPortfolioWinsMetaSMT;
+  extern Statistic queryPortfolioWinsSTP;
+  extern Statistic queryPortfolioWinsZ3;
   extern Statistic queryTime;
   
 #ifdef KLEE_ARRAY_DEBUG
@@ -19,17 +19,60 @@
 
 #include "CoreStats.h"
 
+#include <algorithm>
+#include <set>
+#include <tuple>
 
 using namespace klee;
 
+namespace {
+/// Upper bound on the number of values collectSegmentValues enumerates.
+const size_t MaxSegmentValues = 64;
+
+/// Collects the values a segment expression built only from constants
+/// and selects can take.
+/// \return false if the expression has a different shape or more than
+///         MaxSegmentValues distinct values
+bool collectSegmentValues(const ref<Expr> &segment,
+                          std::set<uint64_t> &values) {
+  if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(segment)) {
+    if (CE->getWidth() > Expr::Int64)
+      return false;
+    values.insert(CE->getZExtValue());
+    return values.size() <= MaxSegmentValues;
+  }
+  if (const SelectExpr *SE = dyn_cast<SelectExpr>(segment))
+    return collectSegmentValues(SE->trueExpr, values) &&
+           collectSegmentValues(SE->falseExpr, values);
+  return false;
+}
+
+/// Approximate size of a writeable copy of os. Depends only on the size of
+/// the object so that binding and unbinding it account the same amount.
+uint64_t getObjectBytes(const ObjectState *os) {
+  return sizeof(ObjectState) + sizeof(ObjectStatePlane) + os->getSizeBound();
+}
+} // namespace
+
 ///
 
+void AddressSpace::releaseOwnedBytes(const MemoryObject *mo) {
+  if (const auto res = objects.lookup(mo)) {
+    const ObjectState *os = res->second.get();
+    if (os->copyOnWriteOwner == cowKey)
+      ownedBytes -= std::min(ownedBytes, getObjectBytes(os));
+  }
+}
+
 void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
   assert(os->copyOnWriteOwner==0 && "object already has owner");
   os->copyOnWriteOwner = cowKey;
+  releaseOwnedBytes(mo);
+  ownedBytes += getObjectBytes(os);
   objects = objects.replace(std::make_pair(mo, os));
   if (mo->segment != 0) {
-    segmentMap = segmentMap.replace(std::make_pair(mo->segment, mo));
+    segmentMap =
+        segmentMap.replace(std::make_pair(mo->segment, ObjectPair(mo, os)));
     if (mo->isLazyInitialized) {
       lazyObjectsMap.emplace(mo->getSegment(), std::set<ref<Expr>>());
     }
@@ -45,6 +88,7 @@ void AddressSpace::unbindObject(const MemoryObject *mo) {
     }
   }
 
+  releaseOwnedBytes(mo);
   objects = objects.remove(mo);
   // NOTE MemoryObjects are reference counted, *mo is deleted at this point
 }
@@ -65,17 +109,27 @@ ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
   // Add a copy of this object state that can be updated
   ref<ObjectState> newObjectState(new ObjectState(*os));
   newObjectState->copyOnWriteOwner = cowKey;
+  ownedBytes += getObjectBytes(os);
   objects = objects.replace(std::make_pair(mo, newObjectState));
+  if (mo->segment != 0)
+    segmentMap = segmentMap.replace(
+        std::make_pair(mo->segment, ObjectPair(mo, newObjectState.get())));
   return newObjectState.get();
 }
 
+void AddressSpace::bindConcreteAddress(uint64_t address, uint64_t segment) {
+  if (concreteAddressMap.lookup(address))
+    return;
+  concreteAddressMap = concreteAddressMap.insert(std::make_pair(address, segment));
+  if (!segmentAddressIndex.lookup(segment))
+    segmentAddressIndex =
+        segmentAddressIndex.insert(std::make_pair(segment, address));
+}
+
 bool AddressSpace::resolveInConcreteMap(const uint64_t& segment, uint64_t &address) const {
-  auto found = std::find_if(concreteAddressMap.begin(),concreteAddressMap.end(),
-                            [segment](std::pair<const uint64_t&, const uint64_t&> value) {
-                              return value.second == segment;
-                            });
-  if (found != concreteAddressMap.end()) {
-    address = found->first;
+  if (const SegmentAddressIndex::value_type *res =
+          segmentAddressIndex.lookup(segment)) {
+    address = res->second;
     return true;
   }
   return false;
@@ -88,9 +142,7 @@ bool AddressSpace::resolveOneConstantSegment(const KValue &pointer,
   if (segment != 0) {
     if (const SegmentMap::value_type *res = segmentMap.lookup(segment)) {
       // TODO bounds check?
-      const auto& objpair = *objects.lookup(res->second);
-      result.first = objpair.first;
-      result.second = objpair.second.get();
+      result = res->second;
       return true;
     }
   }
@@ -216,19 +268,132 @@ bool AddressSpace::resolve(ExecutionState &state,
                                           KValue(zeroSegment, pointer.getValue()),
                                           rl, maxResolutions, timeout))
     return true;
-  // TODO inefficient
-  for (const SegmentMap::value_type &res : segmentMap) {
-    if (timeout && timeout < timer.delta())
-      return true;
-    ref<Expr> segmentExpr = ConstantExpr::create(res.first, pointer.getWidth());
-    ref<Expr> expr = EqExpr::create(pointer.getSegment(), segmentExpr);
-    if (!solver->mayBeTrue(state.constraints, expr, mayBeTrue,
+
+  // Bound the set of candidate segments before asking the solver about
+  // them. If the segment expression is built only from constants and
+  // selects, its possible values are known syntactically. Otherwise all
+  // live segments are candidates.
+  std::vector<uint64_t> candidates;
+  std::set<uint64_t> values;
+  bool syntactic = collectSegmentValues(pointer.getSegment(), values);
+  if (syntactic) {
+    for (uint64_t value : values) {
+      if (value != 0 && segmentMap.lookup(value))
+        candidates.push_back(value);
+    }
+  } else {
+    for (const SegmentMap::value_type &res : segmentMap)
+      candidates.push_back(res.first);
+    std::sort(candidates.begin(), candidates.end());
+  }
+
+  if (candidates.empty())
+    return false;
+
+  // The few values of a select chain are checked in one batch, which
+  // needs a query per feasible segment plus one.
+  if (syntactic && candidates.size() > 1) {
+    std::vector<ref<Expr>> exprs;
+    for (uint64_t candidate : candidates)
+      exprs.push_back(EqExpr::create(
+          pointer.getSegment(),
+          ConstantExpr::create(candidate, pointer.getWidth())));
+    std::vector<bool> feasible;
+    if (!solver->mayBeTrue(state.constraints, exprs, feasible,
                            state.queryMetaData))
       return true;
-    if (mayBeTrue) {
-      const auto &pair = *objects.lookup(res.second);
-      rl.emplace_back(pair.first, pair.second.get());
+    for (size_t i = 0; i != candidates.size(); ++i) {
+      if (!feasible[i])
+        continue;
+      rl.push_back(segmentMap.lookup(candidates[i])->second);
+      if (maxResolutions && rl.size() >= maxResolutions)
+        return true;
+    }
+    return false;
+  }
+
+  // A model of the segment is feasible by construction, so any range
+  // containing it does not need to be checked. Most symbolic segments can
+  // only take that one value, which a single query establishes.
+  llvm::Optional<uint64_t> knownFeasible;
+  if (candidates.size() > 1) {
+    ref<ConstantExpr> model;
+    if (!solver->getValue(state.constraints, pointer.getSegment(), model,
+                          state.queryMetaData))
+      return true;
+    knownFeasible = model->getZExtValue();
+
+    bool unique;
+    if (!solver->mustBeTrue(state.constraints,
+                            EqExpr::create(pointer.getSegment(), model),
+                            unique, state.queryMetaData))
+      return true;
+    if (unique) {
+      if (const auto *res = segmentMap.lookup(*knownFeasible))
+        rl.push_back(res->second);
+      return false;
+    }
+  }
+
+  // Bisect the sorted candidates: a range of segments is only split if
+  // the segment may fall into it, so infeasible parts of the address
+  // space are discarded with a single query. Small ranges are not split
+  // further, their members are checked in one batch. Ranges are visited
+  // left to right to keep the resolution list ordered by segment.
+  const size_t batchedRange = 4;
+  std::vector<std::pair<size_t, size_t>> worklist;
+  worklist.emplace_back(0, candidates.size());
+  while (!worklist.empty()) {
+    if (timeout && timeout < timer.delta())
+      return true;
+
+    size_t lo, hi;
+    std::tie(lo, hi) = worklist.back();
+    worklist.pop_back();
+
+    if (hi - lo <= batchedRange) {
+      std::vector<ref<Expr>> exprs;
+      for (size_t i = lo; i != hi; ++i)
+        if (!knownFeasible || candidates[i] != *knownFeasible)
+          exprs.push_back(EqExpr::create(
+              pointer.getSegment(),
+              ConstantExpr::create(candidates[i], pointer.getWidth())));
+      std::vector<bool> feasible;
+      if (!exprs.empty() && !solver->mayBeTrue(state.constraints, exprs,
+                                               feasible, state.queryMetaData))
+        return true;
+      for (size_t i = lo, j = 0; i != hi; ++i) {
+        if ((!knownFeasible || candidates[i] != *knownFeasible) &&
+            !feasible[j++])
+          continue;
+        rl.push_back(segmentMap.lookup(candidates[i])->second);
+        if (maxResolutions && rl.size() >= maxResolutions)
+          return true;
+      }
+      continue;
     }
+
+    bool feasible = knownFeasible &&
+                    candidates[lo] <= *knownFeasible &&
+                    *knownFeasible <= candidates[hi - 1];
+    if (!feasible) {
+      ref<Expr> expr = AndExpr::create(
+          UgeExpr::create(pointer.getSegment(),
+                          ConstantExpr::create(candidates[lo],
+                                               pointer.getWidth())),
+          UleExpr::create(pointer.getSegment(),
+                          ConstantExpr::create(candidates[hi - 1],
+                                               pointer.getWidth())));
+      if (!solver->mayBeTrue(state.constraints, expr, feasible,
+                             state.queryMetaData))
+        return true;
+      if (!feasible)
+        continue;
+    }
+
+    size_t mid = lo + (hi - lo) / 2;
+    worklist.emplace_back(mid, hi);
+    worklist.emplace_back(lo, mid);
   }
   return false;
 }
@@ -260,23 +425,28 @@ void AddressSpace::resolveAddressWithOffset(const ExecutionState &state,
   if (!value)
     return;
 
-  for (const auto pair: concreteAddressMap) {
-    const auto& resolvedAddress = pair.first;
-    const auto& resolvedSegment = pair.second;
-    const auto *res = segmentMap.lookup(resolvedSegment);
+  // Objects with real process memory do not overlap, so only the object
+  // with the closest address below may contain the given one.
+  const ConcreteAddressMap::value_type *pair =
+      concreteAddressMap.lookup_previous(value->getZExtValue());
+  if (!pair)
+    return;
 
-    if (!res)
-      continue;
+  const auto& resolvedAddress = pair->first;
+  const auto& resolvedSegment = pair->second;
+  const auto *res = segmentMap.lookup(resolvedSegment);
 
-    auto op = *objects.lookup(res->second);
-    auto subexpr = SubExpr::alloc(address, ConstantExpr::alloc(resolvedAddress, Context::get().getPointerWidth()));
-    auto check = op.first->getBoundsCheckOffset(subexpr);
-    bool mayBeTrue = false;
-    if (solver->mayBeTrue(state.constraints, check, mayBeTrue, state.queryMetaData)) {
-      if (mayBeTrue) {
-        rl.emplace_back(op.first, op.second.get());
-        offset = cast<ConstantExpr>(address)->getZExtValue() - resolvedAddress;
-      }
+  if (!res)
+    return;
+
+  const ObjectPair &op = res->second;
+  auto subexpr = SubExpr::alloc(address, ConstantExpr::alloc(resolvedAddress, Context::get().getPointerWidth()));
+  auto check = op.first->getBoundsCheckOffset(subexpr);
+  bool mayBeTrue = false;
+  if (solver->mayBeTrue(state.constraints, check, mayBeTrue, state.queryMetaData)) {
+    if (mayBeTrue) {
+      rl.push_back(op);
+      offset = value->getZExtValue() - resolvedAddress;
     }
   }
 }
@@ -312,7 +482,7 @@ void AddressSpace::copyOutConcretes(const SegmentAddressMap &resolved,
           concreteStore.resize(os->offsetPlane->sizeBound,
                                os->offsetPlane->initialValue);
 
-          memcpy(address, concreteStore.data(), concreteStore.size());
+          concreteStore.copyTo(address);
         }
       }
     }
@@ -345,7 +515,7 @@ bool AddressSpace::copyInConcrete(const MemoryObject *mo, const ObjectState *os,
                                   TimingSolver *solver) {
   auto address = reinterpret_cast<uint8_t*>(resolvedAddress);
   auto &concreteStoreR = os->offsetPlane->concreteStore;
-  if (memcmp(address, concreteStoreR.data(), concreteStoreR.size())!=0) {
+  if (!concreteStoreR.equals(address)) {
     if (os->readOnly) {
       return false;
     } else {
@@ -359,7 +529,7 @@ bool AddressSpace::copyInConcrete(const MemoryObject *mo, const ObjectState *os,
 void AddressSpace::writeToWOS(ExecutionState &state, TimingSolver *solver,
                               const uint8_t *address, ObjectState *wos) const {
   auto &concreteStoreW = wos->offsetPlane->concreteStore;
-  memcpy(concreteStoreW.data(), address, concreteStoreW.size());
+  concreteStoreW.assign(address);
 
   if (concreteStoreW.size() == Context::get().getPointerWidth() / 8) {
     KValue written = wos->read(0, Context::get().getPointerWidth());
@@ -14,6 +14,8 @@
 
 #include "klee/Expr/Expr.h"
 #include "klee/ADT/ImmutableMap.h"
+#include "klee/ADT/PersistentHashMap.h"
+#include "klee/Config/config.h"
 #include "klee/System/Time.h"
 #include "klee/Module/KValue.h"
 
@@ -36,8 +38,15 @@ namespace klee {
   };
 
 typedef ImmutableMap<const MemoryObject*, ref<ObjectState>, MemoryObjectLT> MemoryMap;
-typedef ImmutableMap<uint64_t, const MemoryObject*> SegmentMap;
-typedef std::map</*address*/ const uint64_t, /*segment*/ const uint64_t> ConcreteAddressMap;
+/// Segment -> (MemoryObject, ObjectState) index used to resolve pointers
+/// with a constant segment without going through MemoryMap.
+#ifdef KLEE_USE_HAMT_SEGMENT_MAP
+typedef PersistentHashMap<uint64_t, ObjectPair> SegmentMap;
+#else
+typedef ImmutableMap<uint64_t, ObjectPair> SegmentMap;
+#endif
+typedef ImmutableMap</*address*/ uint64_t, /*segment*/ uint64_t> ConcreteAddressMap;
+typedef ImmutableMap</*segment*/ uint64_t, /*address*/ uint64_t> SegmentAddressIndex;
 typedef std::map</*segment*/ const uint64_t, /*address*/ const uint64_t> SegmentAddressMap;
 typedef std::map</*segment*/ const uint64_t, /*symbolic array*/ ref<Expr>> RemovedObjectsMap;
 
@@ -46,14 +55,23 @@ typedef std::map</*pointer segment*/ const uint64_t, /* offsets*/ std::set<ref<E
 
 class AddressSpace {
   friend class ExecutionState;
+  friend class StateSpiller;
 
   private:
     /// Epoch counter used to control ownership of objects.
     mutable unsigned cowKey;
 
+    /// Approximate number of bytes held by the objects this address space
+    /// owns. Copying an address space gives up the ownership of all objects
+    /// in both copies, so it resets the counter in both of them.
+    mutable uint64_t ownedBytes = 0;
+
     /// Unsupported, use copy constructor
     AddressSpace &operator=(const AddressSpace &);
 
+    /// Stop accounting the object bound to mo if this address space owns it.
+    void releaseOwnedBytes(const MemoryObject *mo);
+
   public:
     /// The MemoryObject -> ObjectState map that constitutes the
     /// address space.
@@ -64,10 +82,18 @@ class AddressSpace {
     /// \invariant forall o in objects, o->copyOnWriteOwner <= cowKey
     MemoryMap objects;
 
+    /// Bindings of all objects with a non-zero segment, kept in sync with
+    /// objects.
     SegmentMap segmentMap;
 
+    /// Concrete addresses of objects that have real process memory.
+    /// Modified only through bindConcreteAddress, which keeps it in sync
+    /// with segmentAddressIndex.
     ConcreteAddressMap concreteAddressMap;
 
+    /// Inverse of concreteAddressMap.
+    SegmentAddressIndex segmentAddressIndex;
+
     RemovedObjectsMap removedObjectsMap;
 
     LazyObjectsMap lazyObjectsMap;
@@ -78,10 +104,21 @@ class AddressSpace {
         objects(b.objects),
         segmentMap(b.segmentMap),
         concreteAddressMap(b.concreteAddressMap),
+        segmentAddressIndex(b.segmentAddressIndex),
         removedObjectsMap(b.removedObjectsMap),
-        lazyObjectsMap(b.lazyObjectsMap){ }
+        lazyObjectsMap(b.lazyObjectsMap) {
+    b.ownedBytes = 0;
+  }
   ~AddressSpace() {}
 
+    /// Returns the approximate number of bytes held by objects that are
+    /// not shared with any other address space.
+    uint64_t getOwnedBytes() const { return ownedBytes; }
+
+    /// Records that the object with the given segment lives at the given
+    /// concrete address. Existing bindings of the address are kept.
+    void bindConcreteAddress(uint64_t address, uint64_t segment);
+
     /// Looks up constant segment in concreteAddressMap.
     /// \param segment segment to search for
     /// \param[out] address found address for given segment
@@ -0,0 +1,541 @@
+//===-- AsyncSolver.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "AsyncSolver.h"
+
+#include "CoreStats.h"
+#include "ExecutionState.h"
+#include "TimingSolver.h"
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Module/InstructionInfoTable.h"
+#include "klee/Module/KInstruction.h"
+#include "klee/Statistics/Statistics.h"
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/Support/Errno.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+/// A condition whose evaluation needs more core queries than this is
+/// solved by the state itself.
+const unsigned MaxCoreQueries = 16;
+
+template <typename T> void append(std::string &out, const T &value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+/// Reads the values written by append, failing on truncated input
+class Reader {
+  const std::string &in;
+  std::size_t pos = 0;
+
+public:
+  explicit Reader(const std::string &in) : in(in) {}
+
+  template <typename T> bool read(T &value) {
+    if (pos + sizeof(T) > in.size())
+      return false;
+    std::memcpy(&value, in.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+  }
+
+  bool atEnd() const { return pos == in.size(); }
+};
+
+bool writeAll(int fd, const std::string &data) {
+  std::size_t written = 0;
+  while (written < data.size()) {
+    ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    written += n;
+  }
+  return true;
+}
+
+std::vector<std::uint64_t> getStatistics() {
+  std::vector<std::uint64_t> values;
+  values.reserve(theStatisticManager->getNumStatistics());
+  for (unsigned i = 0, e = theStatisticManager->getNumStatistics(); i != e;
+       ++i)
+    values.push_back(
+        theStatisticManager->getValue(theStatisticManager->getStatistic(i)));
+  return values;
+}
+
+/// The arrays of a query, which the children share with the executor, so
+/// they are referred to by their position
+std::vector<const Array *> getObjects(const AsyncSolver::Answer &answer) {
+  std::vector<const Array *> objects;
+  findSymbolicObjects(answer.expr, objects);
+  findSymbolicObjects(answer.constraints.begin(), answer.constraints.end(),
+                      objects);
+  std::sort(objects.begin(), objects.end());
+  objects.erase(std::unique(objects.begin(), objects.end()), objects.end());
+  return objects;
+}
+
+void solve(Solver *solver, AsyncSolver::Answer &answer) {
+  Query query(answer.constraints, answer.expr);
+  solver->impl->setCoreSolverTimeout(answer.timeout);
+  switch (answer.kind) {
+  case AsyncSolver::Truth:
+    answer.success = solver->impl->computeTruth(query, answer.isValid);
+    break;
+  case AsyncSolver::Validity:
+    answer.success = solver->impl->computeValidity(query, answer.validity);
+    break;
+  case AsyncSolver::Value:
+    answer.success = solver->impl->computeValue(query, answer.value);
+    break;
+  case AsyncSolver::InitialValues:
+    answer.success = solver->impl->computeInitialValues(
+        query, answer.assignment, answer.hasSolution);
+    break;
+  }
+  answer.status = solver->impl->getOperationStatusCode();
+}
+
+void writeAnswer(const AsyncSolver::Answer &answer, std::string &out) {
+  append<uint8_t>(out, answer.success);
+  append<uint32_t>(out, answer.status);
+  if (!answer.success)
+    return;
+
+  switch (answer.kind) {
+  case AsyncSolver::Truth:
+    append<uint8_t>(out, answer.isValid);
+    break;
+  case AsyncSolver::Validity:
+    append<int8_t>(out, answer.validity);
+    break;
+  case AsyncSolver::Value: {
+    const llvm::APInt &bits = cast<ConstantExpr>(answer.value)->getAPValue();
+    append<uint32_t>(out, bits.getBitWidth());
+    append<uint32_t>(out, bits.getNumWords());
+    out.append(reinterpret_cast<const char *>(bits.getRawData()),
+               bits.getNumWords() * sizeof(uint64_t));
+    break;
+  }
+  case AsyncSolver::InitialValues:
+    append<uint8_t>(out, answer.hasSolution);
+    if (!answer.hasSolution)
+      break;
+    for (const Array *array : getObjects(answer)) {
+      const CompactArrayModel *model =
+          answer.assignment->getBindingsOrNull(array);
+      std::map<uint32_t, uint8_t> values;
+      if (model)
+        values = model->asMap();
+      append<uint8_t>(out, model != nullptr);
+      append<uint32_t>(out, values.size());
+      for (const auto &value : values) {
+        append<uint32_t>(out, value.first);
+        append<uint8_t>(out, value.second);
+      }
+    }
+    break;
+  }
+}
+
+bool readAnswer(Reader &in, AsyncSolver::Answer &answer) {
+  uint8_t success;
+  uint32_t status;
+  if (!in.read(success) || !in.read(status))
+    return false;
+  answer.success = success;
+  answer.status = SolverImpl::SolverRunStatus(status);
+  if (!answer.success)
+    return true;
+
+  switch (answer.kind) {
+  case AsyncSolver::Truth: {
+    uint8_t isValid;
+    if (!in.read(isValid))
+      return false;
+    answer.isValid = isValid;
+    return true;
+  }
+  case AsyncSolver::Validity: {
+    int8_t validity;
+    if (!in.read(validity))
+      return false;
+    answer.validity = Solver::Validity(validity);
+    return true;
+  }
+  case AsyncSolver::Value: {
+    uint32_t width, numWords;
+    if (!in.read(width) || !in.read(numWords))
+      return false;
+    std::vector<uint64_t> words(numWords);
+    for (auto &word : words)
+      if (!in.read(word))
+        return false;
+    answer.value = ConstantExpr::alloc(llvm::APInt(width, words));
+    return true;
+  }
+  case AsyncSolver::InitialValues: {
+    uint8_t hasSolution;
+    if (!in.read(hasSolution))
+      return false;
+    answer.hasSolution = hasSolution;
+    if (!answer.hasSolution)
+      return true;
+    Assignment::map_bindings_ty bindings;
+    for (const Array *array : getObjects(answer)) {
+      uint8_t bound;
+      uint32_t count;
+      if (!in.read(bound) || !in.read(count))
+        return false;
+      if (bound)
+        bindings[array];
+      for (uint32_t i = 0; i < count; ++i) {
+        uint32_t index;
+        uint8_t value;
+        if (!in.read(index) || !in.read(value))
+          return false;
+        bindings[array].add(index, value);
+      }
+    }
+    answer.assignment = std::make_shared<Assignment>(bindings);
+    return true;
+  }
+  }
+  return false;
+}
+} // namespace
+
+bool AsyncSolver::Answer::matches(QueryKind kind, const Query &query) const {
+  return this->kind == kind && expr == query.expr &&
+         constraints.size() == query.constraints.size() &&
+         std::equal(constraints.begin(), constraints.end(),
+                    query.constraints.begin());
+}
+
+namespace klee {
+/// The bottom of the solver chain. During a probe it replays the answers
+/// computed for the probed state and refuses every other query.
+class DeferringSolver : public SolverImpl {
+  AsyncSolver &owner;
+  Solver *solver;
+  /// Status of the last query if it did not reach the core solver
+  SolverRunStatus status = SOLVER_RUN_STATUS_FAILURE;
+  bool intercepted = false;
+
+  /// Returns the answer to replay, or null if the query is refused.
+  const AsyncSolver::Answer *intercept(AsyncSolver::QueryKind kind,
+                                       const Query &query) {
+    intercepted = true;
+    for (const AsyncSolver::Answer &answer : *owner.replayed) {
+      if (answer.matches(kind, query)) {
+        status = answer.status;
+        return &answer;
+      }
+    }
+    if (!owner.deferred) {
+      owner.deferred.reset(new AsyncSolver::Answer());
+      owner.deferred->kind = kind;
+      owner.deferred->constraints = query.constraints;
+      owner.deferred->expr = query.expr;
+      owner.deferred->timeout = owner.coreTimeout;
+    }
+    status = SOLVER_RUN_STATUS_FAILURE;
+    return nullptr;
+  }
+
+public:
+  DeferringSolver(AsyncSolver &owner, Solver *solver)
+      : owner(owner), solver(solver) {}
+  ~DeferringSolver() { delete solver; }
+
+  bool computeTruth(const Query &query, bool &isValid) {
+    if (!owner.replayed) {
+      intercepted = false;
+      return solver->impl->computeTruth(query, isValid);
+    }
+    const AsyncSolver::Answer *answer = intercept(AsyncSolver::Truth, query);
+    if (!answer || !answer->success)
+      return false;
+    isValid = answer->isValid;
+    return true;
+  }
+
+  bool computeValidity(const Query &query, Solver::Validity &result) {
+    if (!owner.replayed) {
+      intercepted = false;
+      return solver->impl->computeValidity(query, result);
+    }
+    const AsyncSolver::Answer *answer =
+        intercept(AsyncSolver::Validity, query);
+    if (!answer || !answer->success)
+      return false;
+    result = answer->validity;
+    return true;
+  }
+
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    if (!owner.replayed) {
+      intercepted = false;
+      return solver->impl->computeValue(query, result);
+    }
+    const AsyncSolver::Answer *answer = intercept(AsyncSolver::Value, query);
+    if (!answer || !answer->success)
+      return false;
+    result = answer->value;
+    return true;
+  }
+
+  bool computeInitialValues(const Query &query,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution) {
+    if (!owner.replayed) {
+      intercepted = false;
+      return solver->impl->computeInitialValues(query, result, hasSolution);
+    }
+    const AsyncSolver::Answer *answer =
+        intercept(AsyncSolver::InitialValues, query);
+    if (!answer || !answer->success)
+      return false;
+    hasSolution = answer->hasSolution;
+    result = answer->assignment;
+    return true;
+  }
+
+  SolverRunStatus getOperationStatusCode() {
+    return intercepted ? status : solver->impl->getOperationStatusCode();
+  }
+
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+
+  void setCoreSolverTimeout(time::Span timeout) {
+    owner.coreTimeout = timeout;
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+};
+} // namespace klee
+
+AsyncSolver::~AsyncSolver() {
+  std::vector<ExecutionState *> cancelled;
+  cancelAll(cancelled);
+}
+
+Solver *AsyncSolver::wrapCoreSolver(Solver *solver) {
+  coreSolver = solver;
+  return new Solver(new DeferringSolver(*this, solver));
+}
+
+bool AsyncSolver::canSubmit(const ExecutionState &state) const {
+  if (inFlight.size() >= maxInFlight)
+    return false;
+  auto it = states.find(&state);
+  return it == states.end() || (!it->second.synchronous &&
+                                it->second.answers.size() < MaxCoreQueries);
+}
+
+AsyncSolver::Outcome AsyncSolver::probe(TimingSolver &solver,
+                                        ExecutionState &state,
+                                        ref<Expr> condition,
+                                        time::Span timeout,
+                                        Solver::Validity &result) {
+  assert(coreSolver && "core solver not wrapped");
+  std::vector<std::uint64_t> before = getStatistics();
+  time::Span cost = state.queryMetaData.queryCost;
+  unsigned index = theStatisticManager->getIndex();
+  theStatisticManager->setIndex(state.pc->info->id);
+
+  replayed = &states[&state].answers;
+  deferred.reset();
+  solver.setTimeout(timeout);
+  bool success = solver.evaluate(state.constraints, condition, result,
+                                 state.queryMetaData);
+  solver.setTimeout(time::Span());
+  replayed = nullptr;
+
+  Outcome outcome;
+  if (deferred) {
+    // the evaluation is repeated once the core query is answered
+    std::vector<std::uint64_t> after = getStatistics();
+    for (unsigned i = 0; i != after.size(); ++i)
+      if (after[i] != before[i])
+        theStatisticManager->incrementStatistic(
+            theStatisticManager->getStatistic(i), before[i] - after[i]);
+    state.queryMetaData.queryCost = cost;
+    outcome = Deferred;
+  } else {
+    states.erase(&state);
+    outcome = success ? Answered : Failed;
+  }
+  theStatisticManager->setIndex(index);
+  return outcome;
+}
+
+bool AsyncSolver::submit(ExecutionState &state) {
+  assert(deferred && canSubmit(state) && !isParked(state));
+
+  int fds[2];
+  if (pipe(fds) == -1) {
+    klee_warning("pipe failed (for async solver) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    states[&state].synchronous = true;
+    return false;
+  }
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid == -1) {
+    klee_warning("fork failed (for async solver) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    close(fds[0]);
+    close(fds[1]);
+    states[&state].synchronous = true;
+    return false;
+  }
+
+  if (pid == 0) {
+    // the child is killed by the parent or interrupted along with it; it
+    // only runs the core solver, the layers above it stay in the parent
+    ::signal(SIGINT, SIG_DFL);
+    close(fds[0]);
+    std::vector<std::uint64_t> before = getStatistics();
+    time::Point start = time::getWallTime();
+    solve(coreSolver, *deferred);
+
+    std::string out;
+    writeAnswer(*deferred, out);
+    append<uint64_t>(out, (time::getWallTime() - start).toMicroseconds());
+    std::vector<std::uint64_t> after = getStatistics();
+    append<uint32_t>(out, after.size());
+    for (unsigned i = 0; i != after.size(); ++i)
+      append<uint64_t>(out, after[i] - before[i]);
+    _exit(writeAll(fds[1], out) ? 0 : 1);
+  }
+
+  close(fds[1]);
+  inFlight.emplace(pid, Pending{&state, std::move(deferred), fds[0]});
+  parked[&state] = pid;
+  return true;
+}
+
+void AsyncSolver::finish(pid_t pid, bool readResult) {
+  auto it = inFlight.find(pid);
+  assert(it != inFlight.end());
+  Pending &pending = it->second;
+
+  std::string payload;
+  if (readResult) {
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(pending.fd, buffer, sizeof(buffer))) != 0) {
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0)
+        break;
+      payload.append(buffer, n);
+    }
+  } else {
+    kill(pid, SIGKILL);
+  }
+  close(pending.fd);
+  int status;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    ;
+
+  ExecutionState &state = *pending.state;
+  StateAnswers &entry = states[&state];
+  Reader in(payload);
+  uint64_t elapsed;
+  uint32_t numStatistics;
+  bool complete = readResult && WIFEXITED(status) &&
+                  WEXITSTATUS(status) == 0 &&
+                  readAnswer(in, *pending.query) && in.read(elapsed) &&
+                  in.read(numStatistics) &&
+                  numStatistics == theStatisticManager->getNumStatistics();
+  std::vector<uint64_t> deltas(complete ? numStatistics : 0);
+  for (auto &delta : deltas)
+    complete = complete && in.read(delta);
+
+  if (complete && in.atEnd()) {
+    // the work of the child is charged to the branch, as if the state had
+    // solved the query itself
+    unsigned index = theStatisticManager->getIndex();
+    theStatisticManager->setIndex(state.pc->info->id);
+    for (unsigned i = 0; i != deltas.size(); ++i)
+      if (deltas[i])
+        theStatisticManager->incrementStatistic(
+            theStatisticManager->getStatistic(i), deltas[i]);
+    stats::solverTime += elapsed;
+    theStatisticManager->setIndex(index);
+    state.queryMetaData.queryCost += time::microseconds(elapsed);
+    entry.answers.push_back(std::move(*pending.query));
+  } else {
+    // without an answer the state asks the solver itself when it continues
+    entry.synchronous = true;
+  }
+
+  parked.erase(&state);
+  inFlight.erase(it);
+}
+
+void AsyncSolver::collect(time::Span timeout,
+                          std::vector<ExecutionState *> &finished) {
+  if (inFlight.empty())
+    return;
+
+  std::vector<struct pollfd> pfds;
+  std::vector<pid_t> pids;
+  for (const auto &pending : inFlight) {
+    pfds.push_back({pending.second.fd, POLLIN, 0});
+    pids.push_back(pending.first);
+  }
+  int ready;
+  while ((ready = poll(pfds.data(), pfds.size(),
+                       timeout.toMicroseconds() / 1000)) < 0 &&
+         errno == EINTR)
+    ;
+  if (ready < 0) {
+    klee_warning("poll failed (for async solver) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return;
+  }
+
+  for (unsigned i = 0; i != pfds.size(); ++i) {
+    if (!pfds[i].revents)
+      continue;
+    finished.push_back(inFlight.find(pids[i])->second.state);
+    finish(pids[i], true);
+  }
+}
+
+void AsyncSolver::cancelAll(std::vector<ExecutionState *> &cancelled) {
+  while (!inFlight.empty()) {
+    pid_t pid = inFlight.begin()->first;
+    cancelled.push_back(inFlight.begin()->second.state);
+    finish(pid, false);
+  }
+}
@@ -0,0 +1,148 @@
+//===-- AsyncSolver.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_ASYNCSOLVER_H
+#define KLEE_ASYNCSOLVER_H
+
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/System/Time.h"
+
+#include <sys/types.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+class Assignment;
+class ExecutionState;
+class TimingSolver;
+
+/// Solves the core solver queries of branch conditions in forked processes
+/// while the executor keeps running other states.
+///
+/// The executor first evaluates a branch condition with the core solver
+/// disabled (probe), so that it is answered by the caches whenever
+/// possible. Only if a query reaches the core solver, the state is parked:
+/// the executor takes it out of the searcher and a forked process solves
+/// that core query alone. The answer and the statistics of the child are
+/// sent back, and once the state is selected again the condition is
+/// evaluated anew with the core solver replaying the answer. Every layer of
+/// the chain above the core solver, including the persistent cache, thus
+/// only ever runs in the executor and keeps its results. A condition may
+/// need several core queries, each of them parks the state once.
+class AsyncSolver {
+public:
+  enum QueryKind { Truth, Validity, Value, InitialValues };
+
+  /// A core solver query and its answer
+  struct Answer {
+    QueryKind kind;
+    ConstraintSet constraints;
+    ref<Expr> expr;
+    /// Timeout of the core solver when the query was made
+    time::Span timeout;
+
+    bool success = false;
+    SolverImpl::SolverRunStatus status = SolverImpl::SOLVER_RUN_STATUS_FAILURE;
+    bool isValid = false;
+    Solver::Validity validity = Solver::Unknown;
+    ref<Expr> value;
+    std::shared_ptr<const Assignment> assignment;
+    bool hasSolution = false;
+
+    bool matches(QueryKind kind, const Query &query) const;
+  };
+
+  enum Outcome {
+    /// The condition was evaluated without the core solver
+    Answered,
+    /// The solver failed without the core solver being needed
+    Failed,
+    /// The core solver is needed, the state can be parked
+    Deferred
+  };
+
+private:
+  friend class DeferringSolver;
+
+  struct Pending {
+    ExecutionState *state;
+    std::unique_ptr<Answer> query;
+    int fd;
+  };
+
+  /// Answers computed for a state so far
+  struct StateAnswers {
+    std::vector<Answer> answers;
+    /// Set if a child failed, the state then solves its condition itself
+    bool synchronous = false;
+  };
+
+  Solver *coreSolver = nullptr;
+  unsigned maxInFlight;
+  std::unordered_map<pid_t, Pending> inFlight;
+  std::unordered_map<const ExecutionState *, pid_t> parked;
+  std::unordered_map<const ExecutionState *, StateAnswers> states;
+
+  /// Answers the core solver replays during a probe, null otherwise
+  const std::vector<Answer> *replayed = nullptr;
+  /// The first core query a probe could not answer
+  std::unique_ptr<Answer> deferred;
+  time::Span coreTimeout;
+
+  void finish(pid_t pid, bool readResult);
+
+public:
+  explicit AsyncSolver(unsigned maxInFlight) : maxInFlight(maxInFlight) {}
+  /// Kills the children of queries still in flight.
+  ~AsyncSolver();
+
+  /// Returns a solver for the bottom of the solver chain that forwards to
+  /// coreSolver, except during a probe. The returned solver owns
+  /// coreSolver.
+  Solver *wrapCoreSolver(Solver *coreSolver);
+
+  bool canSubmit(const ExecutionState &state) const;
+  bool hasInFlight() const { return !inFlight.empty(); }
+  bool isParked(const ExecutionState &state) const {
+    return parked.count(&state) != 0;
+  }
+
+  /// Evaluate condition under the constraints of state without running
+  /// the core solver, except for replaying the answers already computed
+  /// for state. Statistics of a deferred evaluation are undone, since it
+  /// is repeated when the state continues.
+  Outcome probe(TimingSolver &solver, ExecutionState &state,
+                ref<Expr> condition, time::Span timeout,
+                Solver::Validity &result);
+
+  /// Park state and start solving the core query deferred by its probe in
+  /// a forked process.
+  /// \return false if the process could not be started
+  bool submit(ExecutionState &state);
+
+  /// Collect the states whose queries have finished, waiting up to timeout
+  /// for the first one.
+  void collect(time::Span timeout, std::vector<ExecutionState *> &finished);
+
+  /// Abandon all queries in flight; their states are returned and solve
+  /// their conditions themselves.
+  void cancelAll(std::vector<ExecutionState *> &cancelled);
+
+  /// Drop the answers computed for a state that is terminated.
+  void forget(const ExecutionState &state) { states.erase(&state); }
+};
+
+} // namespace klee
+
+#endif /* KLEE_ASYNCSOLVER_H */
@@ -0,0 +1,404 @@
+//===-- ConcreteJIT.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ConcreteJIT.h"
+
+#include "klee/Config/Version.h"
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(11, 0)
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#endif
+
+#include <cinttypes>
+#include <set>
+#include <string>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+bool isNativeInteger(const Type *type) {
+  return type->isIntegerTy() && type->getIntegerBitWidth() <= 64;
+}
+
+/// Check whether v is an alloca that only serves as a scalar variable, i.e.
+/// it is only loaded and stored as a whole and does not escape.
+bool isScalarSlot(const Value *v) {
+  auto alloca = dyn_cast<AllocaInst>(v);
+  if (!alloca || alloca->isArrayAllocation())
+    return false;
+  Type *type = alloca->getAllocatedType();
+  if (!type->isIntegerTy())
+    return false;
+  for (const User *user : alloca->users()) {
+    if (auto load = dyn_cast<LoadInst>(user)) {
+      if (load->isVolatile() || load->getType() != type)
+        return false;
+    } else if (auto store = dyn_cast<StoreInst>(user)) {
+      if (store->isVolatile() || store->getValueOperand() == alloca ||
+          store->getValueOperand()->getType() != type)
+        return false;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Check whether operand is a constant the instruction cannot trap on, or
+/// be undefined for, natively.
+bool isSafeConstant(const Instruction &inst, const Value *operand) {
+  auto c = dyn_cast<ConstantInt>(operand);
+  if (!c)
+    return false;
+  switch (inst.getOpcode()) {
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+    return c->getValue().ult(c->getBitWidth());
+  case Instruction::SDiv:
+  case Instruction::SRem:
+    return !c->isZero() && !c->isMinusOne();
+  default:
+    return !c->isZero();
+  }
+}
+} // namespace
+
+ConcreteJIT::ConcreteJIT(Filter interpretOnly, std::uint64_t budget)
+    : interpretOnly(std::move(interpretOnly)), budget(budget) {
+#if LLVM_VERSION_CODE >= LLVM_VERSION(11, 0)
+  auto created = orc::LLJITBuilder().create();
+  if (!created) {
+    klee_warning("Unable to create the JIT for concrete functions: %s",
+                 toString(created.takeError()).c_str());
+    return;
+  }
+  jit = std::move(*created);
+#else
+  klee_warning("JIT for concrete functions requires LLVM 11 or newer");
+#endif
+}
+
+ConcreteJIT::~ConcreteJIT() = default;
+
+bool ConcreteJIT::isEligible(const Function &f) {
+  if (!jit)
+    return false;
+  auto it = eligible.find(&f);
+  if (it != eligible.end())
+    return it->second;
+  // recursive calls find the function not eligible
+  eligible[&f] = false;
+  bool result = analyze(f);
+  eligible[&f] = result;
+  return result;
+}
+
+bool ConcreteJIT::analyze(const Function &f) {
+  if (f.isDeclaration() || f.isVarArg() || interpretOnly(f))
+    return false;
+  if (!f.getReturnType()->isVoidTy() && !isNativeInteger(f.getReturnType()))
+    return false;
+  for (const Argument &arg : f.args())
+    if (!isNativeInteger(arg.getType()))
+      return false;
+
+  for (const Instruction &inst : instructions(f)) {
+    Type *type = inst.getType();
+    if (!type->isVoidTy() && !type->isIntegerTy() && !isa<AllocaInst>(inst))
+      return false;
+
+    switch (inst.getOpcode()) {
+    case Instruction::Add:
+    case Instruction::Sub:
+    case Instruction::Mul:
+    case Instruction::And:
+    case Instruction::Or:
+    case Instruction::Xor:
+    case Instruction::Trunc:
+    case Instruction::ZExt:
+    case Instruction::SExt:
+    case Instruction::Select:
+    case Instruction::PHI:
+    case Instruction::Br:
+    case Instruction::Switch:
+    case Instruction::Ret:
+      break;
+    case Instruction::ICmp:
+      if (!inst.getOperand(0)->getType()->isIntegerTy())
+        return false;
+      break;
+    case Instruction::Shl:
+    case Instruction::LShr:
+    case Instruction::AShr:
+    case Instruction::UDiv:
+    case Instruction::SDiv:
+    case Instruction::URem:
+    case Instruction::SRem:
+      if (!isSafeConstant(inst, inst.getOperand(1)))
+        return false;
+      break;
+    case Instruction::Alloca:
+      if (!isScalarSlot(&inst))
+        return false;
+      break;
+    case Instruction::Load:
+      if (!isScalarSlot(cast<LoadInst>(inst).getPointerOperand()))
+        return false;
+      break;
+    case Instruction::Store:
+      if (!isScalarSlot(cast<StoreInst>(inst).getPointerOperand()))
+        return false;
+      break;
+    case Instruction::Call: {
+      if (isa<DbgInfoIntrinsic>(inst))
+        break;
+      const Function *callee = cast<CallInst>(inst).getCalledFunction();
+      if (!callee || !isEligible(*callee))
+        return false;
+      break;
+    }
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+#if LLVM_VERSION_CODE >= LLVM_VERSION(11, 0)
+namespace {
+/// Make the clone of a function count the basic blocks it enters in
+/// budget and return as soon as it is used up, also after calls that used
+/// it up. Entering the i-th block of blocks sets ran[i].
+void instrument(Function &clone, GlobalVariable *budget, GlobalVariable *ran,
+                const std::vector<BasicBlock *> &blocks, unsigned first) {
+  LLVMContext &ctx = clone.getContext();
+  Type *int64 = Type::getInt64Ty(ctx);
+  Type *retType = clone.getReturnType();
+
+  // the returned value is never used, the caller gives up as well
+  BasicBlock *bail = BasicBlock::Create(ctx, "budget.exhausted", &clone);
+  if (retType->isVoidTy())
+    ReturnInst::Create(ctx, bail);
+  else
+    ReturnInst::Create(ctx, Constant::getNullValue(retType), bail);
+
+  std::vector<CallInst *> calls;
+  for (BasicBlock *bb : blocks)
+    for (Instruction &inst : *bb)
+      if (auto call = dyn_cast<CallInst>(&inst))
+        if (!isa<DbgInfoIntrinsic>(call))
+          calls.push_back(call);
+
+  for (unsigned i = 0; i < blocks.size(); ++i) {
+    BasicBlock *bb = blocks[i];
+    // static allocas have to stay in the entry block
+    BasicBlock::iterator split = bb->getFirstInsertionPt();
+    while (isa<AllocaInst>(*split))
+      ++split;
+    BasicBlock *body = bb->splitBasicBlock(split);
+    bb->getTerminator()->eraseFromParent();
+    IRBuilder<> builder(bb);
+    Value *left = builder.CreateLoad(int64, budget);
+    builder.CreateCondBr(builder.CreateICmpEQ(left, builder.getInt64(0)),
+                         bail, body);
+    builder.SetInsertPoint(&*body->getFirstInsertionPt());
+    builder.CreateStore(builder.CreateSub(left, builder.getInt64(1)), budget);
+    builder.CreateStore(builder.getInt8(1),
+                        builder.CreateConstInBoundsGEP2_64(
+                            ran->getValueType(), ran, 0, first + i));
+  }
+
+  for (CallInst *call : calls) {
+    BasicBlock *bb = call->getParent();
+    BasicBlock *next = bb->splitBasicBlock(call->getNextNode());
+    bb->getTerminator()->eraseFromParent();
+    IRBuilder<> builder(bb);
+    Value *left = builder.CreateLoad(int64, budget);
+    builder.CreateCondBr(builder.CreateICmpEQ(left, builder.getInt64(0)),
+                         bail, next);
+  }
+}
+
+template <typename T> T *lookupAddress(orc::LLJIT &jit, StringRef name) {
+  auto symbol = jit.lookup(name);
+  if (!symbol) {
+    consumeError(symbol.takeError());
+    return nullptr;
+  }
+#if LLVM_VERSION_CODE >= LLVM_VERSION(15, 0)
+  return symbol->toPtr<T *>();
+#else
+  return reinterpret_cast<T *>(symbol->getAddress());
+#endif
+}
+} // namespace
+#endif
+
+void ConcreteJIT::collectCallees(const Function &f,
+                                 std::set<const Function *> &functions) {
+  functions.insert(&f);
+  std::vector<const Function *> worklist{&f};
+  while (!worklist.empty()) {
+    const Function *current = worklist.back();
+    worklist.pop_back();
+    for (const Instruction &inst : instructions(current))
+      if (auto call = dyn_cast<CallInst>(&inst))
+        if (!isa<DbgInfoIntrinsic>(call) &&
+            functions.insert(call->getCalledFunction()).second)
+          worklist.push_back(call->getCalledFunction());
+  }
+}
+
+ConcreteJIT::Compiled ConcreteJIT::compile(Function &f) {
+  Compiled compiled;
+#if LLVM_VERSION_CODE >= LLVM_VERSION(11, 0)
+  std::set<const Function *> functions;
+  collectCallees(f, functions);
+
+  ValueToValueMapTy map;
+  std::unique_ptr<Module> module =
+      CloneModule(*f.getParent(), map, [&](const GlobalValue *gv) {
+        auto function = dyn_cast<Function>(gv);
+        return function && functions.count(function);
+      });
+
+  LLVMContext &ctx = module->getContext();
+  Type *int64 = Type::getInt64Ty(ctx);
+  const std::string suffix = "." + std::to_string(entries.size());
+  const std::string name = "klee_jit_entry" + suffix;
+  const std::string budgetName = "klee_jit_budget" + suffix;
+  const std::string ranName = "klee_jit_ran" + suffix;
+
+  std::map<const Function *, std::vector<BasicBlock *>> clonedBlocks;
+  for (const Function *function : functions)
+    for (const BasicBlock &bb : *function) {
+      compiled.blocks.push_back(&bb);
+      clonedBlocks[function].push_back(cast<BasicBlock>(map[&bb]));
+    }
+  auto budgetVar = new GlobalVariable(*module, int64, false,
+                                      GlobalValue::ExternalLinkage,
+                                      ConstantInt::get(int64, 0), budgetName);
+  auto ranType =
+      ArrayType::get(Type::getInt8Ty(ctx), compiled.blocks.size());
+  auto ranVar = new GlobalVariable(*module, ranType, false,
+                                   GlobalValue::ExternalLinkage,
+                                   ConstantAggregateZero::get(ranType),
+                                   ranName);
+  unsigned first = 0;
+  for (const Function *function : functions) {
+    auto clone = cast<Function>(map[function]);
+    clone->setLinkage(GlobalValue::InternalLinkage);
+    clone->setComdat(nullptr);
+    instrument(*clone, budgetVar, ranVar, clonedBlocks[function], first);
+    first += clonedBlocks[function].size();
+  }
+
+  // entry(args) stores the result of f(args[1], ...) in args[0]
+  Function *entry = Function::Create(
+      FunctionType::get(Type::getVoidTy(ctx), {int64->getPointerTo()}, false),
+      GlobalValue::ExternalLinkage, name, module.get());
+  IRBuilder<> builder(BasicBlock::Create(ctx, "entry", entry));
+  Value *args = &*entry->arg_begin();
+  std::vector<Value *> callArgs;
+  for (const Argument &arg : f.args()) {
+    Value *slot = builder.CreateConstGEP1_64(int64, args, arg.getArgNo() + 1);
+    callArgs.push_back(builder.CreateTrunc(builder.CreateLoad(int64, slot),
+                                           arg.getType()));
+  }
+  Value *result = builder.CreateCall(cast<Function>(map[&f]), callArgs);
+  if (!f.getReturnType()->isVoidTy())
+    builder.CreateStore(builder.CreateZExt(result, int64), args);
+  builder.CreateRetVoid();
+
+  // the JIT owns the context of its modules
+  SmallVector<char, 0> buffer;
+  raw_svector_ostream os(buffer);
+  WriteBitcodeToFile(*module, os);
+  auto context = std::make_unique<LLVMContext>();
+  auto parsed = parseBitcodeFile(
+      MemoryBufferRef(StringRef(buffer.data(), buffer.size()), name),
+      *context);
+  if (!parsed) {
+    klee_warning_once(&f, "Unable to compile %s natively: %s",
+                      f.getName().str().c_str(),
+                      toString(parsed.takeError()).c_str());
+    return compiled;
+  }
+  if (auto error = jit->addIRModule(
+          orc::ThreadSafeModule(std::move(*parsed), std::move(context)))) {
+    klee_warning_once(&f, "Unable to compile %s natively: %s",
+                      f.getName().str().c_str(),
+                      toString(std::move(error)).c_str());
+    return compiled;
+  }
+  auto address = lookupAddress<void(std::uint64_t *)>(*jit, name);
+  compiled.budget = lookupAddress<std::uint64_t>(*jit, budgetName);
+  compiled.ran = lookupAddress<std::uint8_t>(*jit, ranName);
+  if (!address || !compiled.budget || !compiled.ran) {
+    klee_warning_once(&f, "Unable to compile %s natively: symbols missing",
+                      f.getName().str().c_str());
+    return compiled;
+  }
+  compiled.entry = address;
+  compiled.reported.resize(compiled.blocks.size());
+#endif
+  return compiled;
+}
+
+bool ConcreteJIT::call(Function &f, const std::vector<std::uint64_t> &arguments,
+                       std::uint64_t &result,
+                       std::vector<const BasicBlock *> &ran) {
+  assert(isEligible(f) && "calling a function that cannot run natively");
+  auto it = entries.find(&f);
+  if (it == entries.end())
+    it = entries.emplace(&f, compile(f)).first;
+  Compiled &compiled = it->second;
+  if (!compiled.entry || compiled.exhausted)
+    return false;
+
+  std::vector<std::uint64_t> args(arguments.size() + 1);
+  std::copy(arguments.begin(), arguments.end(), args.begin() + 1);
+  *compiled.budget = budget;
+  compiled.entry(args.data());
+
+  if (*compiled.budget == 0) {
+    // the run is discarded, the interpreter runs these blocks again
+    compiled.exhausted = true;
+    for (std::size_t i = 0; i < compiled.blocks.size(); ++i)
+      if (!compiled.reported[i])
+        compiled.ran[i] = 0;
+    klee_warning_once(&f,
+                      "%s did not finish natively within %" PRIu64
+                      " basic blocks, it is interpreted from now on",
+                      f.getName().str().c_str(), budget);
+    return false;
+  }
+
+  for (std::size_t i = 0; i < compiled.blocks.size(); ++i) {
+    if (compiled.ran[i] && !compiled.reported[i]) {
+      compiled.reported[i] = true;
+      ran.push_back(compiled.blocks[i]);
+    }
+  }
+  result = args[0];
+  return true;
+}
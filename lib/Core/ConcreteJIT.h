@@ -0,0 +1,104 @@
+//===-- ConcreteJIT.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CONCRETEJIT_H
+#define KLEE_CONCRETEJIT_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace llvm {
+class BasicBlock;
+class Function;
+namespace orc {
+class LLJIT;
+}
+} // namespace llvm
+
+namespace klee {
+
+/// Compiles functions of the module with LLVM ORC and runs them natively.
+///
+/// Only functions that cannot observe or modify memory of the executed
+/// program are compiled: their arguments and results are integers, they
+/// only load and store through scalar stack slots of their own and only
+/// call functions of the same kind. Neither memory nor the state has to be
+/// synchronized with a native run then, it is equivalent to interpreting
+/// the function on the same concrete arguments. Instructions that trap or
+/// are undefined natively (division by a non-constant, shifts by a
+/// non-constant, unreachable) and recursion keep a function interpreted.
+///
+/// Loops may not terminate, so the compiled code counts the basic blocks it
+/// enters and gives up once a budget is used up; the function is then
+/// interpreted, where the limits of the executor apply. The compiled code
+/// also records which basic blocks ran, for coverage.
+class ConcreteJIT {
+public:
+  /// Decides about functions that must be interpreted regardless of their
+  /// body, e.g. because the executor handles calls to them itself.
+  using Filter = std::function<bool(const llvm::Function &)>;
+
+private:
+  typedef void (*Entry)(std::uint64_t *);
+
+  struct Compiled {
+    /// Entry point, null if compiling failed
+    Entry entry = nullptr;
+    /// Basic blocks the compiled code may still enter
+    std::uint64_t *budget = nullptr;
+    /// Set by the compiled code when it enters blocks[i]
+    std::uint8_t *ran = nullptr;
+    std::vector<const llvm::BasicBlock *> blocks;
+    /// Whether blocks[i] was already reported as run
+    std::vector<bool> reported;
+    /// A run used up the budget, the function is interpreted from then on
+    bool exhausted = false;
+  };
+
+  Filter interpretOnly;
+  std::uint64_t budget;
+  std::unique_ptr<llvm::orc::LLJIT> jit;
+  /// Result of the analysis, false while the function is being analyzed
+  std::map<const llvm::Function *, bool> eligible;
+  std::map<const llvm::Function *, Compiled> entries;
+
+  bool analyze(const llvm::Function &f);
+  /// Collect f and all functions it calls, directly or transitively, that
+  /// is all functions that run natively when f does.
+  static void collectCallees(const llvm::Function &f,
+                             std::set<const llvm::Function *> &functions);
+  Compiled compile(llvm::Function &f);
+
+public:
+  /// \param budget - The number of basic blocks a native call may enter.
+  ConcreteJIT(Filter interpretOnly, std::uint64_t budget);
+  ~ConcreteJIT();
+
+  /// Check whether f can be run natively.
+  bool isEligible(const llvm::Function &f);
+
+  /// Run f natively, compiling it first if needed. f must be eligible.
+  /// \param arguments - The zero extended arguments.
+  /// \param result - Receives the zero extended result.
+  /// \param ran - Receives the basic blocks that ran natively for the first
+  /// time.
+  /// \return false if f could not be compiled or did not finish within the
+  /// budget; f has to be interpreted then
+  bool call(llvm::Function &f, const std::vector<std::uint64_t> &arguments,
+            std::uint64_t &result,
+            std::vector<const llvm::BasicBlock *> &ran);
+};
+
+} // namespace klee
+
+#endif /* KLEE_CONCRETEJIT_H */
@@ -27,6 +27,16 @@ namespace stats {
   extern Statistic forkTime;
   extern Statistic solverTime;
 
+  /// The number of executed loads and stores.
+  extern Statistic memoryOperations;
+
+  /// The number of loads and stores with a constant address that were
+  /// checked to be in bounds without querying the solver.
+  extern Statistic concreteMemoryOperations;
+
+  /// The number of calls run natively (see --jit-concrete-functions).
+  extern Statistic nativeCalls;
+
   /// The number of process forks.
   extern Statistic forks;
 
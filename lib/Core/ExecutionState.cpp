@@ -46,6 +46,18 @@ cl::opt<bool> DebugLogStateMerge(
 
 std::uint32_t ExecutionState::nextID = 1;
 
+namespace {
+/// Approximate number of bytes held by a stack frame of kf.
+std::uint64_t getFrameBytes(const KFunction *kf) {
+  return sizeof(StackFrame) + kf->numRegisters * sizeof(Cell);
+}
+
+/// Approximate number of bytes a constraint adds to a state: its slot in
+/// the constraint set and the top-level node, whose operands are usually
+/// shared with the values they were computed from.
+const std::uint64_t ConstraintBytes = sizeof(ref<Expr>) + sizeof(BinaryExpr);
+} // namespace
+
 /***/
 
 StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf)
@@ -112,7 +124,11 @@ ExecutionState::ExecutionState(const ExecutionState& state):
                              ? state.unwindingInformation->clone()
                              : nullptr),
     coveredNew(state.coveredNew),
-    forkDisabled(state.forkDisabled) {
+    forkDisabled(state.forkDisabled),
+    stackBytes(state.stackBytes) {
+  // the model satisfies the constraints of both states
+  queryMetaData.lastModel = state.queryMetaData.lastModel;
+
   for (const auto &cur_mergehandler: openMergeStack)
     cur_mergehandler->addOpenState(this);
 }
@@ -130,15 +146,22 @@ ExecutionState *ExecutionState::branch() {
 
 void ExecutionState::pushFrame(KInstIterator caller, KFunction *kf) {
   stack.emplace_back(StackFrame(caller, kf));
+  stackBytes += getFrameBytes(kf);
 }
 
 void ExecutionState::popFrame() {
   const StackFrame &sf = stack.back();
   for (const auto * memoryObject : sf.allocas)
     addressSpace.unbindObject(memoryObject);
+  stackBytes -= getFrameBytes(sf.kf);
   stack.pop_back();
 }
 
+std::uint64_t ExecutionState::getOwnedBytes() const {
+  return addressSpace.getOwnedBytes() + stackBytes +
+         constraints.size() * ConstraintBytes;
+}
+
 void ExecutionState::removeAlloca(const MemoryObject *mo) {
   StackFrame &sf = stack.back();
   unsigned idx = 0;
@@ -320,13 +343,14 @@ bool ExecutionState::merge(const ExecutionState &b) {
     StackFrame &af = *itA;
     const StackFrame &bf = *itB;
     for (unsigned i=0; i<af.kf->numRegisters; i++) {
-      ref<Expr> &av = af.locals[i].value;
-      const ref<Expr> &bv = bf.locals[i].value;
+      ref<Expr> av = af.locals[i].getValue();
+      ref<Expr> bv = bf.locals[i].getValue();
       if (!av || !bv) {
         // if one is null then by implication (we are at same pc)
         // we cannot reuse this local, so just ignore
       } else {
-        av = SelectExpr::create(inA, av, bv);
+        af.locals[i] = KValue(af.locals[i].getSegment(),
+                              SelectExpr::create(inA, av, bv));
       }
     }
   }
@@ -381,7 +405,7 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
 
       out << ai->getName().str();
       // XXX should go through function
-      ref<Expr> value = sf.locals[sf.kf->getArgRegister(index++)].value;
+      ref<Expr> value = sf.locals[sf.kf->getArgRegister(index++)].getValue();
       if (isa_and_nonnull<ConstantExpr>(value))
         out << "=" << value;
     }
@@ -266,6 +266,16 @@ public:
   /// @brief Metadata utilized and collected by solvers for this state
   mutable SolverQueryMetaData queryMetaData;
 
+  /// @brief Validity of a branch condition computed before parking the
+  /// state or while it was parked, used by the next fork on exactly that
+  /// condition
+  struct ParkedResult {
+    ref<Expr> condition;
+    Solver::Validity validity = Solver::Unknown;
+    /// False if the solver failed, e.g. timed out
+    bool success = true;
+  } parkedResult;
+
   /// @brief History of complete path: represents branches taken to
   /// reach/create this state (both concrete and symbolic)
   TreeOStream pathOS;
@@ -318,6 +328,10 @@ public:
   /// @brief Disables forking for this state. Set by user code
   bool forkDisabled = false;
 
+private:
+  /// @brief Approximate number of bytes held by the stack frames
+  std::uint64_t stackBytes = 0;
+
 public:
 #ifdef KLEE_UNITTEST
   // provide this function only in the context of unittests
@@ -338,6 +352,11 @@ public:
 
   void pushFrame(KInstIterator caller, KFunction *kf);
   void popFrame();
+
+  /// @brief Approximate number of bytes held by this state that are not
+  /// shared with other states: the objects it owns in its address space,
+  /// its stack frames and its constraints
+  std::uint64_t getOwnedBytes() const;
   void removeAlloca(const MemoryObject *mo);
 
   void addSymbolic(const MemoryObject *mo, const Array *array);
@@ -9,6 +9,8 @@
 
 #include "Executor.h"
 
+#include "AsyncSolver.h"
+#include "ConcreteJIT.h"
 #include "Context.h"
 #include "CoreStats.h"
 #include "ExecutionState.h"
@@ -18,9 +20,11 @@
 #include "Memory.h"
 #include "MemoryManager.h"
 #include "PTree.h"
+#include "QueryProfiler.h"
 #include "Searcher.h"
 #include "SeedInfo.h"
 #include "SpecialFunctionHandler.h"
+#include "StateSpiller.h"
 #include "StatsTracker.h"
 #include "TimingSolver.h"
 #include "UserSearcher.h"
@@ -82,12 +86,14 @@ typedef unsigned TypeSize;
 #include <algorithm>
 #include <cassert>
 #include <cerrno>
+#include <cinttypes>
 #include <cstring>
 #include <cxxabi.h>
 #include <fstream>
 #include <iomanip>
 #include <iosfwd>
 #include <limits>
+#include <numeric>
 #include <sstream>
 #include <string>
 #include <sys/mman.h>
@@ -179,6 +185,34 @@ cl::opt<bool>
                                   "querying the solver (default=true)"),
                          cl::cat(SolvingCat));
 
+// Off by default: the model decides few queries, and the counterexample
+// queries it needs cost about as much solver time as the ones it saves.
+cl::opt<bool>
+    UseStateModel("use-state-model", cl::init(false),
+                  cl::desc("Answer queries from the last satisfying "
+                           "assignment found for a state where it decides "
+                           "them. Truth queries then ask for "
+                           "counterexamples, which needs every independent "
+                           "factor of the constraints solved "
+                           "(default=false)"),
+                  cl::cat(SolvingCat));
+
+cl::opt<bool> ProfileQueries(
+    "profile-queries", cl::init(false),
+    cl::desc("Record every solver query with its origin, instruction, size "
+             "and time per solver layer in query-profile.bin and summarize "
+             "them per instruction in query-profile.stats, see klee-stats "
+             "--query-profile (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> AsyncSolverQueries(
+    "async-solver-queries", cl::init(0),
+    cl::desc("Solve the core solver queries of up to this many symbolic "
+             "branch conditions in forked processes while other states keep "
+             "executing; conditions the caches decide are not deferred "
+             "(default=0 (off))"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool>
     LazyInitialization("lazy-init",
                        cl::desc("Initialize external pointers lazily"),
@@ -243,6 +277,25 @@ cl::opt<bool> AllExternalWarnings(
              "as opposed to once per function (default=false)"),
     cl::cat(ExtCallsCat));
 
+cl::opt<bool> JITConcreteFunctions(
+    "jit-concrete-functions",
+    cl::init(false),
+    cl::desc("Compile functions that only compute on integers and run them "
+             "natively when called with concrete arguments. The basic "
+             "blocks that run natively are marked covered, but their "
+             "instructions are not counted in the statistics and "
+             "run.istats. A native call cannot be stopped by -max-time or a "
+             "halt, see -jit-concrete-budget (default=false)"),
+    cl::cat(ExtCallsCat));
+
+cl::opt<unsigned long long> JITConcreteBudget(
+    "jit-concrete-budget",
+    cl::init(10000000),
+    cl::desc("Number of basic blocks a native call of a function may enter. "
+             "A function that does not finish within it is interpreted from "
+             "then on (default=10000000)"),
+    cl::cat(ExtCallsCat));
+
 
 /*** Seeding options ***/
 
@@ -363,6 +416,14 @@ cl::opt<unsigned> MaxMemory("max-memory",
                             cl::init(2000),
                             cl::cat(TerminationCat));
 
+cl::opt<bool> SuspendStatesOnMaxMemory(
+    "suspend-states-on-max-memory",
+    cl::desc("Write states to disk instead of terminating them when above "
+             "the memory cap (see -max-memory). Suspended states are loaded "
+             "back when they are selected again (default=false)"),
+    cl::init(false),
+    cl::cat(TerminationCat));
+
 cl::opt<bool> MaxMemoryInhibit(
     "max-memory-inhibit",
     cl::desc(
@@ -499,17 +560,42 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
     klee_error("Failed to create core solver\n");
   }
 
+  if (AsyncSolverQueries) {
+    asyncSolver = std::make_unique<AsyncSolver>(AsyncSolverQueries);
+    coreSolver = asyncSolver->wrapCoreSolver(coreSolver);
+  }
+
+  if (ProfileQueries)
+    queryProfiler = std::make_unique<QueryProfiler>(
+        interpreterHandler->openOutputFile("query-profile.bin"),
+        interpreterHandler->getOutputFilename("query-profile.stats"));
+
   Solver *solver = constructSolverChain(
       coreSolver,
       interpreterHandler->getOutputFilename(ALL_QUERIES_SMT2_FILE_NAME),
       interpreterHandler->getOutputFilename(SOLVER_QUERIES_SMT2_FILE_NAME),
       interpreterHandler->getOutputFilename(ALL_QUERIES_KQUERY_FILE_NAME),
-      interpreterHandler->getOutputFilename(SOLVER_QUERIES_KQUERY_FILE_NAME));
+      interpreterHandler->getOutputFilename(SOLVER_QUERIES_KQUERY_FILE_NAME),
+      queryProfiler ? &queryProfiler->layerTimes : nullptr);
 
-  this->solver = new TimingSolver(solver, EqualitySubstitution);
+  this->solver =
+      new TimingSolver(solver, EqualitySubstitution, UseStateModel);
+  this->solver->profiler = queryProfiler.get();
 
   memory = new MemoryManager(&arrayCache);
 
+  if (JITConcreteFunctions)
+    concreteJIT = std::make_unique<ConcreteJIT>(
+        [](const Function &f) {
+          return f.getName().equals(ErrorFun) ||
+                 f.getName().startswith("__INSTR_");
+        },
+        JITConcreteBudget);
+
+  if (SuspendStatesOnMaxMemory)
+    stateSpiller = std::make_unique<StateSpiller>(
+        interpreterHandler->getOutputFilename("suspended-states"));
+
   initializeSearchOptions();
 
   if (OnlyOutputStatesCoveringNew && !StatsTracker::useIStats())
@@ -604,6 +690,10 @@ Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
 }
 
 Executor::~Executor() {
+  asyncSolver.reset();
+  queryProfiler.reset();
+  // the spiller keeps memory objects of suspended states alive
+  stateSpiller.reset();
   delete memory;
   delete externalDispatcher;
   delete specialFunctionHandler;
@@ -663,8 +753,8 @@ MemoryObject *Executor::addExternalObject(ExecutionState &state, void *addr,
                                           unsigned size, bool isReadOnly,
                                           uint64_t specialSegment) {
   auto mo = memory->allocateFixed(size, nullptr, specialSegment);
-  state.addressSpace.concreteAddressMap.emplace(
-      reinterpret_cast<uint64_t>(addr), mo->segment);
+  state.addressSpace.bindConcreteAddress(reinterpret_cast<uint64_t>(addr),
+                                         mo->segment);
   ObjectState *os = bindObjectInState(state, mo, false);
   for(unsigned i = 0; i < size; i++)
     os->write8(i, (uint8_t)mo->segment, ((uint8_t*)addr)[i]);
@@ -898,9 +988,8 @@ void Executor::initializeGlobalObjects(ExecutionState &state, bool isEntryFuncti
         klee_error("Couldn't allocate memory for external function");
 
       initializedMOs.emplace(mo->segment, reinterpret_cast<uint64_t>(address));
-      state.addressSpace.concreteAddressMap.emplace(
+      state.addressSpace.bindConcreteAddress(
           reinterpret_cast<uint64_t>(address), mo->getSegment());
-      state.addressSpace.segmentMap.replace({mo->getSegment(), mo});
 
       initializeGlobalObject(state, os, v.getInitializer(), 0);
       if (v.isConstant())
@@ -951,8 +1040,13 @@ void Executor::branch(ExecutionState &state,
   unsigned N = conditions.size();
   assert(N);
 
-  if (!branchingPermitted(state)) {
-    unsigned next = theRNG.getInt32() % N;
+  unsigned next = N;
+  if (followsPathPrefix() && !readPathChoice(N, next))
+    next = N;
+  if (next == N && !branchingPermitted(state))
+    next = theRNG.getInt32() % N;
+
+  if (next != N) {
     for (unsigned i=0; i<N; ++i) {
       if (i == next) {
         result.push_back(&state);
@@ -971,9 +1065,19 @@ void Executor::branch(ExecutionState &state,
       addedStates.push_back(ns);
       result.push_back(ns);
       processTree->attach(es->ptreeNode, ns, es, reason);
+      if (pathWriter)
+        ns->pathOS = pathWriter->open(es->pathOS);
+      if (symPathWriter)
+        ns->symPathOS = symPathWriter->open(es->symPathOS);
     }
   }
 
+  if (pathWriter && interpreterOpts.ExactPaths) {
+    for (unsigned i=0; i<N; ++i)
+      if (result[i])
+        writePathChoice(*result[i], i, N);
+  }
+
   // If necessary redistribute seeds to match conditions, killing
   // states if necessary due to OnlyReplaySeeds (inefficient but
   // simple).
@@ -1026,6 +1130,45 @@ void Executor::branch(ExecutionState &state,
       addConstraint(*result[i], conditions[i]);
 }
 
+/// Number of path bits that encode a choice between n alternatives.
+static unsigned getPathChoiceWidth(unsigned n) {
+  unsigned width = 0;
+  while ((1ull << width) < n)
+    ++width;
+  return width;
+}
+
+bool Executor::readPathChoice(unsigned n, unsigned &choice) {
+  unsigned width = getPathChoiceWidth(n);
+  if (pathPrefixPosition + width <= pathPrefix->size()) {
+    choice = 0;
+    for (unsigned i = 0; i < width; ++i)
+      choice = (choice << 1) | (*pathPrefix)[pathPrefixPosition++];
+    if (choice < n)
+      return true;
+  }
+
+  abandonPathPrefix();
+  return false;
+}
+
+void Executor::abandonPathPrefix() {
+  // execution before the branch was not deterministic, the subtree
+  // below the current state is explored instead
+  klee_warning_once(pathPrefix, "path prefix does not match the program, "
+                                "exploring from the diverging branch");
+  pathPrefixPosition = pathPrefix->size();
+}
+
+void Executor::writePathChoice(ExecutionState &state, unsigned choice,
+                               unsigned n) {
+  std::string bits;
+  for (unsigned i = getPathChoiceWidth(n); i > 0; --i)
+    bits += (choice >> (i - 1)) & 1 ? '1' : '0';
+  if (!bits.empty())
+    state.pathOS << bits;
+}
+
 ref<Expr> Executor::maxStaticPctChecks(ExecutionState &current,
                                        ref<Expr> condition) {
   if (isa<klee::ConstantExpr>(condition))
@@ -1084,6 +1227,9 @@ ref<Expr> Executor::maxStaticPctChecks(ExecutionState &current,
 
 Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
                                    bool isInternal, BranchType reason) {
+  // internal forks are part of the check that caused them
+  QueryProfiler::OriginScope origin(isInternal ? nullptr : queryProfiler.get(),
+                                    QueryProfiler::Branch);
   Solver::Validity res;
   std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it =
     seedMap.find(&current);
@@ -1095,16 +1241,42 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
   time::Span timeout = coreSolverTimeout;
   if (isSeeding)
     timeout *= static_cast<unsigned>(it->second.size());
-  solver->setTimeout(timeout);
-  bool success = solver->evaluate(current.constraints, condition, res,
-                                  current.queryMetaData);
-  solver->setTimeout(time::Span());
+  bool success = true;
+  if (!current.parkedResult.condition.isNull() &&
+      current.parkedResult.condition == condition) {
+    // computed before the state was parked or while it was
+    res = current.parkedResult.validity;
+    success = current.parkedResult.success;
+  } else {
+    solver->setTimeout(timeout);
+    success = solver->evaluate(current.constraints, condition, res,
+                               current.queryMetaData);
+    solver->setTimeout(time::Span());
+  }
+  current.parkedResult.condition = nullptr;
   if (!success) {
     current.pc = current.prevPC;
     terminateStateOnSolverError(current, "Query timed out (fork).");
     return StatePair(nullptr, nullptr);
   }
 
+  if (!isSeeding && followsPathPrefix()) {
+    unsigned branch;
+    if (readPathChoice(2, branch)) {
+      if (res == Solver::Unknown) {
+        if (branch) {
+          res = Solver::True;
+          addConstraint(current, condition);
+        } else {
+          res = Solver::False;
+          addConstraint(current, Expr::createIsZero(condition));
+        }
+      } else if ((res == Solver::True) != (branch == 1)) {
+        abandonPathPrefix();
+      }
+    }
+  }
+
   if (!isSeeding) {
     if (replayPath && !isInternal) {
       assert(replayPosition<replayPath->size() &&
@@ -1181,7 +1353,7 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
   // hint to just use the single constraint instead of all the binary
   // search ones. If that makes sense.
   if (res==Solver::True) {
-    if (!isInternal) {
+    if (!isInternal || interpreterOpts.ExactPaths) {
       if (pathWriter) {
         current.pathOS << "1";
       }
@@ -1189,7 +1361,7 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
 
     return StatePair(&current, nullptr);
   } else if (res==Solver::False) {
-    if (!isInternal) {
+    if (!isInternal || interpreterOpts.ExactPaths) {
       if (pathWriter) {
         current.pathOS << "0";
       }
@@ -1246,7 +1418,7 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
       // Need to update the pathOS.id field of falseState, otherwise the same id
       // is used for both falseState and trueState.
       falseState->pathOS = pathWriter->open(current.pathOS);
-      if (!isInternal) {
+      if (!isInternal || interpreterOpts.ExactPaths) {
         trueState->pathOS << "1";
         falseState->pathOS << "0";
       }
@@ -1342,6 +1514,8 @@ ref<Expr> Executor::toUnique(const ExecutionState &state,
   ref<Expr> result = e;
 
   if (!isa<ConstantExpr>(e)) {
+    QueryProfiler::OriginScope origin(queryProfiler.get(),
+                                      QueryProfiler::Concretize);
     ref<ConstantExpr> value;
     bool isTrue = false;
     auto expr = optimizer.optimizeExpr(e, true);
@@ -1371,6 +1545,8 @@ Executor::toConstant(ExecutionState &state,
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e))
     return CE;
 
+  QueryProfiler::OriginScope origin(queryProfiler.get(),
+                                    QueryProfiler::Concretize);
   ref<ConstantExpr> value;
   bool success =
       solver->getValue(state.constraints, e, value, state.queryMetaData);
@@ -1396,6 +1572,8 @@ Executor::toConstant(ExecutionState &state,
 void Executor::executeGetValue(ExecutionState &state,
                                const KValue& kval,
                                KInstruction *target) {
+  QueryProfiler::OriginScope origin(queryProfiler.get(),
+                                    QueryProfiler::Concretize);
   ref<Expr> expr = ConstraintManager::simplifyExpr(state.constraints, kval.getValue());
   ref<Expr> segment = ConstraintManager::simplifyExpr(state.constraints, kval.getSegment());
 
@@ -1848,7 +2026,7 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
       break;
     case Intrinsic::fabs: {
       ref<ConstantExpr> arg =
-          toConstant(state, arguments[0].value, "floating point");
+          toConstant(state, arguments[0].getValue(), "floating point");
       if (!fpWidthToSemantics(arg->getWidth()))
         return terminateStateOnExecError(
             state, "Unsupported intrinsic llvm.fabs call");
@@ -1873,11 +2051,11 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
             state, f->getName() + " with vectors is not supported");
 
       ref<ConstantExpr> op1 =
-          toConstant(state, eval(ki, 1, state).value, "floating point");
+          toConstant(state, eval(ki, 1, state).getValue(), "floating point");
       ref<ConstantExpr> op2 =
-          toConstant(state, eval(ki, 2, state).value, "floating point");
+          toConstant(state, eval(ki, 2, state).getValue(), "floating point");
       ref<ConstantExpr> op3 =
-          toConstant(state, eval(ki, 3, state).value, "floating point");
+          toConstant(state, eval(ki, 3, state).getValue(), "floating point");
 
       if (!fpWidthToSemantics(op1->getWidth()) ||
           !fpWidthToSemantics(op2->getWidth()) ||
@@ -1902,8 +2080,8 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
         return terminateStateOnExecError(
             state, "llvm.abs with vectors is not supported");
 
-      ref<Expr> op = eval(ki, 1, state).value;
-      ref<Expr> poison = eval(ki, 2, state).value;
+      ref<Expr> op = eval(ki, 1, state).getValue();
+      ref<Expr> poison = eval(ki, 2, state).getValue();
 
       assert(poison->getWidth() == 1 && "Second argument is not an i1");
       unsigned bw = op->getWidth();
@@ -1944,8 +2122,8 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
         return terminateStateOnExecError(
             state, "llvm.{s,u}{max,min} with vectors is not supported");
 
-      ref<Expr> op1 = eval(ki, 1, state).value;
-      ref<Expr> op2 = eval(ki, 2, state).value;
+      ref<Expr> op1 = eval(ki, 1, state).getValue();
+      ref<Expr> op2 = eval(ki, 2, state).getValue();
 
       ref<Expr> cond = nullptr;
       if (f->getIntrinsicID() == Intrinsic::smax)
@@ -1966,9 +2144,9 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
 #if LLVM_VERSION_CODE >= LLVM_VERSION(7, 0)
     case Intrinsic::fshr:
     case Intrinsic::fshl: {
-      ref<Expr> op1 = eval(ki, 1, state).value;
-      ref<Expr> op2 = eval(ki, 2, state).value;
-      ref<Expr> op3 = eval(ki, 3, state).value;
+      ref<Expr> op1 = eval(ki, 1, state).getValue();
+      ref<Expr> op2 = eval(ki, 2, state).getValue();
+      ref<Expr> op3 = eval(ki, 3, state).getValue();
       unsigned w = op1->getWidth();
       assert(w == op2->getWidth() && "type mismatch");
       assert(w == op3->getWidth() && "type mismatch");
@@ -2063,6 +2241,9 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
       transferToBasicBlock(ii->getNormalDest(), i->getParent(), state);
     }
   } else {
+    if (concreteJIT && callNatively(state, ki, f, arguments))
+      return;
+
     // Check if maximum stack size was reached.
     // We currently only count the number of stack frames
     if (RuntimeMaxStackFrames && state.stack.size() > RuntimeMaxStackFrames) {
@@ -2186,7 +2367,7 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
           if (!cs.isByValArgument(k)) {
             os->write(offsets[k], arguments[k]);
           } else {
-            ConstantExpr *address = dyn_cast<ConstantExpr>(arguments[k].value);
+            ConstantExpr *address = dyn_cast<ConstantExpr>(arguments[k].getValue());
             assert(address); // byval argument needs to be a concrete pointer
 
             ObjectPair op;
@@ -2206,6 +2387,41 @@ void Executor::executeCall(ExecutionState &state, KInstruction *ki, Function *f,
   }
 }
 
+bool Executor::callNatively(ExecutionState &state, KInstruction *ki,
+                            Function *f, const std::vector<Cell> &arguments) {
+  if (!concreteJIT->isEligible(*f) || arguments.size() < f->arg_size())
+    return false;
+
+  std::vector<std::uint64_t> values;
+  for (unsigned i = 0, e = f->arg_size(); i != e; ++i) {
+    // integers made from pointers keep their segment, natively they would
+    // lose it
+    auto segment = dyn_cast<ConstantExpr>(arguments[i].getSegment());
+    auto value = dyn_cast<ConstantExpr>(arguments[i].getValue());
+    if (!segment || !segment->isZero() || !value)
+      return false;
+    values.push_back(value->getZExtValue());
+  }
+
+  std::uint64_t result;
+  std::vector<const BasicBlock *> ran;
+  if (!concreteJIT->call(*f, values, result, ran))
+    return false;
+  ++stats::nativeCalls;
+
+  // the native run steps no instruction
+  if (statsTracker && !ran.empty())
+    statsTracker->coverBlocks(state, ran);
+
+  Type *resultType = f->getReturnType();
+  if (!resultType->isVoidTy())
+    bindLocal(ki, state,
+              KValue::createConstant(result, getWidthForLLVMType(resultType)));
+  if (InvokeInst *ii = dyn_cast<InvokeInst>(ki->inst))
+    transferToBasicBlock(ii->getNormalDest(), ki->inst->getParent(), state);
+  return true;
+}
+
 void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src,
                                     ExecutionState &state) {
   // Note that in general phi nodes can reuse phi values from the same
@@ -2220,16 +2436,23 @@ void Executor::transferToBasicBlock(BasicBlock *dst, BasicBlock *src,
   // With that done we simply set an index in the state so that PHI
   // instructions know which argument to eval, set the pc, and continue.
 
-  // XXX this lookup has to go ?
+  // Branches and switches use the successors decoded by KModule instead.
   KFunction *kf = state.stack.back().kf;
   unsigned entry = kf->basicBlockEntry[dst];
   state.pc = &kf->instructions[entry];
-  if (state.pc->inst->getOpcode() == Instruction::PHI) {
+  if (state.pc->opcode == Instruction::PHI) {
     PHINode *first = static_cast<PHINode*>(state.pc->inst);
     state.incomingBBIndex = first->getBasicBlockIndex(src);
   }
 }
 
+void Executor::transferToBasicBlock(const KSuccessor &dst,
+                                    ExecutionState &state) {
+  state.pc = &state.stack.back().kf->instructions[dst.entry];
+  if (dst.incomingBBIndex != -1)
+    state.incomingBBIndex = dst.incomingBBIndex;
+}
+
 /// Compute the true target of a function call, resolving LLVM aliases
 /// and bitcasts.
 Function* Executor::getTargetFunction(Value *calledVal, ExecutionState &state) {
@@ -2266,7 +2489,7 @@ ref<Expr> Executor::getSizeForAlloca(ExecutionState& state, KInstruction *ki) co
     kmodule->targetData->getTypeStoreSize(ai->getAllocatedType());
   ref<Expr> size = Expr::createPointer(elementSize);
   if (ai->isArrayAllocation()) {
-    ref<Expr> count = eval(ki, 0, state).value;
+    ref<Expr> count = eval(ki, 0, state).getValue();
     count = Expr::createZExtToPointerWidth(count);
     size = MulExpr::create(size, count);
   }
@@ -2281,8 +2504,10 @@ static inline bool segmentIsDeleted(ExecutionState& state,
 
 
 void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
+  if (queryProfiler)
+    queryProfiler->setInstruction(ki);
   Instruction *i = ki->inst;
-  switch (i->getOpcode()) {
+  switch (ki->opcode) {
     // Control flow
   case Instruction::Ret: {
     ReturnInst *ri = cast<ReturnInst>(i);
@@ -2390,12 +2615,12 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::Br: {
     BranchInst *bi = cast<BranchInst>(i);
     if (bi->isUnconditional()) {
-      transferToBasicBlock(bi->getSuccessor(0), bi->getParent(), state);
+      transferToBasicBlock(ki->successors[0], state);
     } else {
       // FIXME: Find a way that we don't have this hidden dependency.
       assert(bi->getCondition() == bi->getOperand(0) &&
              "Wrong operand index!");
-      ref<Expr> cond = eval(ki, 0, state).value;
+      ref<Expr> cond = eval(ki, 0, state).getValue();
 
       cond = optimizer.optimizeExpr(cond, false);
       Executor::StatePair branches = fork(state, cond, false, BranchType::ConditionalBranch);
@@ -2408,16 +2633,16 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
         statsTracker->markBranchVisited(branches.first, branches.second);
 
       if (branches.first)
-        transferToBasicBlock(bi->getSuccessor(0), bi->getParent(), *branches.first);
+        transferToBasicBlock(ki->successors[0], *branches.first);
       if (branches.second)
-        transferToBasicBlock(bi->getSuccessor(1), bi->getParent(), *branches.second);
+        transferToBasicBlock(ki->successors[1], *branches.second);
     }
     break;
   }
   case Instruction::IndirectBr: {
     // implements indirect branch to a label within the current function
     const auto bi = cast<IndirectBrInst>(i);
-    auto address = eval(ki, 0, state).value;
+    auto address = eval(ki, 0, state).getValue();
     address = toUnique(state, address);
 
     // concrete address
@@ -2436,7 +2661,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     ref<Expr> errorCase = ConstantExpr::alloc(1, Expr::Bool);
     SmallPtrSet<BasicBlock *, 5> destinations;
-    // collect and check destinations from label list
+    std::vector<BasicBlock *> candidates;
+    std::vector<ref<Expr>> candidateExpressions;
+    // collect destinations from label list
     for (unsigned k = 0; k < numDestinations; ++k) {
       // filter duplicates
       const auto d = bi->getDestination(k);
@@ -2450,21 +2677,25 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       // exclude address from errorCase
       errorCase = AndExpr::create(errorCase, Expr::createIsZero(e));
 
-      // check feasibility
-      bool result;
-      bool success __attribute__((unused)) =
-          solver->mayBeTrue(state.constraints, e, result, state.queryMetaData);
-      assert(success && "FIXME: Unhandled solver failure");
-      if (result) {
-        targets.push_back(d);
-        expressions.push_back(e);
-      }
+      candidates.push_back(d);
+      candidateExpressions.push_back(e);
     }
-    // check errorCase feasibility
-    bool result;
+
+    // check feasibility of the destinations and of errorCase
+    candidateExpressions.push_back(errorCase);
+    std::vector<bool> feasible;
+    QueryProfiler::OriginScope origin(queryProfiler.get(),
+                                      QueryProfiler::Branch);
     bool success __attribute__((unused)) = solver->mayBeTrue(
-        state.constraints, errorCase, result, state.queryMetaData);
+        state.constraints, candidateExpressions, feasible, state.queryMetaData);
     assert(success && "FIXME: Unhandled solver failure");
+    for (unsigned k = 0; k != candidates.size(); ++k) {
+      if (feasible[k]) {
+        targets.push_back(candidates[k]);
+        expressions.push_back(candidateExpressions[k]);
+      }
+    }
+    bool result = feasible.back();
     if (result) {
       expressions.push_back(errorCase);
     }
@@ -2491,7 +2722,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
   case Instruction::Switch: {
     SwitchInst *si = cast<SwitchInst>(i);
-    ref<Expr> cond = eval(ki, 0, state).value;
+    ref<Expr> cond = eval(ki, 0, state).getValue();
     BasicBlock *bb = si->getParent();
 
     cond = toUnique(state, cond);
@@ -2501,7 +2732,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       llvm::IntegerType *Ty = cast<IntegerType>(si->getCondition()->getType());
       ConstantInt *ci = ConstantInt::get(Ty, CE->getZExtValue());
       unsigned index = si->findCaseValue(ci)->getSuccessorIndex();
-      transferToBasicBlock(si->getSuccessor(index), si->getParent(), state);
+      transferToBasicBlock(ki->successors[index], state);
     } else {
       // Handle possible different branch targets
 
@@ -2525,6 +2756,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       ref<Expr> defaultValue = ConstantExpr::alloc(1, Expr::Bool);
 
       // iterate through all non-default cases but in order of the expressions
+      std::vector<ref<Expr>> matches;
+      std::vector<BasicBlock *> matchSuccessors;
       for (std::map<ref<Expr>, BasicBlock *>::iterator
                it = expressionOrder.begin(),
                itE = expressionOrder.end();
@@ -2538,15 +2771,25 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
         // Make sure that the default value does not contain this target's value
         defaultValue = AndExpr::create(defaultValue, Expr::createIsZero(match));
 
-        // Check if control flow could take this case
-        bool result;
-        match = optimizer.optimizeExpr(match, false);
-        bool success = solver->mayBeTrue(state.constraints, match, result,
-                                         state.queryMetaData);
-        assert(success && "FIXME: Unhandled solver failure");
-        (void) success;
-        if (result) {
-          BasicBlock *caseSuccessor = it->second;
+        matches.push_back(optimizer.optimizeExpr(match, false));
+        matchSuccessors.push_back(it->second);
+      }
+
+      // Check which cases control flow could take, the default case last
+      defaultValue = optimizer.optimizeExpr(defaultValue, false);
+      matches.push_back(defaultValue);
+      std::vector<bool> feasible;
+      QueryProfiler::OriginScope origin(queryProfiler.get(),
+                                        QueryProfiler::Branch);
+      bool success = solver->mayBeTrue(state.constraints, matches, feasible,
+                                       state.queryMetaData);
+      assert(success && "FIXME: Unhandled solver failure");
+      (void) success;
+
+      for (unsigned i = 0; i != matchSuccessors.size(); ++i) {
+        ref<Expr> match = matches[i];
+        if (feasible[i]) {
+          BasicBlock *caseSuccessor = matchSuccessors[i];
 
           // Handle the case that a basic block might be the target of multiple
           // switch cases.
@@ -2568,13 +2811,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       }
 
       // Check if control could take the default case
-      defaultValue = optimizer.optimizeExpr(defaultValue, false);
-      bool res;
-      bool success = solver->mayBeTrue(state.constraints, defaultValue, res,
-                                       state.queryMetaData);
-      assert(success && "FIXME: Unhandled solver failure");
-      (void) success;
-      if (res) {
+      if (feasible.back()) {
         std::pair<std::map<BasicBlock *, ref<Expr> >::iterator, bool> ret =
             branchTargets.insert(
                 std::make_pair(si->getDefaultDest(), defaultValue));
@@ -2658,7 +2895,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
         for (std::vector<Cell>::iterator
                ai = arguments.begin(), ie = arguments.end();
              ai != ie; ++ai) {
-          Expr::Width to, from = ai->value->getWidth();
+          Expr::Width to, from = ai->getWidth();
 
           if (i<fType->getNumParams()) {
             to = getWidthForLLVMType(fType->getParamType(i));
@@ -2854,6 +3091,8 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     KValue right = eval(ki, 1, state);
 
     if (LazyInitialization) {
+      QueryProfiler::OriginScope origin(queryProfiler.get(),
+                                        QueryProfiler::LazyInit);
       handleICMPForLazyInit(predicate, state, left, right);
       //attempt to match the width of the expressions if they differ
       checkWidthMatch(left, right);
@@ -2959,36 +3198,33 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       KValue index = eval(ki, it->first, state);
       base = base.Add(
           index.SExt(pointerWidth)
-          .Mul(ConstantExpr::create(elementSize, pointerWidth)));
+          .Mul(KValue::createConstant(elementSize, pointerWidth)));
     }
     if (kgepi->offset)
-      base = base.Add(ConstantExpr::create(kgepi->offset, pointerWidth));
+      base = base.Add(KValue::createConstant(kgepi->offset, pointerWidth));
     bindLocal(ki, state, base);
     break;
   }
 
     // Conversion
   case Instruction::Trunc: {
-    CastInst *ci = cast<CastInst>(i);
     const Cell &cell = eval(ki, 0, state);
-    KValue result = cell.Extract(0, getWidthForLLVMType(ci->getType()));
+    KValue result = cell.Extract(0, ki->width);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::SExt: {
-    CastInst *ci = cast<CastInst>(i);
     const Cell &cell = eval(ki, 0, state);
-    bindLocal(ki, state, cell.SExt(getWidthForLLVMType(ci->getType())));
+    bindLocal(ki, state, cell.SExt(ki->width));
     break;
   }
 
   case Instruction::ZExt:
   case Instruction::IntToPtr:
   case Instruction::PtrToInt: {
-    CastInst *ci = cast<CastInst>(i);
     const Cell &cell = eval(ki, 0, state);
-    bindLocal(ki, state, cell.ZExt(getWidthForLLVMType(ci->getType())));
+    bindLocal(ki, state, cell.ZExt(ki->width));
     break;
   }
 
@@ -3003,7 +3239,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(8, 0)
   case Instruction::FNeg: {
     ref<ConstantExpr> arg =
-        toConstant(state, eval(ki, 0, state).value, "floating point");
+        toConstant(state, eval(ki, 0, state).getValue(), "floating point");
     if (!fpWidthToSemantics(arg->getWidth()))
       return terminateStateOnExecError(state, "Unsupported FNeg operation");
 
@@ -3015,9 +3251,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 #endif
 
   case Instruction::FAdd: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -3030,9 +3266,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FSub: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -3044,9 +3280,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FMul: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -3059,9 +3295,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FDiv: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -3074,9 +3310,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FRem: {
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -3091,7 +3327,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::FPTrunc: {
     FPTruncInst *fi = cast<FPTruncInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > arg->getWidth())
       return terminateStateOnExecError(state, "Unsupported FPTrunc operation");
@@ -3108,7 +3344,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::FPExt: {
     FPExtInst *fi = cast<FPExtInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || arg->getWidth() > resultType)
       return terminateStateOnExecError(state, "Unsupported FPExt operation");
@@ -3124,7 +3360,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::FPToUI: {
     FPToUIInst *fi = cast<FPToUIInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
       return terminateStateOnExecError(state, "Unsupported FPToUI operation");
@@ -3142,7 +3378,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::FPToSI: {
     FPToSIInst *fi = cast<FPToSIInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
       return terminateStateOnExecError(state, "Unsupported FPToSI operation");
@@ -3160,7 +3396,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::UIToFP: {
     UIToFPInst *fi = cast<UIToFPInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
     if (!semantics)
@@ -3176,7 +3412,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::SIToFP: {
     SIToFPInst *fi = cast<SIToFPInst>(i);
     Expr::Width resultType = getWidthForLLVMType(fi->getType());
-    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).getValue(),
                                        "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
     if (!semantics)
@@ -3191,9 +3427,9 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
   case Instruction::FCmp: {
     FCmpInst *fi = cast<FCmpInst>(i);
-    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).value,
+    ref<ConstantExpr> left = toConstant(state, eval(ki, 0, state).getValue(),
                                         "floating point");
-    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).value,
+    ref<ConstantExpr> right = toConstant(state, eval(ki, 1, state).getValue(),
                                          "floating point");
     if (!fpWidthToSemantics(left->getWidth()) ||
         !fpWidthToSemantics(right->getWidth()))
@@ -3319,7 +3555,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
     InsertElementInst *iei = cast<InsertElementInst>(i);
     KValue vec = eval(ki, 0, state);
     KValue newElt = eval(ki, 1, state);
-    ref<Expr> idx = eval(ki, 2, state).value;
+    ref<Expr> idx = eval(ki, 2, state).getValue();
 
     ConstantExpr *cIdx = dyn_cast<ConstantExpr>(idx);
     if (cIdx == NULL) {
@@ -3360,7 +3596,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   case Instruction::ExtractElement: {
     ExtractElementInst *eei = cast<ExtractElementInst>(i);
     KValue vec = eval(ki, 0, state);
-    ref<Expr> idx = eval(ki, 1, state).value;
+    ref<Expr> idx = eval(ki, 1, state).getValue();
 
     ConstantExpr *cIdx = dyn_cast<ConstantExpr>(idx);
     if (cIdx == NULL) {
@@ -3406,7 +3642,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
       break;
     }
 
-    ref<Expr> arg = eval(ki, 0, state).value;
+    ref<Expr> arg = eval(ki, 0, state).getValue();
     ref<Expr> exceptionPointer = ExtractExpr::create(arg, 0, Expr::Int64);
     ref<Expr> selectorValue =
         ExtractExpr::create(arg, Expr::Int64, Expr::Int32);
@@ -3497,10 +3733,11 @@ void Executor::checkWidthMatch(KValue &left, KValue &right) const {
   const auto& rightWidth = right.getWidth();
   if (leftWidth != rightWidth) {
     const auto width = rightWidth > leftWidth ? rightWidth : leftWidth;
-    auto& lowerValue = rightWidth > leftWidth ? left.value : right.value;
-    auto* valueCE = dyn_cast<ConstantExpr>(lowerValue);
+    auto& lower = rightWidth > leftWidth ? left : right;
+    auto* valueCE = dyn_cast<ConstantExpr>(lower.getValue());
     if (valueCE) {
-      lowerValue = ConstantExpr::create(valueCE->getZExtValue(width), width);
+      lower = KValue(lower.getSegment(),
+                     ConstantExpr::create(valueCE->getZExtValue(width), width));
     }
   }
 }
@@ -3636,6 +3873,8 @@ void Executor::computeOffsets(KGEPInstruction *kgepi, TypeIt ib, TypeIt ie) {
   ref<ConstantExpr> constantOffset =
     ConstantExpr::alloc(0, Context::get().getPointerWidth());
   uint64_t index = 1;
+  // the constants are bound again on every run
+  kgepi->indices.clear();
   for (TypeIt ii = ib; ii != ie; ++ii) {
     if (StructType *st = dyn_cast<StructType>(*ii)) {
       const StructLayout *sl = kmodule->targetData->getStructLayout(st);
@@ -3706,22 +3945,127 @@ bool Executor::checkMemoryUsage() {
   // just guess at how many to kill
   const auto numStates = states.size();
   auto toKill = std::max(1UL, numStates - numStates * MaxMemory / totalUsage);
-  klee_warning("killing %lu states (over memory cap: %luMB)", toKill, totalUsage);
 
-  // randomly select states for early termination
-  std::vector<ExecutionState *> arr(states.begin(), states.end()); // FIXME: expensive
-  for (unsigned i = 0, N = arr.size(); N && i < toKill; ++i, --N) {
-    unsigned idx = theRNG.getInt32() % N;
-    // Make two pulls to try and not hit a state that
-    // covered new code.
-    if (arr[idx]->coveredNew)
-      idx = theRNG.getInt32() % N;
+  // Terminate the states that hold the most memory of their own, states
+  // that covered new code are only picked once no other states are left.
+  // Stop early once the victims are estimated to release the excess. With
+  // -suspend-states-on-max-memory, victims are written to disk instead.
+  std::vector<ExecutionState *> arr; // FIXME: expensive
+  arr.reserve(states.size());
+  for (auto *es : states)
+    if ((!stateSpiller || !stateSpiller->isSuspended(*es)) &&
+        (!asyncSolver || !asyncSolver->isParked(*es)))
+      arr.push_back(es);
+  std::vector<std::uint64_t> ownedBytes;
+  ownedBytes.reserve(arr.size());
+  for (const auto *es : arr)
+    ownedBytes.push_back(es->getOwnedBytes());
+  std::vector<std::size_t> order(arr.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+    if (arr[a]->coveredNew != arr[b]->coveredNew)
+      return !arr[a]->coveredNew;
+    return ownedBytes[a] > ownedBytes[b];
+  });
+
+  const std::uint64_t excess = (totalUsage - MaxMemory) << 20U;
+  std::uint64_t released = 0;
+  unsigned killed = 0, suspended = 0;
+  for (std::size_t i = 0;
+       i < toKill && i < order.size() && released < excess; ++i) {
+    ExecutionState &victim = *arr[order[i]];
+    released += ownedBytes[order[i]];
+    // states waiting in a merge are accessed by other states
+    if (stateSpiller && victim.openMergeStack.empty() &&
+        stateSpiller->suspend(victim)) {
+      ++suspended;
+      continue;
+    }
+    terminateStateEarly(victim, "Memory limit exceeded.",
+                        StateTerminationType::OutOfMemory);
+    ++killed;
+  }
+  klee_warning("killed %u and suspended %u states holding ~%" PRIu64
+               "MB (over memory cap: %luMB)",
+               killed, suspended, released >> 20U, totalUsage);
+
+  // suspended states are gone right away, but their memory may still be
+  // shared with other states, so measure again instead of trusting the guess
+  const auto usageAfter = (util::GetTotalMallocUsage() >> 20U) +
+                          (memory->getUsedDeterministicSize() >> 20U);
+  atMemoryLimit = usageAfter > MaxMemory;
+  return killed == 0 && !atMemoryLimit;
+}
+
+void Executor::donatePath() {
+  pathDonationRequested = false;
 
-    std::swap(arr[idx], arr[N - 1]);
-    terminateStateEarly(*arr[N - 1], "Memory limit exceeded.", StateTerminationType::OutOfMemory);
+  // give away the shallowest state, it likely has the largest subtree
+  // left to explore; at least one state is kept
+  ExecutionState *donated = nullptr;
+  if (pathWriter && interpreterOpts.ExactPaths && !followsPathPrefix() &&
+      states.size() > 1) {
+    for (ExecutionState *es : states) {
+      if (!es->openMergeStack.empty() || seedMap.count(es) ||
+          (asyncSolver && asyncSolver->isParked(*es)))
+        continue;
+      if (!donated || es->depth < donated->depth)
+        donated = es;
+    }
   }
 
-  return false;
+  if (!donated) {
+    interpreterHandler->processDonatedPath(nullptr);
+    return;
+  }
+
+  std::vector<unsigned char> bits;
+  pathWriter->readStream(getPathStreamID(*donated), bits);
+  std::vector<bool> path;
+  path.reserve(bits.size());
+  for (unsigned char bit : bits)
+    path.push_back(bit == '1');
+  interpreterHandler->processDonatedPath(&path);
+
+  // the state is explored elsewhere, so it is dropped without counting
+  // it as an explored path
+  if (stateSpiller)
+    stateSpiller->resume(*donated);
+  donated->pc = donated->prevPC;
+  removedStates.push_back(donated);
+  updateStates(nullptr);
+}
+
+bool Executor::parkOnBranch(ExecutionState &state) {
+  auto *bi = dyn_cast<BranchInst>(state.pc->inst);
+  if (!bi || bi->isUnconditional() || !asyncSolver->canSubmit(state) ||
+      !state.openMergeStack.empty() || seedMap.count(&state))
+    return false;
+
+  ref<Expr> cond = eval(state.pc, 0, state).getValue();
+  cond = optimizer.optimizeExpr(cond, false);
+  if (isa<ConstantExpr>(cond) || (!state.parkedResult.condition.isNull() &&
+                                  state.parkedResult.condition == cond))
+    return false;
+
+  // conditions the caches can answer need not wait for a child process
+  Solver::Validity validity;
+  switch (asyncSolver->probe(*solver, state, cond, coreSolverTimeout,
+                             validity)) {
+  case AsyncSolver::Answered:
+    state.parkedResult = {cond, validity, true};
+    return false;
+  case AsyncSolver::Failed:
+    state.parkedResult = {cond, validity, false};
+    return false;
+  case AsyncSolver::Deferred:
+    break;
+  }
+
+  if (!asyncSolver->submit(state))
+    return false;
+  searcher->update(nullptr, std::vector<ExecutionState *>(), {&state});
+  return true;
 }
 
 void Executor::doDumpStates() {
@@ -3766,6 +4110,11 @@ void Executor::run(ExecutionState &initialState) {
         it = seedMap.begin();
       lastState = it->first;
       ExecutionState &state = *lastState;
+      if (stateSpiller && !stateSpiller->resume(state)) {
+        terminateState(state);
+        updateStates(nullptr);
+        continue;
+      }
       KInstruction *ki = state.pc;
       stepInstruction(state);
 
@@ -3814,7 +4163,29 @@ void Executor::run(ExecutionState &initialState) {
 
   // main interpreter loop
   while (!states.empty() && !haltExecution) {
+    if (asyncSolver && asyncSolver->hasInFlight()) {
+      // only wait for the solver when no other state can run
+      std::vector<ExecutionState *> resumed;
+      asyncSolver->collect(searcher->empty() ? time::milliseconds(100)
+                                             : time::Span(),
+                           resumed);
+      if (!resumed.empty())
+        searcher->update(nullptr, resumed, std::vector<ExecutionState *>());
+      if (searcher->empty()) {
+        timers.invoke();
+        continue;
+      }
+    }
+
     ExecutionState &state = searcher->selectState();
+    if (stateSpiller && !stateSpiller->resume(state)) {
+      // the contents of the state are lost
+      terminateState(state);
+      updateStates(nullptr);
+      continue;
+    }
+    if (asyncSolver && parkOnBranch(state))
+      continue;
     KInstruction *ki = state.pc;
     stepInstruction(state);
 
@@ -3829,6 +4200,16 @@ void Executor::run(ExecutionState &initialState) {
       // update searchers when states were terminated early due to memory pressure
       updateStates(nullptr);
     }
+
+    if (pathDonationRequested)
+      donatePath();
+  }
+
+  if (asyncSolver) {
+    // parked states are handled like any other remaining state
+    std::vector<ExecutionState *> cancelled;
+    asyncSolver->cancelAll(cancelled);
+    searcher->update(nullptr, cancelled, std::vector<ExecutionState *>());
   }
 
   delete searcher;
@@ -3882,6 +4263,11 @@ std::string Executor::getKValueInfo(ExecutionState &state,
 
 
 void Executor::terminateState(ExecutionState &state) {
+  if (stateSpiller)
+    stateSpiller->resume(state);
+  if (asyncSolver)
+    asyncSolver->forget(state);
+
   if (replayKTest && replayPosition!=replayKTest->numObjects) {
     klee_warning_once(replayKTest,
                       "replay did not consume all objects in test input.");
@@ -4147,7 +4533,10 @@ void Executor::terminateStateOnExit(ExecutionState &state) {
 
 void Executor::terminateStateEarly(ExecutionState &state, const Twine &message,
                                    StateTerminationType terminationType) {
-  if (ExitOnErrorType.empty() &&
+  // test cases are generated from the contents of the state
+  bool resumed = !stateSpiller || stateSpiller->resume(state);
+
+  if (resumed && ExitOnErrorType.empty() &&
       ((terminationType <= StateTerminationType::EXECERR &&
        shouldWriteTest(state)) ||
       (AlwaysOutputSeeds && seedMap.count(&state)))) {
@@ -4414,6 +4803,9 @@ void Executor::callExternalFunction(ExecutionState &state,
   if (specialFunctionHandler->handle(state, function, target, arguments))
     return;
 
+  QueryProfiler::OriginScope origin(queryProfiler.get(),
+                                    QueryProfiler::External);
+
   if (ExternalCalls == ExternalCallPolicy::Pure &&
       nokExternals.count(function->getName().str()) > 0) {
     terminateStateOnUserError(state, "failed external call");
@@ -4618,10 +5010,10 @@ void Executor::callExternalFunction(ExecutionState &state,
     llvm::raw_string_ostream os(TmpStr);
     os << "calling external: " << function->getName().str() << "(";
     for (unsigned i=0; i<arguments.size(); i++) {
-      if (arguments[i].value->isZero()) {
-        os << "segment: " << arguments[i].pointerSegment;
+      if (arguments[i].getValue()->isZero()) {
+        os << "segment: " << arguments[i].getSegment();
       } else {
-        os << "value/address: " << arguments[i].value;
+        os << "value/address: " << arguments[i].getValue();
       }
       if (i != arguments.size()-1)
         os << ", ";
@@ -4811,6 +5203,8 @@ void Executor::resolveExact(ExecutionState &state,
                             const KValue &address,
                             ExactResolutionList &results,
                             const std::string &name) {
+  QueryProfiler::OriginScope origin(queryProfiler.get(),
+                                    QueryProfiler::Resolve);
   auto addressOptim = KValue(address.getSegment(),
                              optimizer.optimizeExpr(address.getOffset(), true));
 
@@ -4850,13 +5244,29 @@ void Executor::executeMemoryWrite(ExecutionState &state,
                                   const KValue &value) {
   executeMemoryOperation(state, true, address, value, 0);
 }
+bool Executor::isConcreteAccessInBounds(const MemoryObject *mo,
+                                        const ref<Expr> &segment,
+                                        const ref<Expr> &offset,
+                                        unsigned bytes) const {
+  const ConstantExpr *segmentCE = dyn_cast<ConstantExpr>(segment);
+  const ConstantExpr *offsetCE = dyn_cast<ConstantExpr>(offset);
+  const ConstantExpr *sizeCE = dyn_cast<ConstantExpr>(mo->size);
+  if (!segmentCE || !offsetCE || !sizeCE)
+    return false;
+  if (segmentCE->getZExtValue() != mo->segment)
+    return false;
+  uint64_t size = sizeCE->getZExtValue();
+  return bytes <= size && offsetCE->getZExtValue() <= size - bytes;
+}
+
 void Executor::executeMemoryOperation(ExecutionState &state,
                                       bool isWrite,
                                       KValue address,
                                       KValue value, /* undef if read */
                                       KInstruction *target /* undef if write */) {
-  Expr::Width type = (isWrite ? value.getWidth() :
-                     getWidthForLLVMType(target->inst->getType()));
+  QueryProfiler::OriginScope origin(queryProfiler.get(),
+                                    QueryProfiler::BoundsCheck);
+  Expr::Width type = (isWrite ? value.getWidth() : target->width);
   unsigned bytes = Expr::getMinBytesForWidth(type);
 
   if (SimplifySymIndices) {
@@ -4871,19 +5281,28 @@ void Executor::executeMemoryOperation(ExecutionState &state,
   address = KValue(address.getSegment(),
                    optimizer.optimizeExpr(address.getOffset(), true));
 
+  ++stats::memoryOperations;
+
   // fast path: single in-bounds resolution
   ObjectPair op;
   bool success = false;
-  solver->setTimeout(coreSolverTimeout);
   llvm::Optional<uint64_t> offsetVal;
-  if (!state.addressSpace.resolveOne(state, solver, address, op, success,
-                                     offsetVal)) {
-    address =
-        KValue(toConstant(state, address.getSegment(), "resolveOne failure"),
-               toConstant(state, address.getOffset(), "resolveOne failure"));
-    success = state.addressSpace.resolveOneConstantSegment(address, op);
+  if (address.isConstant() &&
+      state.addressSpace.resolveOneConstantSegment(address, op)) {
+    success = true;
+  } else {
+    QueryProfiler::OriginScope origin(queryProfiler.get(),
+                                      QueryProfiler::Resolve);
+    solver->setTimeout(coreSolverTimeout);
+    if (!state.addressSpace.resolveOne(state, solver, address, op, success,
+                                       offsetVal)) {
+      address =
+          KValue(toConstant(state, address.getSegment(), "resolveOne failure"),
+                 toConstant(state, address.getOffset(), "resolveOne failure"));
+      success = state.addressSpace.resolveOneConstantSegment(address, op);
+    }
+    solver->setTimeout(time::Span());
   }
-  solver->setTimeout(time::Span());
 
   if (success) {
     const MemoryObject *mo = op.first;
@@ -4906,23 +5325,29 @@ void Executor::executeMemoryOperation(ExecutionState &state,
       offset = address.getOffset();
     }
 
-    ref<Expr> isEqualSegment = EqExpr::create(mo->getSegmentExpr(), segment);
-
-    ref<Expr> isOffsetInBounds = mo->getBoundsCheckOffset(offset, bytes);
-    isOffsetInBounds = optimizer.optimizeExpr(isOffsetInBounds, true);
-
     bool inBoundsOffset;
     bool inBoundsSegment;
-    solver->setTimeout(coreSolverTimeout);
-    bool successSegment = solver->mustBeTrue(
-        state.constraints, isEqualSegment, inBoundsSegment, state.queryMetaData);
-    bool success = solver->mustBeTrue(
-        state.constraints, isOffsetInBounds, inBoundsOffset, state.queryMetaData);
-    solver->setTimeout(time::Span());
-    if (!success || !successSegment) {
-      state.pc = state.prevPC;
-      terminateStateOnSolverError(state, "Query timed out (bounds check).");
-      return;
+    if (isConcreteAccessInBounds(mo, segment, offset, bytes)) {
+      // everything is constant, no need to go through the solver
+      ++stats::concreteMemoryOperations;
+      inBoundsSegment = inBoundsOffset = true;
+    } else {
+      ref<Expr> isEqualSegment = EqExpr::create(mo->getSegmentExpr(), segment);
+
+      ref<Expr> isOffsetInBounds = mo->getBoundsCheckOffset(offset, bytes);
+      isOffsetInBounds = optimizer.optimizeExpr(isOffsetInBounds, true);
+
+      solver->setTimeout(coreSolverTimeout);
+      bool successSegment = solver->mustBeTrue(
+          state.constraints, isEqualSegment, inBoundsSegment, state.queryMetaData);
+      bool success = solver->mustBeTrue(
+          state.constraints, isOffsetInBounds, inBoundsOffset, state.queryMetaData);
+      solver->setTimeout(time::Span());
+      if (!success || !successSegment) {
+        state.pc = state.prevPC;
+        terminateStateOnSolverError(state, "Query timed out (bounds check).");
+        return;
+      }
     }
 
     if (inBoundsSegment && inBoundsOffset) {
@@ -4966,10 +5391,15 @@ void Executor::executeMemoryOperation(ExecutionState &state,
   auto addressOptim = KValue(address.getSegment(),
                              optimizer.optimizeExpr(address.getOffset(), true));
   ResolutionList rl;
-  solver->setTimeout(coreSolverTimeout);
-  bool incomplete = state.addressSpace.resolve(state, solver, addressOptim, rl,
-                                               0, coreSolverTimeout);
-  solver->setTimeout(time::Span());
+  bool incomplete;
+  {
+    QueryProfiler::OriginScope origin(queryProfiler.get(),
+                                      QueryProfiler::Resolve);
+    solver->setTimeout(coreSolverTimeout);
+    incomplete = state.addressSpace.resolve(state, solver, addressOptim, rl, 0,
+                                            coreSolverTimeout);
+    solver->setTimeout(time::Span());
+  }
 
   // XXX there is some query wasteage here. who cares?
   ExecutionState *unbound = &state;
@@ -5056,6 +5486,8 @@ Executor::handleReadForLazyInit(ExecutionState &state, KInstruction *target,
                                 const MemoryObject *mo, const ObjectState *os,
                                 const ref<Expr> &offset, Expr::Width type,
                                 bool &shouldReadFromOffset) {
+  QueryProfiler::OriginScope origin(queryProfiler.get(),
+                                    QueryProfiler::LazyInit);
   KValue result;
   ref<ConstantExpr> constantZero = ConstantExpr::create(0, Context::get().getPointerWidth());
   uint64_t segmentValue = mo->getSegment();
@@ -5475,6 +5907,8 @@ bool Executor::getSymbolicSolution(const ExecutionState &state,
                                    std::pair<std::string,
                                    std::vector<unsigned char> > >
                                    &res) {
+  QueryProfiler::OriginScope origin(queryProfiler.get(),
+                                    QueryProfiler::TestGeneration);
 
   solver->setTimeout(coreSolverTimeout);
 
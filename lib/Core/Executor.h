@@ -33,6 +33,7 @@
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <set>
@@ -60,6 +61,8 @@ namespace llvm {
 
 namespace klee {  
   class Array;
+  class AsyncSolver;
+  class ConcreteJIT;
   struct Cell;
   class ExecutionState;
   class ExternalDispatcher;
@@ -67,15 +70,18 @@ namespace klee {
   class InstructionInfoTable;
   struct KFunction;
   struct KInstruction;
+  struct KSuccessor;
   class KInstIterator;
   class KModule;
   class MemoryManager;
   class MemoryObject;
   class ObjectState;
   class PTree;
+  class QueryProfiler;
   class Searcher;
   class SeedInfo;
   class SpecialFunctionHandler;
+  class StateSpiller;
   struct StackFrame;
   class StatsTracker;
   class TimingSolver;
@@ -118,6 +124,19 @@ private:
   SpecialFunctionHandler *specialFunctionHandler;
   TimerGroup timers;
   std::unique_ptr<PTree> processTree;
+
+  /// Moves states to disk under memory pressure, null unless enabled
+  std::unique_ptr<StateSpiller> stateSpiller;
+
+  /// Solves the core solver queries of parked states, null unless enabled
+  std::unique_ptr<AsyncSolver> asyncSolver;
+
+  /// Attributes solver queries to their origin, null unless enabled
+  std::unique_ptr<QueryProfiler> queryProfiler;
+
+  /// Runs calls of functions on concrete integers natively, null unless
+  /// enabled
+  std::unique_ptr<ConcreteJIT> concreteJIT;
   std::tuple<std::string, unsigned, unsigned> errorLoc;
 
   /// Used to track states that have been added during the current
@@ -169,6 +188,17 @@ private:
   /// object.
   unsigned replayPosition;
 
+  /// When non-null a list of branch decisions to follow before
+  /// exploring freely. \see setPathPrefix()
+  const std::vector<bool> *pathPrefix = nullptr;
+
+  /// The index into \ref pathPrefix.
+  unsigned pathPrefixPosition = 0;
+
+  /// Signals the executor to give away a pending state at the next
+  /// instruction step. \see requestPathDonation()
+  std::atomic<bool> pathDonationRequested{false};
+
   /// When non-null a list of "seed" inputs which will be used to
   /// drive execution.
   const std::vector<struct KTest *> *usingSeeds;  
@@ -247,6 +277,8 @@ private:
   void transferToBasicBlock(llvm::BasicBlock *dst, 
 			    llvm::BasicBlock *src,
 			    ExecutionState &state);
+  /// Transfer to a successor decoded by KModule, needs no lookup.
+  void transferToBasicBlock(const KSuccessor &dst, ExecutionState &state);
 
   void callExternalFunction(ExecutionState &state,
                             KInstruction *target,
@@ -335,12 +367,26 @@ private:
                    llvm::Function *f,
                    const std::vector<Cell> &arguments);
 
+  /// Run a call of a function on concrete integers natively.
+  /// \return false, having done nothing, if the function or its arguments
+  /// do not allow it
+  bool callNatively(ExecutionState &state, KInstruction *ki,
+                    llvm::Function *f, const std::vector<Cell> &arguments);
+
   void executeMemoryRead(ExecutionState &state,
                          const KValue &address,
                          KInstruction *target);
   void executeMemoryWrite(ExecutionState &state,
                           const KValue &address,
                           const KValue &value);
+  /// Check whether an access of the given number of bytes is in bounds
+  /// of mo without querying the solver. Only succeeds if the segment,
+  /// offset and the object size are all constant.
+  bool isConcreteAccessInBounds(const MemoryObject *mo,
+                                const ref<Expr> &segment,
+                                const ref<Expr> &offset,
+                                unsigned bytes) const;
+
   // do address resolution / object binding / out of bounds checking
   // and perform the operation
   void executeMemoryOperation(ExecutionState &state,
@@ -517,12 +563,39 @@ private:
                    enum StateTerminationType terminationType);
 
   /// check memory usage and terminate states when over threshold of -max-memory + 100MB
-  /// \return true if below threshold, false otherwise (states were terminated)
+  /// \return false if states were terminated, or if suspending states did
+  /// not bring usage back below -max-memory; true otherwise
   bool checkMemoryUsage();
 
+  /// Park the state if it is about to branch on a symbolic condition the
+  /// caches cannot decide; the core solver queries are then solved while
+  /// other states run.
+  /// \return true if the state was parked
+  bool parkOnBranch(ExecutionState &state);
+
   /// check if branching/forking is allowed
   bool branchingPermitted(const ExecutionState &state) const;
 
+  /// Whether there are decisions of the path prefix left to follow.
+  bool followsPathPrefix() const {
+    return pathPrefix && pathPrefixPosition < pathPrefix->size();
+  }
+
+  /// Read the decision between n alternatives from the path prefix.
+  /// \return false if the prefix does not fit the current branch, it is
+  /// not followed any further then
+  bool readPathChoice(unsigned n, unsigned &choice);
+
+  /// Stop following the path prefix after it diverged from the program.
+  void abandonPathPrefix();
+
+  /// Record the decision between n alternatives in the path of state.
+  void writePathChoice(ExecutionState &state, unsigned choice, unsigned n);
+
+  /// Hand the path of a pending state over to the interpreter handler
+  /// and drop the state.
+  void donatePath();
+
   void printDebugInstructions(ExecutionState &state);
   void doDumpStates();
 
@@ -558,6 +631,11 @@ public:
     replayPosition = 0;
   }
 
+  void setPathPrefix(const std::vector<bool> *prefix) override {
+    pathPrefix = prefix;
+    pathPrefixPosition = 0;
+  }
+
   void setReplayNondet(const struct KTest *out) override;
 
   llvm::Module *setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
@@ -574,6 +652,8 @@ public:
 
   void setHaltExecution(bool value) override { haltExecution = value; }
 
+  void requestPathDonation() override { pathDonationRequested = true; }
+
   void setInhibitForking(bool value) override { inhibitForking = value; }
 
   void prepareForEarlyExit() override;
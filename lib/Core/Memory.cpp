@@ -13,6 +13,7 @@
 #include "ExecutionState.h"
 #include "MemoryManager.h"
 
+#include "klee/ADT/SlabAllocator.h"
 #include "klee/Expr/ArrayCache.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Support/OptionCategories.h"
@@ -41,8 +42,29 @@ namespace {
 
 /***/
 
+namespace {
+/// MemoryObject, ObjectState and ObjectStatePlane are allocated and
+/// released for every alloca, so they are kept in slabs. The allocator is
+/// never destroyed, objects may still be released during static
+/// destruction.
+SlabAllocator &getMetadataAllocator() {
+  static SlabAllocator *allocator = new SlabAllocator();
+  return *allocator;
+}
+} // namespace
+
+/***/
+
 int MemoryObject::counter = 0;
 
+void *MemoryObject::operator new(size_t size) {
+  return getMetadataAllocator().allocate(size);
+}
+
+void MemoryObject::operator delete(void *ptr, size_t size) {
+  getMetadataAllocator().deallocate(ptr, size);
+}
+
 MemoryObject::~MemoryObject() {
   if (parent)
     parent->markFreed(this);
@@ -89,6 +111,14 @@ ref<Expr> MemoryObject::getSymbolicAddress(klee::ArrayCache &array) {
 
 /***/
 
+void *ObjectStatePlane::operator new(size_t size) {
+  return getMetadataAllocator().allocate(size);
+}
+
+void ObjectStatePlane::operator delete(void *ptr, size_t size) {
+  getMetadataAllocator().deallocate(ptr, size);
+}
+
 ObjectStatePlane::ObjectStatePlane(const ObjectState *parent)
   : parent(parent),
     updates(nullptr, nullptr),
@@ -207,7 +237,7 @@ void ObjectStatePlane::flushToConcreteStore(TimingSolver *solver,
       } else {
         uint8_t value;
         ce->toMemory(&value);
-        concreteStore[i] = value;
+        concreteStore.set(i, value);
       }
     }
   }
@@ -396,7 +426,7 @@ void ObjectStatePlane::write8(unsigned offset, uint8_t value) {
     sizeBound = offset + 1;
   if (concreteStore.size() <= offset)
     concreteStore.resize(sizeBound, initialValue);
-  concreteStore[offset] = value;
+  concreteStore.set(offset, value);
   setKnownSymbolic(offset, 0);
 
   markByteConcrete(offset);
@@ -586,8 +616,34 @@ void ObjectStatePlane::print() const {
   }
 }
 
+size_t ObjectStatePlane::getStorageBytes() const {
+  return sizeof(*this) + concreteStore.getStorageBytes() +
+         concreteMask.getStorageBytes() + knownSymbolics.getStorageBytes() +
+         unflushedMask.getStorageBytes();
+}
+
 /****/
 
+/// Objects without a segment plane hold no pointers, reads of their
+/// segments share one zero constant per width instead of allocating.
+static ref<Expr> getZeroSegment(Expr::Width width) {
+  static ref<ConstantExpr> zeroSegments[Expr::Int64 + 1];
+  if (width > Expr::Int64)
+    return ConstantExpr::alloc(0, width);
+  ref<ConstantExpr> &zero = zeroSegments[width];
+  if (zero.isNull())
+    zero = ConstantExpr::alloc(0, width);
+  return zero;
+}
+
+void *ObjectState::operator new(size_t size) {
+  return getMetadataAllocator().allocate(size);
+}
+
+void ObjectState::operator delete(void *ptr, size_t size) {
+  getMetadataAllocator().deallocate(ptr, size);
+}
+
 ObjectState::ObjectState(const MemoryObject *mo)
   : copyOnWriteOwner(0),
     object(mo),
@@ -621,8 +677,7 @@ ObjectState::ObjectState(const ObjectState &os, const MemoryObject *mo)
 }
 
 ObjectState::~ObjectState() {
-  if (segmentPlane)
-    delete segmentPlane;
+  delete segmentPlane;
   delete offsetPlane;
 }
 
@@ -631,7 +686,7 @@ KValue ObjectState::read8(unsigned offset) const {
   if (segmentPlane) {
     segment = segmentPlane->read8(offset);
   } else {
-    segment = ConstantExpr::alloc(0, Expr::Int8);
+    segment = getZeroSegment(Expr::Int8);
   }
   ref<Expr> value = offsetPlane->read8(offset);
   return KValue(segment, value);
@@ -642,7 +697,7 @@ KValue ObjectState::read(unsigned offset, Expr::Width width) const {
   if (segmentPlane) {
     segment = segmentPlane->read(offset, width);
   } else {
-    segment = ConstantExpr::alloc(0, width);
+    segment = getZeroSegment(width);
   }
   ref<Expr> value = offsetPlane->read(offset, width);
   return KValue(segment, value);
@@ -653,7 +708,7 @@ KValue ObjectState::read(ref<Expr> offset, Expr::Width width) const {
   if (segmentPlane) {
     segment = segmentPlane->read(offset, width);
   } else {
-    segment = ConstantExpr::alloc(0, width);
+    segment = getZeroSegment(width);
   }
   ref<Expr> value = offsetPlane->read(offset, width);
   return KValue(segment, value);
@@ -713,14 +768,28 @@ void ObjectState::write(ref<Expr> offset, const KValue& value) {
 }
 
 void ObjectState::initializeToZero() {
+  dropSegmentPlane();
   offsetPlane->initializeToZero();
 }
 
 void ObjectState::initializeToRandom() {
+  dropSegmentPlane();
   offsetPlane->initializeToRandom();
 }
 
+void ObjectState::dropSegmentPlane() {
+  delete segmentPlane;
+  segmentPlane = nullptr;
+}
+
 ArrayCache* ObjectState::getArrayCache() const {
   assert(object && "object was NULL");
   return object->parent->getArrayCache();
 }
+
+size_t ObjectState::getStorageBytes() const {
+  size_t bytes = sizeof(*this) + offsetPlane->getStorageBytes();
+  if (segmentPlane)
+    bytes += segmentPlane->getStorageBytes();
+  return bytes;
+}
@@ -13,7 +13,7 @@
 #include "Context.h"
 #include "TimingSolver.h"
 
-#include "klee/ADT/BitArray.h"
+#include "klee/ADT/PagedVector.h"
 #include "klee/Module/KValue.h"
 
 #include "llvm/ADT/Optional.h"
@@ -39,6 +39,7 @@ class MemoryObject {
   friend class STPBuilder;
   friend class ObjectState;
   friend class ExecutionState;
+  friend class MemoryManager;
   friend class ref<MemoryObject>;
   friend class ref<const MemoryObject>;
 
@@ -47,6 +48,10 @@ private:
   /// @brief Required by klee::ref-managed objects
   mutable class ReferenceCounter _refCount;
 
+  /// Links in the live object list of the parent MemoryManager
+  MemoryObject *prevLive = nullptr;
+  MemoryObject *nextLive = nullptr;
+
 public:
   unsigned id;
   uint64_t segment;
@@ -134,6 +139,9 @@ public:
 
   ~MemoryObject();
 
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr, size_t size);
+
   /// Get an identifying string for this allocation.
   void getAllocInfo(std::string &result) const;
 
@@ -236,10 +244,11 @@ private:
 // (leveraging the assumption that large offsets will
 // be sparse). Threshold is the maximal number of elements
 // in the vector.
+// The vector part is paged, so copies share the untouched parts.
 // This class is specialized for our needs, it is not generic...
 template <typename T, const size_t Threshold = (1 << 18)>
 class SparseVector {
-    std::vector<T> _vector;
+    PagedVector<T> _vector;
     std::unordered_map<size_t, T> _map;
 
 public:
@@ -270,7 +279,7 @@ public:
             }
 
             assert(_vector.size() > n);
-            _vector[n] = val;
+            _vector.set(n, val);
         } else {
             if (val.get() == nullptr) {
                 _map.erase(n);
@@ -288,23 +297,44 @@ public:
         return (_vector.size() > n && _vector[n].get())
                || (_map.find(n) != _map.end());
     }
+
+    /// Approximate number of bytes of heap memory held by the container.
+    size_t getStorageBytes() const {
+        return _vector.getStorageBytes() +
+               _map.size() * (sizeof(size_t) + sizeof(T) + 2 * sizeof(void *));
+    }
+
+    /// Call f(n, value) for every set element.
+    template <typename F> void forEach(F f) const {
+        for (size_t n = 0; n < _vector.size(); ++n)
+            if (_vector[n].get())
+                f(n, _vector[n]);
+        for (const auto &entry : _map)
+            f(entry.first, entry.second);
+    }
 };
 
 class ObjectStatePlane {
 private:
   friend class AddressSpace;
+  friend class StateSpiller;
   friend class ref<ObjectState>;
 
   /// @brief Required by klee::ref-managed objects
   class ReferenceCounter _refCount;
 
-  ref<const ObjectState> parent;
+  /// The object state owning this plane. Not a reference, the owner
+  /// would otherwise keep itself alive.
+  const ObjectState *parent;
+
+  // The per-byte stores below are paged, copying a plane for a forked
+  // state only clones the pages that the state writes to afterwards.
 
   /// @brief Holds all known concrete bytes
-  std::vector<uint8_t> concreteStore;
+  PagedVector<uint8_t> concreteStore;
 
   /// @brief concreteMask[byte] is set if byte is known to be concrete
-  BitArray concreteMask;
+  PagedBitArray concreteMask;
 
   /// knownSymbolics[byte] holds the symbolic expression for byte,
   /// if byte is known to be symbolic
@@ -312,7 +342,7 @@ private:
 
   /// unflushedMask[byte] is set if byte is unflushed
   /// mutable because may need flushed during read of const
-  mutable BitArray unflushedMask;
+  mutable PagedBitArray unflushedMask;
 
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
@@ -338,6 +368,9 @@ public:
   ObjectStatePlane(const ObjectState *parent, const ObjectStatePlane &os);
   ~ObjectStatePlane() = default;
 
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr, size_t size);
+
   /// Make contents all concrete and zero
   void initializeToZero();
 
@@ -357,6 +390,9 @@ public:
   void write64(unsigned offset, uint64_t value);
   void print() const;
 
+  /// Approximate number of bytes of memory held by the plane.
+  size_t getStorageBytes() const;
+
   /*
     Looks at all the symbolic bytes of this object, gets a value for them
     from the solver and puts them in the concreteStore.
@@ -399,6 +435,7 @@ private:
   unsigned copyOnWriteOwner; // exclusively for AddressSpace
 
   friend class ObjectHolder;
+  friend class StateSpiller;
   friend class ref<ObjectState>;
   friend class ref<const ObjectState>;
 
@@ -412,6 +449,9 @@ public:
   bool readOnly;
 
 private:
+  /// Segments of the stored values. Null as long as the object holds no
+  /// pointers, i.e. all of its segments are zero. Materialized by the
+  /// first write of a non-zero segment.
   ObjectStatePlane *segmentPlane;
   ObjectStatePlane *offsetPlane;
 
@@ -430,6 +470,9 @@ public:
   ObjectState(const ObjectState &os, const MemoryObject *mo);
   ~ObjectState();
 
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr, size_t size);
+
   const MemoryObject *getObject() const { return object.get(); }
 
   void setReadOnly(bool ro) {
@@ -466,9 +509,15 @@ public:
 
   ArrayCache *getArrayCache() const;
 
+  /// Approximate number of bytes of memory held by the object state,
+  /// including storage shared with copies.
+  size_t getStorageBytes() const;
+
 private:
   bool prepareSegmentPlane(bool nonzero);
   bool prepareSegmentPlane(ref<Expr> value);
+  /// Go back to all zero segments.
+  void dropSegmentPlane();
 };
   
 } // End klee namespace
@@ -228,11 +228,18 @@ MemoryManager::MemoryManager(ArrayCache *_arrayCache, unsigned pointerWidth)
       lastSegment(FIRST_ORDINARY_SEGMENT) {}
 
 MemoryManager::~MemoryManager() {
-  while (!objects.empty()) {
-    MemoryObject *mo = *objects.begin();
-    objects.erase(mo);
-    delete mo;
-  }
+  // deleting an object unlinks it via markFreed
+  while (liveObjects)
+    delete liveObjects;
+}
+
+void MemoryManager::registerObject(MemoryObject *mo) {
+  assert(!mo->prevLive && !mo->nextLive);
+  mo->nextLive = liveObjects;
+  if (liveObjects)
+    liveObjects->prevLive = mo;
+  liveObjects = mo;
+  ++liveObjectCount;
 }
 
 MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal,
@@ -283,7 +290,7 @@ MemoryObject *MemoryManager::allocate(ref<Expr> size, bool isLocal,
   MemoryObject *res = new MemoryObject(++lastSegment,
                                        size, concreteSize,
                                        isLocal, isGlobal, false, allocSite, this);
-  objects.insert(res);
+  registerObject(res);
   return res;
 }
 
@@ -303,14 +310,23 @@ MemoryObject *MemoryManager::allocateFixed(uint64_t size,
         new MemoryObject(specialSegment, sizeExpr, size,
                          false, true, true, allocSite, this);
   }
-  objects.insert(res);
+  registerObject(res);
   return res;
 }
 
 void MemoryManager::deallocate(const MemoryObject *mo) { assert(0); }
 
 void MemoryManager::markFreed(MemoryObject *mo) {
-  objects.erase(mo);
+  if (mo->prevLive)
+    mo->prevLive->nextLive = mo->nextLive;
+  else if (liveObjects == mo)
+    liveObjects = mo->nextLive;
+  else
+    return; // not registered
+  if (mo->nextLive)
+    mo->nextLive->prevLive = mo->prevLive;
+  mo->prevLive = mo->nextLive = nullptr;
+  --liveObjectCount;
 }
 
 size_t MemoryManager::getUsedDeterministicSize() const {
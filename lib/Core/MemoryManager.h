@@ -13,7 +13,6 @@
 #include "klee/Expr/Expr.h"
 
 #include <cstddef>
-#include <set>
 #include <unordered_map>
 #include <vector>
 #include <cstdint>
@@ -100,12 +99,15 @@ public:
 
 class MemoryManager {
 private:
-  typedef std::set<MemoryObject *> objects_ty;
-  objects_ty objects;
+  /// Live memory objects, linked through MemoryObject::prevLive/nextLive
+  MemoryObject *liveObjects{nullptr};
+  size_t liveObjectCount{0};
   ArrayCache *const arrayCache;
 
   MemoryAllocator allocator;
   uint64_t lastSegment;
+
+  void registerObject(MemoryObject *mo);
 public:
   MemoryManager(ArrayCache *arrayCache,
                 unsigned pointerWidth = 64);
@@ -130,6 +132,10 @@ public:
 
   uint64_t getLastSegment() const { return lastSegment; }
 
+  /// Returns the number of memory objects allocated by this manager that
+  /// were not freed yet
+  size_t getLiveObjectCount() const { return liveObjectCount; }
+
   /*
    * Returns the size used by deterministic allocation in bytes
    */
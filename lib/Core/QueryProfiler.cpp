@@ -0,0 +1,230 @@
+//===-- QueryProfiler.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QueryProfiler.h"
+
+#include "klee/Expr/Constraints.h"
+#include "klee/Module/InstructionInfoTable.h"
+#include "klee/Module/KInstruction.h"
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+
+#include <limits>
+#include <unordered_set>
+
+#include <sqlite3.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+/// The trace starts with the magic, the size of a record and the number of
+/// solver layers, followed by one record per query. Values are in host
+/// byte order, times in microseconds.
+const char traceMagic[8] = {'K', 'Q', 'P', 'R', 'O', 'F', '0', '1'};
+
+struct TraceRecord {
+  /// Id of the instruction (see InstructionInfo), all ones if unknown
+  std::uint32_t instruction;
+  std::uint8_t origin;
+  std::uint8_t kind;
+  std::uint8_t success;
+  std::uint8_t reserved;
+  std::uint32_t constraints;
+  /// Number of distinct nodes of the queried expressions
+  std::uint32_t exprSize;
+  std::uint64_t time;
+  std::uint64_t layers[SolverLayerTimes::NumLayers];
+};
+static_assert(sizeof(TraceRecord) == 24 + 8 * SolverLayerTimes::NumLayers,
+              "trace records must not be padded");
+
+void countNodes(const ref<Expr> &e, std::unordered_set<const Expr *> &seen) {
+  std::vector<const Expr *> stack{e.get()};
+  while (!stack.empty()) {
+    const Expr *node = stack.back();
+    stack.pop_back();
+    if (!seen.insert(node).second)
+      continue;
+    for (unsigned i = 0, n = node->getNumKids(); i != n; ++i)
+      stack.push_back(node->getKid(i).get());
+  }
+}
+
+std::uint32_t saturate(std::uint64_t value) {
+  return std::min<std::uint64_t>(value,
+                                 std::numeric_limits<std::uint32_t>::max());
+}
+} // namespace
+
+QueryProfiler::QueryProfiler(std::unique_ptr<llvm::raw_fd_ostream> trace,
+                             std::string summaryPath)
+    : trace(std::move(trace)), summaryPath(std::move(summaryPath)),
+      owner(getpid()) {
+  if (this->trace) {
+    std::uint32_t header[2] = {sizeof(TraceRecord),
+                               SolverLayerTimes::NumLayers};
+    this->trace->write(traceMagic, sizeof(traceMagic));
+    this->trace->write(reinterpret_cast<const char *>(header),
+                       sizeof(header));
+  }
+}
+
+QueryProfiler::~QueryProfiler() {
+  if (getpid() != owner)
+    return;
+  if (trace)
+    trace->flush();
+  writeSummary();
+}
+
+const char *QueryProfiler::getOriginName(Origin origin) {
+  switch (origin) {
+  case Other:
+    return "Other";
+  case Branch:
+    return "Branch";
+  case BoundsCheck:
+    return "BoundsCheck";
+  case Resolve:
+    return "Resolve";
+  case External:
+    return "External";
+  case LazyInit:
+    return "LazyInit";
+  case Concretize:
+    return "Concretize";
+  case TestGeneration:
+    return "TestGeneration";
+  default:
+    return "Unknown";
+  }
+}
+
+void QueryProfiler::record(Kind kind, const ConstraintSet &constraints,
+                           const ref<Expr> &expr, time::Span time,
+                           bool success) {
+  std::unordered_set<const Expr *> seen;
+  if (!expr.isNull())
+    countNodes(expr, seen);
+  record(kind, constraints, seen.size(), time, success);
+}
+
+void QueryProfiler::record(Kind kind, const ConstraintSet &constraints,
+                           const std::vector<ref<Expr>> &exprs,
+                           time::Span time, bool success) {
+  std::unordered_set<const Expr *> seen;
+  for (const auto &expr : exprs)
+    countNodes(expr, seen);
+  record(kind, constraints, seen.size(), time, success);
+}
+
+void QueryProfiler::record(Kind kind, const ConstraintSet &constraints,
+                           std::uint64_t exprSize, time::Span time,
+                           bool success) {
+  // the layers only ever add up the time of queries of this process
+  SolverLayerTimes layers = layerTimes;
+  layerTimes = SolverLayerTimes();
+  if (getpid() != owner)
+    return;
+
+  Site &site = sites[std::make_pair(instruction, origin)];
+  ++site.queries;
+  if (!success)
+    ++site.failures;
+  site.constraints += constraints.size();
+  site.exprSize += exprSize;
+  site.time += time;
+  for (unsigned i = 0; i != SolverLayerTimes::NumLayers; ++i)
+    site.layers[i] += layers.times[i];
+
+  if (!trace)
+    return;
+  TraceRecord r;
+  r.instruction = instruction ? instruction->info->id
+                              : std::numeric_limits<std::uint32_t>::max();
+  r.origin = origin;
+  r.kind = kind;
+  r.success = success;
+  r.reserved = 0;
+  r.constraints = saturate(constraints.size());
+  r.exprSize = saturate(exprSize);
+  r.time = time.toMicroseconds();
+  for (unsigned i = 0; i != SolverLayerTimes::NumLayers; ++i)
+    r.layers[i] = layers.times[i].toMicroseconds();
+  trace->write(reinterpret_cast<const char *>(&r), sizeof(r));
+}
+
+void QueryProfiler::writeSummary() {
+  sqlite3 *db;
+  if (sqlite3_open(summaryPath.c_str(), &db) != SQLITE_OK) {
+    klee_warning("Can't open query profile %s: %s", summaryPath.c_str(),
+                 sqlite3_errmsg(db));
+    sqlite3_close(db);
+    return;
+  }
+
+  const char *create =
+      "DROP TABLE IF EXISTS sites;"
+      "CREATE TABLE sites (Origin TEXT, Function TEXT, File TEXT, "
+      "Line INTEGER, AssemblyLine INTEGER, Queries INTEGER, "
+      "Failures INTEGER, Constraints INTEGER, ExprSize INTEGER, "
+      "Time INTEGER, IndependentTime INTEGER, CachingTime INTEGER, "
+      "CexCachingTime INTEGER, CoreTime INTEGER);"
+      "BEGIN TRANSACTION;";
+  sqlite3_stmt *insert = nullptr;
+  char *error = nullptr;
+  if (sqlite3_exec(db, create, nullptr, nullptr, &error) != SQLITE_OK ||
+      sqlite3_prepare_v2(db,
+                         "INSERT INTO sites VALUES "
+                         "(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
+                         -1, &insert, nullptr) != SQLITE_OK) {
+    klee_warning("Can't write query profile: %s",
+                 error ? error : sqlite3_errmsg(db));
+    sqlite3_free(error);
+    sqlite3_close(db);
+    return;
+  }
+
+  for (const auto &entry : sites) {
+    const KInstruction *ki = entry.first.first;
+    const Site &site = entry.second;
+    int column = 0;
+    sqlite3_bind_text(insert, ++column, getOriginName(entry.first.second), -1,
+                      SQLITE_STATIC);
+    if (ki) {
+      const llvm::Function *f = ki->inst->getFunction();
+      sqlite3_bind_text(insert, ++column, f->getName().data(),
+                        f->getName().size(), SQLITE_TRANSIENT);
+      sqlite3_bind_text(insert, ++column, ki->info->file.c_str(), -1,
+                        SQLITE_TRANSIENT);
+      sqlite3_bind_int64(insert, ++column, ki->info->line);
+      sqlite3_bind_int64(insert, ++column, ki->info->assemblyLine);
+    } else {
+      for (unsigned i = 0; i != 4; ++i)
+        sqlite3_bind_null(insert, ++column);
+    }
+    sqlite3_bind_int64(insert, ++column, site.queries);
+    sqlite3_bind_int64(insert, ++column, site.failures);
+    sqlite3_bind_int64(insert, ++column, site.constraints);
+    sqlite3_bind_int64(insert, ++column, site.exprSize);
+    sqlite3_bind_int64(insert, ++column, site.time.toMicroseconds());
+    for (unsigned i = 0; i != SolverLayerTimes::NumLayers; ++i)
+      sqlite3_bind_int64(insert, ++column, site.layers[i].toMicroseconds());
+    if (sqlite3_step(insert) != SQLITE_DONE)
+      klee_warning("Can't write query profile: %s", sqlite3_errmsg(db));
+    sqlite3_reset(insert);
+  }
+
+  sqlite3_finalize(insert);
+  sqlite3_exec(db, "END TRANSACTION", nullptr, nullptr, nullptr);
+  sqlite3_close(db);
+}
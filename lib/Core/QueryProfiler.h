@@ -0,0 +1,133 @@
+//===-- QueryProfiler.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_QUERYPROFILER_H
+#define KLEE_QUERYPROFILER_H
+
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/Solver.h"
+#include "klee/System/Time.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace klee {
+class ConstraintSet;
+struct KInstruction;
+
+/// Records every query that reaches the solver chain together with where
+/// it comes from: the kind of check the executor performs, the instruction
+/// executed, the size of the query and the time spent in each layer of the
+/// chain.
+///
+/// Queries are appended to a binary trace as they happen, and aggregated
+/// per instruction and origin into a summary database that klee-stats
+/// reads (klee-stats --query-profile).
+class QueryProfiler {
+public:
+  /// Why the executor asks the solver
+  enum Origin : std::uint8_t {
+    Other,
+    Branch,
+    BoundsCheck,
+    Resolve,
+    External,
+    LazyInit,
+    Concretize,
+    TestGeneration,
+    NumOrigins
+  };
+
+  /// The solver operation
+  enum Kind : std::uint8_t {
+    Validity,
+    Truth,
+    Value,
+    InitialValues,
+    Range,
+    MultiTruth,
+    NumKinds
+  };
+
+  /// Sets the origin of the queries issued while it is alive.
+  class OriginScope {
+    QueryProfiler *profiler;
+    Origin outer = Other;
+
+  public:
+    OriginScope(QueryProfiler *profiler, Origin origin) : profiler(profiler) {
+      if (profiler) {
+        outer = profiler->origin;
+        profiler->origin = origin;
+      }
+    }
+    ~OriginScope() {
+      if (profiler)
+        profiler->origin = outer;
+    }
+  };
+
+  /// Filled in by the profiling solvers of the chain, see
+  /// constructSolverChain
+  SolverLayerTimes layerTimes;
+
+private:
+  struct Site {
+    std::uint64_t queries = 0;
+    std::uint64_t failures = 0;
+    std::uint64_t constraints = 0;
+    std::uint64_t exprSize = 0;
+    time::Span time;
+    time::Span layers[SolverLayerTimes::NumLayers];
+  };
+
+  std::unique_ptr<llvm::raw_fd_ostream> trace;
+  std::string summaryPath;
+  /// Queries of processes forked from the executor are not recorded
+  pid_t owner;
+  Origin origin = Other;
+  const KInstruction *instruction = nullptr;
+  std::map<std::pair<const KInstruction *, Origin>, Site> sites;
+
+  void record(Kind kind, const ConstraintSet &constraints,
+              std::uint64_t exprSize, time::Span time, bool success);
+  void writeSummary();
+
+public:
+  /// \param trace - Receives the binary trace, may be null.
+  /// \param summaryPath - The summary database written on destruction.
+  QueryProfiler(std::unique_ptr<llvm::raw_fd_ostream> trace,
+                std::string summaryPath);
+  ~QueryProfiler();
+
+  static const char *getOriginName(Origin origin);
+
+  /// Attribute the following queries to ki.
+  void setInstruction(const KInstruction *ki) { instruction = ki; }
+
+  /// Record a query that took time in total; the time of the layers is
+  /// taken from layerTimes, which is reset.
+  void record(Kind kind, const ConstraintSet &constraints,
+              const ref<Expr> &expr, time::Span time, bool success);
+  void record(Kind kind, const ConstraintSet &constraints,
+              const std::vector<ref<Expr>> &exprs, time::Span time,
+              bool success);
+};
+
+} // namespace klee
+
+#endif /* KLEE_QUERYPROFILER_H */
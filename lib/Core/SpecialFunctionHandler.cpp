@@ -450,7 +450,7 @@ void SpecialFunctionHandler::handleNew(ExecutionState &state,
   // XXX should type check args
   assert(arguments.size()==1 && "invalid number of arguments to new");
 
-  executor.executeAlloc(state, arguments[0].value, false, target);
+  executor.executeAlloc(state, arguments[0].getValue(), false, target);
 }
 
 void SpecialFunctionHandler::handleDelete(ExecutionState &state,
@@ -469,7 +469,7 @@ void SpecialFunctionHandler::handleNewArray(ExecutionState &state,
                               const std::vector<Cell> &arguments) {
   // XXX should type check args
   assert(arguments.size()==1 && "invalid number of arguments to new[]");
-  executor.executeAlloc(state, arguments[0].value, false, target);
+  executor.executeAlloc(state, arguments[0].getValue(), false, target);
 }
 
 void SpecialFunctionHandler::handleDeleteArray(ExecutionState &state,
@@ -485,7 +485,7 @@ void SpecialFunctionHandler::handleMalloc(ExecutionState &state,
                                   const std::vector<Cell> &arguments) {
   // XXX should type check args
   assert(arguments.size()==1 && "invalid number of arguments to malloc");
-  auto *mo = executor.executeAlloc(state, arguments[0].value, false, target);
+  auto *mo = executor.executeAlloc(state, arguments[0].getValue(), false, target);
 
   if (SymbolicMallocs && mo) {
     executor.executeMakeSymbolic(state, mo, "malloc"+std::to_string(mo->id));
@@ -543,7 +543,7 @@ void SpecialFunctionHandler::handleEhUnwindRaiseExceptionImpl(
   assert(arguments.size() == 1 &&
          "invalid number of arguments to _klee_eh_Unwind_RaiseException_impl");
 
-  ref<ConstantExpr> exceptionObject = dyn_cast<ConstantExpr>(arguments[0].value);
+  ref<ConstantExpr> exceptionObject = dyn_cast<ConstantExpr>(arguments[0].getValue());
   if (!exceptionObject.get()) {
     executor.terminateStateOnExecError(state, "Internal error: Symbolic exception pointer");
     return;
@@ -570,7 +570,7 @@ void SpecialFunctionHandler::handleEhTypeid(ExecutionState &state,
   assert(arguments.size() == 1 &&
          "invalid number of arguments to klee_eh_typeid_for");
 
-  executor.bindLocal(target, state, executor.getEhTypeidFor(arguments[0].value));
+  executor.bindLocal(target, state, executor.getEhTypeidFor(arguments[0].getValue()));
 }
 #endif // SUPPORT_KLEE_EH_CXX
 
@@ -579,7 +579,7 @@ void SpecialFunctionHandler::handleAssume(ExecutionState &state,
                             const std::vector<Cell> &arguments) {
   assert(arguments.size()==1 && "invalid number of arguments to klee_assume");
 
-  ref<Expr> e = arguments[0].value;
+  ref<Expr> e = arguments[0].getValue();
   
   if (e->getWidth() != Expr::Bool)
     e = NeExpr::create(e, ConstantExpr::create(0, e->getWidth()));
@@ -615,7 +615,7 @@ void SpecialFunctionHandler::handlePreferCex(ExecutionState &state,
   assert(arguments.size()==2 &&
          "invalid number of arguments to klee_prefex_cex");
 
-  ref<Expr> cond = arguments[1].value;
+  ref<Expr> cond = arguments[1].getValue();
   if (cond->getWidth() != Expr::Bool)
     cond = NeExpr::create(cond, ConstantExpr::alloc(0, cond->getWidth()));
 
@@ -647,7 +647,7 @@ void SpecialFunctionHandler::handleSetForking(ExecutionState &state,
                                               const std::vector<Cell> &arguments) {
   assert(arguments.size()==1 &&
          "invalid number of arguments to klee_set_forking");
-  ref<Expr> value = executor.toUnique(state, arguments[0].value);
+  ref<Expr> value = executor.toUnique(state, arguments[0].getValue());
   
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
     state.forkDisabled = CE->isZero();
@@ -691,15 +691,15 @@ void SpecialFunctionHandler::handlePrintRange(ExecutionState &state,
 
   std::string msg_str = readStringAtAddress(state, arguments[0]);
   llvm::errs() << msg_str << ":" << arguments[1];
-  if (!isa<ConstantExpr>(arguments[1].value)) {
+  if (!isa<ConstantExpr>(arguments[1].getValue())) {
     // FIXME: Pull into a unique value method?
     ref<ConstantExpr> value;
     bool success __attribute__((unused)) = executor.solver->getValue(
-        state.constraints, arguments[1].value, value, state.queryMetaData);
+        state.constraints, arguments[1].getValue(), value, state.queryMetaData);
     assert(success && "FIXME: Unhandled solver failure");
     bool res;
     success = executor.solver->mustBeTrue(state.constraints,
-                                          EqExpr::create(arguments[1].value, value),
+                                          EqExpr::create(arguments[1].getValue(), value),
                                           res, state.queryMetaData);
     assert(success && "FIXME: Unhandled solver failure");
     if (res) {
@@ -707,7 +707,7 @@ void SpecialFunctionHandler::handlePrintRange(ExecutionState &state,
     } else { 
       llvm::errs() << " ~= " << value;
       std::pair<ref<Expr>, ref<Expr>> res = executor.solver->getRange(
-          state.constraints, arguments[1].value, state.queryMetaData);
+          state.constraints, arguments[1].getValue(), state.queryMetaData);
       llvm::errs() << " (in [" << res.first << ", " << res.second <<"])";
     }
   }
@@ -784,8 +784,8 @@ void SpecialFunctionHandler::handleCalloc(ExecutionState &state,
   assert(arguments.size()==2 &&
          "invalid number of arguments to calloc");
 
-  ref<Expr> size = MulExpr::create(arguments[0].value,
-                                   arguments[1].value);
+  ref<Expr> size = MulExpr::create(arguments[0].getValue(),
+                                   arguments[1].getValue());
   executor.executeAlloc(state, size, false, target, true);
 }
 
@@ -796,7 +796,7 @@ void SpecialFunctionHandler::handleRealloc(ExecutionState &state,
   assert(arguments.size()==2 &&
          "invalid number of arguments to realloc");
   const KValue &address = arguments[0];
-  ref<Expr> size = arguments[1].value;
+  ref<Expr> size = arguments[1].getValue();
 
   // If ptr is NULL, then the call is equivalent to malloc(size), for all
   // values of size; if size is equal to zero, and ptr is not NULL, then the
@@ -878,7 +878,7 @@ void SpecialFunctionHandler::handleCheckMemoryAccess(ExecutionState &state,
          "invalid number of arguments to klee_check_memory_access");
 
   const KValue &address = arguments[0];
-  ref<Expr> size = executor.toUnique(state, arguments[1].value);
+  ref<Expr> size = executor.toUnique(state, arguments[1].getValue());
   if (!address.isConstant() || !isa<ConstantExpr>(size)) {
     executor.terminateStateOnUserError(state, "check_memory_access requires constant args");
   } else {
@@ -918,15 +918,15 @@ void SpecialFunctionHandler::handleDefineFixedObject(ExecutionState &state,
   assert(arguments.size()==2 &&
          "invalid number of arguments to klee_define_fixed_object");
   // TODO segment
-  assert(isa<ConstantExpr>(arguments[0].value) &&
+  assert(isa<ConstantExpr>(arguments[0].getValue()) &&
          "expect constant address argument to klee_define_fixed_object");
   // TODO segment
-  assert(isa<ConstantExpr>(arguments[1].value) &&
+  assert(isa<ConstantExpr>(arguments[1].getValue()) &&
          "expect constant size argument to klee_define_fixed_object");
 
   // TODO segment
-  uint64_t size = cast<ConstantExpr>(arguments[1].value)->getZExtValue();
-  ref<ConstantExpr> addressExpr = cast<ConstantExpr>(arguments[0].value);
+  uint64_t size = cast<ConstantExpr>(arguments[1].getValue())->getZExtValue();
+  ref<ConstantExpr> addressExpr = cast<ConstantExpr>(arguments[0].getValue());
   uint64_t address = addressExpr->getZExtValue();
 
   ResolutionList rl;
@@ -938,8 +938,7 @@ void SpecialFunctionHandler::handleDefineFixedObject(ExecutionState &state,
 
   MemoryObject *mo = executor.memory->allocateFixed(size, state.prevPC->inst);
   executor.bindObjectInState(state, mo, false);
-  state.addressSpace.concreteAddressMap.emplace(address, mo->segment);
-  state.addressSpace.segmentMap.insert(std::make_pair(mo->segment, mo));
+  state.addressSpace.bindConcreteAddress(address, mo->segment);
   mo->isUserSpecified = true; // XXX hack;
 }
 
@@ -997,7 +996,7 @@ void SpecialFunctionHandler::handleMakeSymbolic(ExecutionState &state,
         "Incorrect number of arguments to klee_make_symbolic(void*, size_t, char*)");
     return;
   }
-  bool isZero = arguments[2].pointerSegment->isZero() && arguments[2].value->isZero();
+  bool isZero = arguments[2].isZero();
   name = isZero ? "" : readStringAtAddress(state, arguments[2]);
 
   if (name.length() == 0) {
@@ -1026,7 +1025,7 @@ void SpecialFunctionHandler::handleMakeSymbolic(ExecutionState &state,
     bool success __attribute__((unused)) = executor.solver->mustBeTrue(
         s->constraints,
         EqExpr::create(
-            ZExtExpr::create(arguments[1].value, Context::get().getPointerWidth()),
+            ZExtExpr::create(arguments[1].getValue(), Context::get().getPointerWidth()),
             mo->getSizeExpr()),
         res, s->queryMetaData);
     assert(success && "FIXME: Unhandled solver failure");
@@ -0,0 +1,652 @@
+//===-- StateSpiller.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "StateSpiller.h"
+
+#include "AddressSpace.h"
+#include "ExecutionState.h"
+#include "Memory.h"
+
+#include "klee/Expr/Expr.h"
+#include "klee/Module/Cell.h"
+#include "klee/Module/KModule.h"
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/FileSystem.h"
+
+#include <cstdio>
+#include <fstream>
+
+using namespace llvm;
+using namespace klee;
+
+namespace klee {
+
+/// Binary output of a suspended state. Every expression is defined once,
+/// after the expressions it refers to, and referred to by its index
+/// afterwards. Update nodes are numbered the same way. Expressions are
+/// traversed with an explicit stack, as they can be arbitrarily deep.
+class SpillWriter {
+  std::ofstream out;
+  DenseMap<const Expr *, uint64_t> exprIds;
+  DenseMap<const UpdateNode *, uint64_t> nodeIds;
+
+  /// Calls f with the nodes of updates that are not written yet, newest
+  /// first, and returns the newest node that is written already.
+  template <typename F>
+  const UpdateNode *forEachFreshNode(const UpdateList &updates, F f) const {
+    const UpdateNode *un = updates.head.get();
+    for (; un && !nodeIds.count(un); un = un->next.get())
+      f(un);
+    return un;
+  }
+
+  void writeId(const ref<Expr> &e) { write(exprIds.find(e.get())->second); }
+
+  /// Writes the update nodes of updates that are not written yet. The
+  /// expressions of these nodes must be defined already.
+  void writeNodes(const UpdateList &updates) {
+    writePointer(updates.root);
+    std::vector<const UpdateNode *> fresh;
+    const UpdateNode *base = forEachFreshNode(
+        updates, [&](const UpdateNode *un) { fresh.push_back(un); });
+    if (base) {
+      write(Known);
+      write(nodeIds[base]);
+    } else {
+      write(Null);
+    }
+    write(static_cast<uint64_t>(fresh.size()));
+    for (auto it = fresh.rbegin(), ie = fresh.rend(); it != ie; ++it) {
+      writeId((*it)->index);
+      writeId((*it)->value);
+      nodeIds.insert(std::make_pair(*it, nodeIds.size()));
+    }
+  }
+
+  /// Writes the definition of e, whose operands are defined already.
+  void writeDefinition(const Expr *e) {
+    write(New);
+    write(static_cast<int32_t>(e->getKind()));
+    switch (e->getKind()) {
+    case Expr::Constant: {
+      const APInt &value = cast<ConstantExpr>(e)->getAPValue();
+      write(value.getBitWidth());
+      writeBytes(value.getRawData(), value.getNumWords() * sizeof(uint64_t));
+      break;
+    }
+    case Expr::Read: {
+      const ReadExpr *re = cast<ReadExpr>(e);
+      writeNodes(re->updates);
+      writeId(re->index);
+      break;
+    }
+    case Expr::Extract: {
+      const ExtractExpr *ee = cast<ExtractExpr>(e);
+      write(ee->offset);
+      write(ee->width);
+      writeId(ee->expr);
+      break;
+    }
+    case Expr::ZExt:
+    case Expr::SExt:
+      write(e->getWidth());
+      writeId(e->getKid(0));
+      break;
+    default:
+      for (unsigned i = 0; i < e->getNumKids(); ++i)
+        writeId(e->getKid(i));
+      break;
+    }
+    exprIds.insert(std::make_pair(e, exprIds.size()));
+  }
+
+  /// Writes the definitions of e and of all expressions it refers to that
+  /// are not written yet.
+  void define(const ref<Expr> &root) {
+    // expressions with the flag set have their operands pushed already
+    std::vector<std::pair<const Expr *, bool>> stack;
+    stack.emplace_back(root.get(), false);
+    while (!stack.empty()) {
+      const Expr *e = stack.back().first;
+      if (exprIds.count(e)) {
+        stack.pop_back();
+        continue;
+      }
+      if (stack.back().second) {
+        stack.pop_back();
+        writeDefinition(e);
+        continue;
+      }
+      stack.back().second = true;
+      for (unsigned i = 0; i < e->getNumKids(); ++i)
+        stack.emplace_back(e->getKid(i).get(), false);
+      if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+        forEachFreshNode(re->updates, [&](const UpdateNode *un) {
+          stack.emplace_back(un->index.get(), false);
+          stack.emplace_back(un->value.get(), false);
+        });
+      }
+    }
+  }
+
+public:
+  enum Tag : uint8_t { Null, Known, New, End };
+
+  explicit SpillWriter(const std::string &path)
+      : out(path, std::ios::binary | std::ios::trunc) {}
+
+  bool good() const { return out.good(); }
+  void close() { out.close(); }
+
+  template <typename T> void write(const T &value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  template <typename T> void writePointer(const T *ptr) {
+    write(reinterpret_cast<uint64_t>(ptr));
+  }
+
+  void writeBytes(const void *data, uint64_t size) {
+    write(size);
+    out.write(static_cast<const char *>(data), size);
+  }
+
+  void writeString(const std::string &s) { writeBytes(s.data(), s.size()); }
+
+  void writeBits(const PagedBitArray &bits) {
+    std::vector<uint8_t> packed((bits.size() + 7) / 8);
+    for (unsigned i = 0; i < bits.size(); ++i)
+      if (bits.get(i))
+        packed[i / 8] |= 1 << (i % 8);
+    write(bits.size());
+    writeBytes(packed.data(), packed.size());
+  }
+
+  void writeExpr(const ref<Expr> &e) {
+    if (e.isNull()) {
+      write(Null);
+      return;
+    }
+    define(e);
+    write(Known);
+    writeId(e);
+  }
+
+  void writeUpdates(const UpdateList &updates) {
+    forEachFreshNode(updates, [&](const UpdateNode *un) {
+      define(un->index);
+      define(un->value);
+    });
+    write(End);
+    writeNodes(updates);
+  }
+
+  void writeKValue(const KValue &value) {
+    writeExpr(value.getSegment());
+    writeExpr(value.getValue());
+  }
+};
+
+/// Reads the output of SpillWriter. Reading fails instead of aborting if
+/// the data is not a valid output, e.g. because the file was truncated.
+class SpillReader {
+  std::ifstream in;
+  uint64_t size = 0;
+  bool failed = false;
+  std::vector<ref<Expr>> exprs;
+  std::vector<ref<UpdateNode>> nodes;
+
+  ref<Expr> readId() {
+    uint64_t id = read<uint64_t>();
+    if (id >= exprs.size()) {
+      failed = true;
+      return nullptr;
+    }
+    return exprs[id];
+  }
+
+  UpdateList readNodes() {
+    const Array *root = readPointer<const Array>();
+    ref<UpdateNode> head;
+    if (read<SpillWriter::Tag>() == SpillWriter::Known) {
+      uint64_t id = read<uint64_t>();
+      if (id >= nodes.size()) {
+        failed = true;
+        return UpdateList(root, nullptr);
+      }
+      head = nodes[id];
+    }
+    for (uint64_t i = 0, count = read<uint64_t>(); i < count && good(); ++i) {
+      ref<Expr> index = readId();
+      ref<Expr> value = readId();
+      if (!good())
+        break;
+      head = new UpdateNode(head, index, value);
+      nodes.push_back(head);
+    }
+    return UpdateList(root, head);
+  }
+
+  /// Reads the definition of an expression, which is rebuilt as it was,
+  /// without simplifications.
+  bool readDefinition() {
+    ref<Expr> e;
+    auto kind = static_cast<Expr::Kind>(read<int32_t>());
+    switch (kind) {
+    case Expr::Constant: {
+      unsigned width = read<unsigned>();
+      std::vector<char> words = readBytes();
+      if (!good() || width == 0 ||
+          words.size() != (width + 63) / 64 * sizeof(uint64_t))
+        return false;
+      e = ConstantExpr::alloc(
+          APInt(width, ArrayRef<uint64_t>(
+                           reinterpret_cast<const uint64_t *>(words.data()),
+                           words.size() / sizeof(uint64_t))));
+      break;
+    }
+    case Expr::NotOptimized: {
+      ref<Expr> src = readId();
+      if (!good())
+        return false;
+      e = NotOptimizedExpr::alloc(src);
+      break;
+    }
+    case Expr::Read: {
+      UpdateList updates = readNodes();
+      ref<Expr> index = readId();
+      if (!good())
+        return false;
+      e = ReadExpr::alloc(updates, index);
+      break;
+    }
+    case Expr::Select: {
+      ref<Expr> c = readId();
+      ref<Expr> t = readId();
+      ref<Expr> f = readId();
+      if (!good())
+        return false;
+      e = SelectExpr::alloc(c, t, f);
+      break;
+    }
+    case Expr::Extract: {
+      unsigned offset = read<unsigned>();
+      Expr::Width width = read<Expr::Width>();
+      ref<Expr> src = readId();
+      if (!good())
+        return false;
+      e = ExtractExpr::alloc(src, offset, width);
+      break;
+    }
+    case Expr::ZExt: {
+      Expr::Width width = read<Expr::Width>();
+      ref<Expr> src = readId();
+      if (!good())
+        return false;
+      e = ZExtExpr::alloc(src, width);
+      break;
+    }
+    case Expr::SExt: {
+      Expr::Width width = read<Expr::Width>();
+      ref<Expr> src = readId();
+      if (!good())
+        return false;
+      e = SExtExpr::alloc(src, width);
+      break;
+    }
+    case Expr::Not: {
+      ref<Expr> src = readId();
+      if (!good())
+        return false;
+      e = NotExpr::alloc(src);
+      break;
+    }
+
+#define BINARY_EXPR_CASE(T)                                                    \
+  case Expr::T: {                                                              \
+    ref<Expr> l = readId();                                                    \
+    ref<Expr> r = readId();                                                    \
+    if (!good())                                                               \
+      return false;                                                            \
+    e = T##Expr::alloc(l, r);                                                  \
+    break;                                                                     \
+  }
+      BINARY_EXPR_CASE(Concat)
+      BINARY_EXPR_CASE(Add)
+      BINARY_EXPR_CASE(Sub)
+      BINARY_EXPR_CASE(Mul)
+      BINARY_EXPR_CASE(UDiv)
+      BINARY_EXPR_CASE(SDiv)
+      BINARY_EXPR_CASE(URem)
+      BINARY_EXPR_CASE(SRem)
+      BINARY_EXPR_CASE(And)
+      BINARY_EXPR_CASE(Or)
+      BINARY_EXPR_CASE(Xor)
+      BINARY_EXPR_CASE(Shl)
+      BINARY_EXPR_CASE(LShr)
+      BINARY_EXPR_CASE(AShr)
+      BINARY_EXPR_CASE(Eq)
+      BINARY_EXPR_CASE(Ne)
+      BINARY_EXPR_CASE(Ult)
+      BINARY_EXPR_CASE(Ule)
+      BINARY_EXPR_CASE(Ugt)
+      BINARY_EXPR_CASE(Uge)
+      BINARY_EXPR_CASE(Slt)
+      BINARY_EXPR_CASE(Sle)
+      BINARY_EXPR_CASE(Sgt)
+      BINARY_EXPR_CASE(Sge)
+#undef BINARY_EXPR_CASE
+
+    default:
+      return false;
+    }
+    exprs.push_back(e);
+    return true;
+  }
+
+  /// Reads expression definitions and returns the tag that follows them.
+  SpillWriter::Tag readDefinitions() {
+    for (;;) {
+      auto tag = read<SpillWriter::Tag>();
+      if (tag != SpillWriter::New || !good())
+        return tag;
+      if (!readDefinition()) {
+        failed = true;
+        return tag;
+      }
+    }
+  }
+
+public:
+  explicit SpillReader(const std::string &path)
+      : in(path, std::ios::binary | std::ios::ate) {
+    if (in.good()) {
+      size = in.tellg();
+      in.seekg(0);
+    }
+  }
+
+  bool good() const { return !failed && in.good(); }
+
+  template <typename T> T read() {
+    T value{};
+    in.read(reinterpret_cast<char *>(&value), sizeof(T));
+    return value;
+  }
+
+  template <typename T> T *readPointer() {
+    return reinterpret_cast<T *>(read<uint64_t>());
+  }
+
+  std::vector<char> readBytes() {
+    uint64_t length = read<uint64_t>();
+    if (!good() || length > size - static_cast<uint64_t>(in.tellg())) {
+      failed = true;
+      return {};
+    }
+    std::vector<char> data(length);
+    in.read(data.data(), length);
+    return data;
+  }
+
+  std::string readString() {
+    std::vector<char> data = readBytes();
+    return std::string(data.begin(), data.end());
+  }
+
+  PagedBitArray readBits() {
+    unsigned bits = read<unsigned>();
+    std::vector<char> packed = readBytes();
+    if (packed.size() != (static_cast<uint64_t>(bits) + 7) / 8) {
+      failed = true;
+      return PagedBitArray(0);
+    }
+    PagedBitArray result(bits);
+    for (unsigned i = 0; i < bits; ++i)
+      if (packed[i / 8] & (1 << (i % 8)))
+        result.set(i);
+    return result;
+  }
+
+  ref<Expr> readExpr() {
+    switch (readDefinitions()) {
+    case SpillWriter::Null:
+      return nullptr;
+    case SpillWriter::Known:
+      return readId();
+    default:
+      failed = true;
+      return nullptr;
+    }
+  }
+
+  UpdateList readUpdates() {
+    if (readDefinitions() != SpillWriter::End)
+      failed = true;
+    if (!good())
+      return UpdateList(nullptr, nullptr);
+    return readNodes();
+  }
+
+  KValue readKValue() {
+    ref<Expr> segment = readExpr();
+    return KValue(segment, readExpr());
+  }
+};
+
+} // namespace klee
+
+StateSpiller::StateSpiller(std::string directory)
+    : directory(std::move(directory)) {}
+
+StateSpiller::~StateSpiller() {
+  for (const auto &entry : suspended)
+    std::remove(entry.second.path.c_str());
+}
+
+void StateSpiller::writePlane(SpillWriter &writer,
+                              const ObjectStatePlane &plane) {
+  writer.write(plane.sizeBound);
+  writer.write(plane.initialized);
+  writer.write(plane.symbolic);
+  writer.write(plane.initialValue);
+
+  std::vector<uint8_t> store(plane.concreteStore.size());
+  plane.concreteStore.copyTo(store.data());
+  writer.writeBytes(store.data(), store.size());
+  writer.writeBits(plane.concreteMask);
+  writer.writeBits(plane.unflushedMask);
+
+  std::vector<std::pair<uint64_t, ref<Expr>>> symbolics;
+  plane.knownSymbolics.forEach([&](size_t index, const ref<Expr> &e) {
+    symbolics.emplace_back(index, e);
+  });
+  writer.write(static_cast<uint64_t>(symbolics.size()));
+  for (const auto &symbolic : symbolics) {
+    writer.write(symbolic.first);
+    writer.writeExpr(symbolic.second);
+  }
+
+  writer.writeUpdates(plane.updates);
+}
+
+void StateSpiller::readPlane(SpillReader &reader, ObjectStatePlane &plane) {
+  plane.sizeBound = reader.read<unsigned>();
+  plane.initialized = reader.read<bool>();
+  plane.symbolic = reader.read<bool>();
+  plane.initialValue = reader.read<uint8_t>();
+
+  std::vector<char> store = reader.readBytes();
+  plane.concreteStore = PagedVector<uint8_t>(store.size());
+  plane.concreteStore.assign(reinterpret_cast<uint8_t *>(store.data()));
+  plane.concreteMask = reader.readBits();
+  plane.unflushedMask = reader.readBits();
+
+  plane.knownSymbolics.clear();
+  for (uint64_t i = 0, count = reader.read<uint64_t>();
+       i < count && reader.good(); ++i) {
+    uint64_t index = reader.read<uint64_t>();
+    ref<Expr> e = reader.readExpr();
+    if (reader.good())
+      plane.knownSymbolics.set(index, e);
+  }
+
+  plane.updates = reader.readUpdates();
+}
+
+void StateSpiller::writeObjectState(SpillWriter &writer,
+                                    const ObjectState &os) {
+  writer.write(os.readOnly);
+  writer.write(os.segmentPlane != nullptr);
+  if (os.segmentPlane)
+    writePlane(writer, *os.segmentPlane);
+  writePlane(writer, *os.offsetPlane);
+}
+
+ObjectState *StateSpiller::readObjectState(SpillReader &reader,
+                                            const MemoryObject *mo) {
+  ObjectState *os = new ObjectState(mo);
+  os->readOnly = reader.read<bool>();
+  if (reader.read<bool>()) {
+    os->segmentPlane = new ObjectStatePlane(os);
+    readPlane(reader, *os->segmentPlane);
+  }
+  readPlane(reader, *os->offsetPlane);
+  if (!reader.good()) {
+    delete os;
+    return nullptr;
+  }
+  return os;
+}
+
+bool StateSpiller::suspend(ExecutionState &state) {
+  assert(!isSuspended(state) && "state is already suspended");
+
+  if (std::error_code ec = sys::fs::create_directories(directory)) {
+    klee_warning("unable to create directory for suspended states %s: %s",
+                 directory.c_str(), ec.message().c_str());
+    return false;
+  }
+
+  SuspendedState entry;
+  entry.path = directory + "/state" + std::to_string(state.getID()) + ".spill";
+  SpillWriter writer(entry.path);
+
+  writer.write(static_cast<uint64_t>(state.constraints.size()));
+  for (const auto &constraint : state.constraints)
+    writer.writeExpr(constraint);
+
+  // Objects shared with other states stay in memory anyway, so only the
+  // objects owned by this state are written.
+  const AddressSpace &as = state.addressSpace;
+  for (auto it = as.objects.begin(), ie = as.objects.end(); it != ie; ++it)
+    if (it->second->copyOnWriteOwner == as.cowKey)
+      entry.objects.push_back(it->first);
+  writer.write(static_cast<uint64_t>(entry.objects.size()));
+  for (const auto &mo : entry.objects) {
+    writer.writePointer(mo.get());
+    writeObjectState(writer, *as.findObject(mo.get()));
+  }
+
+  for (const StackFrame &sf : state.stack)
+    for (unsigned i = 0; i < sf.kf->numRegisters; ++i)
+      writer.writeKValue(sf.locals[i]);
+
+  writer.write(static_cast<uint64_t>(state.nondetValues.size()));
+  for (const auto &nv : state.nondetValues) {
+    writer.writeKValue(nv.value);
+    writer.write(nv.isSigned);
+    writer.writePointer(nv.kinstruction);
+    writer.writeString(nv.name);
+  }
+
+  writer.close();
+  if (!writer.good()) {
+    klee_warning("unable to write suspended state to %s", entry.path.c_str());
+    std::remove(entry.path.c_str());
+    return false;
+  }
+
+  // drop the written contents
+  state.constraints = ConstraintSet();
+  AddressSpace &space = state.addressSpace;
+  for (const auto &mo : entry.objects) {
+    space.objects = space.objects.remove(mo.get());
+    if (mo->segment != 0)
+      space.segmentMap = space.segmentMap.remove(mo->segment);
+  }
+  space.ownedBytes = 0;
+  for (StackFrame &sf : state.stack) {
+    delete[] sf.locals;
+    sf.locals = nullptr;
+  }
+  state.nondetValues.clear();
+
+  suspended.emplace(&state, std::move(entry));
+  return true;
+}
+
+bool StateSpiller::load(const SuspendedState &entry, ExecutionState &state) {
+  SpillReader reader(entry.path);
+  if (!reader.good())
+    return false;
+
+  ConstraintSet::constraints_ty constraints;
+  for (uint64_t i = 0, count = reader.read<uint64_t>();
+       i < count && reader.good(); ++i)
+    constraints.push_back(reader.readExpr());
+  if (!reader.good())
+    return false;
+  state.constraints = ConstraintSet(std::move(constraints));
+
+  uint64_t numObjects = reader.read<uint64_t>();
+  if (numObjects != entry.objects.size())
+    return false;
+  for (const auto &mo : entry.objects) {
+    if (reader.readPointer<const MemoryObject>() != mo.get())
+      return false;
+    ObjectState *os = readObjectState(reader, mo.get());
+    if (!os)
+      return false;
+    state.addressSpace.bindObject(mo.get(), os);
+  }
+
+  for (StackFrame &sf : state.stack)
+    for (unsigned i = 0; i < sf.kf->numRegisters && reader.good(); ++i)
+      sf.locals[i] = reader.readKValue();
+
+  for (uint64_t i = 0, count = reader.read<uint64_t>();
+       i < count && reader.good(); ++i) {
+    KValue value = reader.readKValue();
+    bool isSigned = reader.read<bool>();
+    KInstruction *ki = reader.readPointer<KInstruction>();
+    state.nondetValues.emplace_back(value, isSigned, ki, reader.readString());
+  }
+
+  return reader.good();
+}
+
+bool StateSpiller::resume(ExecutionState &state) {
+  auto it = suspended.find(&state);
+  if (it == suspended.end())
+    return true;
+  SuspendedState entry = std::move(it->second);
+  suspended.erase(it);
+
+  for (StackFrame &sf : state.stack)
+    sf.locals = new Cell[sf.kf->numRegisters];
+
+  bool loaded = load(entry, state);
+  if (!loaded)
+    klee_warning("unable to read suspended state from %s", entry.path.c_str());
+  std::remove(entry.path.c_str());
+  return loaded;
+}
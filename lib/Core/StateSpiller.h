@@ -0,0 +1,83 @@
+//===-- StateSpiller.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATESPILLER_H
+#define KLEE_STATESPILLER_H
+
+#include "klee/ADT/Ref.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+class ExecutionState;
+class MemoryObject;
+class ObjectState;
+class ObjectStatePlane;
+class SpillReader;
+class SpillWriter;
+
+/// Moves the contents of execution states to disk and back.
+///
+/// A suspended state stays in the executor, the searcher and the process
+/// tree, only the objects its address space owns, its constraints, stack
+/// frame values and nondet values are written to a file and dropped from
+/// memory. Objects shared copy-on-write with other states stay bound. Such
+/// a state must be resumed before it is executed or terminated.
+///
+/// The files refer to arrays, memory objects and instructions by their
+/// address, so they are only valid within the process that wrote them.
+class StateSpiller {
+  struct SuspendedState {
+    std::string path;
+    /// Memory objects whose contents were written, kept alive so that the
+    /// addresses in the file stay valid
+    std::vector<ref<const MemoryObject>> objects;
+  };
+
+  std::string directory;
+  std::unordered_map<const ExecutionState *, SuspendedState> suspended;
+
+  static void writePlane(SpillWriter &writer, const ObjectStatePlane &plane);
+  static void readPlane(SpillReader &reader, ObjectStatePlane &plane);
+  static void writeObjectState(SpillWriter &writer, const ObjectState &os);
+  /// \return null if the object could not be read
+  static ObjectState *readObjectState(SpillReader &reader,
+                                      const MemoryObject *mo);
+  static bool load(const SuspendedState &entry, ExecutionState &state);
+
+public:
+  /// Suspended states are stored in files in the given directory, which is
+  /// created when the first state is suspended.
+  explicit StateSpiller(std::string directory);
+  ~StateSpiller();
+
+  bool isSuspended(const ExecutionState &state) const {
+    return suspended.count(&state) != 0;
+  }
+
+  std::size_t getNumSuspended() const { return suspended.size(); }
+
+  /// Write the contents of state to disk and drop them from memory.
+  /// \return false if the state could not be written, it is left
+  /// untouched then
+  bool suspend(ExecutionState &state);
+
+  /// Load the contents of a suspended state back, does nothing for states
+  /// that are not suspended.
+  /// \return false if the contents could not be read, the state is no
+  /// longer suspended then, but its contents are lost and it has to be
+  /// terminated
+  bool resume(ExecutionState &state);
+};
+
+} // namespace klee
+
+#endif /* KLEE_STATESPILLER_H */
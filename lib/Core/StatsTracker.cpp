@@ -379,6 +379,38 @@ void StatsTracker::stepInstruction(ExecutionState &es) {
     writeIStats();
 }
 
+void StatsTracker::coverBlocks(ExecutionState &es,
+                               const std::vector<const BasicBlock *> &blocks) {
+  if (!OutputIStats)
+    return;
+
+  const unsigned index = theStatisticManager->getIndex();
+  for (const BasicBlock *bb : blocks) {
+    auto it = executor.kmodule->functionMap.find(
+        const_cast<Function *>(bb->getParent()));
+    if (it == executor.kmodule->functionMap.end() || !it->second->trackCoverage)
+      continue;
+    const KFunction *kf = it->second;
+    const unsigned first =
+        kf->basicBlockEntry.at(const_cast<BasicBlock *>(bb));
+    for (unsigned i = first, e = first + bb->size(); i < e; ++i) {
+      const KInstruction *ki = kf->instructions[i];
+      const InstructionInfo &ii = *ki->info;
+      if (!instructionIsCoverable(ki->inst) ||
+          theStatisticManager->getIndexedValue(stats::coveredInstructions,
+                                               ii.id))
+        continue;
+      theStatisticManager->setIndex(ii.id);
+      es.coveredLines[&ii.file].insert(ii.line);
+      es.coveredNew = true;
+      es.instsSinceCovNew = 1;
+      ++stats::coveredInstructions;
+      stats::uncoveredInstructions += (uint64_t)-1;
+    }
+  }
+  theStatisticManager->setIndex(index);
+}
+
 ///
 
 /* Should be called _after_ the es->pushFrame() */
@@ -459,7 +491,17 @@ void StatsTracker::writeStatsHeader() {
              << "ResolveTime INTEGER,"
              << "QueryCexCacheMisses INTEGER,"
              << "QueryCexCacheHits INTEGER,"
-             << "ArrayHashTime INTEGER"
+             << "ArrayHashTime INTEGER,"
+             << "MemoryOperations INTEGER,"
+             << "ConcreteMemoryOperations INTEGER,"
+             << "QueryPortfolioRaces INTEGER,"
+             << "QueryPortfolioWinsSTP INTEGER,"
+             << "QueryPortfolioWinsZ3 INTEGER,"
+             << "QueryPortfolioWinsMetaSMT INTEGER,"
+             << "QueryPersistentCacheHits INTEGER,"
+             << "QueryPersistentCacheMisses INTEGER,"
+             << "CexCacheLookupTime INTEGER,"
+             << "QueryModelHits INTEGER"
          << ')';
   char *zErrMsg = nullptr;
   if(sqlite3_exec(statsFile, create.str().c_str(), nullptr, nullptr, &zErrMsg)) {
@@ -492,7 +534,17 @@ void StatsTracker::writeStatsHeader() {
              << "ResolveTime,"
              << "QueryCexCacheMisses,"
              << "QueryCexCacheHits,"
-             << "ArrayHashTime"
+             << "ArrayHashTime,"
+             << "MemoryOperations,"
+             << "ConcreteMemoryOperations,"
+             << "QueryPortfolioRaces,"
+             << "QueryPortfolioWinsSTP,"
+             << "QueryPortfolioWinsZ3,"
+             << "QueryPortfolioWinsMetaSMT,"
+             << "QueryPersistentCacheHits,"
+             << "QueryPersistentCacheMisses,"
+             << "CexCacheLookupTime,"
+             << "QueryModelHits"
          << ") VALUES ("
              << "?,"
              << "?,"
@@ -513,6 +565,16 @@ void StatsTracker::writeStatsHeader() {
              << "?,"
              << "?,"
              << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
+             << "?,"
              << "? "
          << ')';
 
@@ -550,6 +612,16 @@ void StatsTracker::writeStatsLine() {
 #else
   sqlite3_bind_int64(insertStmt, 20, -1LL);
 #endif
+  sqlite3_bind_int64(insertStmt, 21, stats::memoryOperations);
+  sqlite3_bind_int64(insertStmt, 22, stats::concreteMemoryOperations);
+  sqlite3_bind_int64(insertStmt, 23, stats::queryPortfolioRaces);
+  sqlite3_bind_int64(insertStmt, 24, stats::queryPortfolioWinsSTP);
+  sqlite3_bind_int64(insertStmt, 25, stats::queryPortfolioWinsZ3);
+  sqlite3_bind_int64(insertStmt, 26, stats::queryPortfolioWinsMetaSMT);
+  sqlite3_bind_int64(insertStmt, 27, stats::queryPersistentCacheHits);
+  sqlite3_bind_int64(insertStmt, 28, stats::queryPersistentCacheMisses);
+  sqlite3_bind_int64(insertStmt, 29, stats::cexCacheLookupTime);
+  sqlite3_bind_int64(insertStmt, 30, stats::queryModelHits);
   int errCode = sqlite3_step(insertStmt);
   if(errCode != SQLITE_DONE) klee_error("Error writing stats data: %s", sqlite3_errmsg(statsFile));
   sqlite3_reset(insertStmt);
@@ -612,6 +684,9 @@ void StatsTracker::writeIStats() {
   istatsMask.set(sm.getStatisticID("UncoveredInstructions"));
   istatsMask.set(sm.getStatisticID("States"));
   istatsMask.set(sm.getStatisticID("MinDistToUncovered"));
+  // needed to merge the branch coverage of parallel workers
+  istatsMask.set(sm.getStatisticID("TrueBranches"));
+  istatsMask.set(sm.getStatisticID("FalseBranches"));
 
   of << "positions: instr line\n";
 
@@ -16,8 +16,10 @@
 #include <memory>
 #include <set>
 #include <sqlite3.h>
+#include <vector>
 
 namespace llvm {
+  class BasicBlock;
   class BranchInst;
   class Function;
   class Instruction;
@@ -94,6 +96,11 @@ namespace klee {
     // about to be stepped
     void stepInstruction(ExecutionState &es);
 
+    // mark the instructions of basic blocks that es ran natively as
+    // covered, as they are never stepped
+    void coverBlocks(ExecutionState &es,
+                     const std::vector<const llvm::BasicBlock *> &blocks);
+
     /// Return duration since execution start.
     time::Span elapsed();
 
@@ -10,6 +10,7 @@
 #include "TimingSolver.h"
 
 #include "ExecutionState.h"
+#include "QueryProfiler.h"
 
 #include "klee/Config/Version.h"
 #include "klee/Expr/Assignment.h"
@@ -17,16 +18,55 @@
 #include "klee/Statistics/Statistics.h"
 #include "klee/Statistics/TimerStatIncrementer.h"
 #include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverStats.h"
 
 #include "CoreStats.h"
 #include "klee/Expr/Assignment.h"
 #include "klee/Expr/ExprUtil.h"
 
+#include <algorithm>
+
 using namespace klee;
 using namespace llvm;
 
 /***/
 
+const Assignment *TimingSolver::getModel(const ConstraintSet &constraints,
+                                         SolverQueryMetaData &metaData) {
+  SolverQueryMetaData::Model &model = metaData.lastModel;
+  if (!useStateModel || !model.assignment)
+    return nullptr;
+
+  // Constraints are only ever appended, unless the constraint manager
+  // rewrites them, which replaces the last checked one.
+  std::size_t from = model.checked;
+  if (from > constraints.size() ||
+      (from && (constraints.begin() + (from - 1))->get() !=
+                   model.lastChecked.get()))
+    from = 0;
+  for (auto it = constraints.begin() + from, ie = constraints.end(); it != ie;
+       ++it) {
+    if (!model.assignment->evaluate(*it)->isTrue()) {
+      model = SolverQueryMetaData::Model();
+      return nullptr;
+    }
+  }
+  model.checked = constraints.size();
+  model.lastChecked =
+      constraints.empty() ? ref<Expr>() : *(constraints.end() - 1);
+  return model.assignment.get();
+}
+
+void TimingSolver::setModel(const ConstraintSet &constraints,
+                            SolverQueryMetaData &metaData,
+                            std::shared_ptr<const Assignment> assignment) {
+  SolverQueryMetaData::Model &model = metaData.lastModel;
+  model.assignment = std::move(assignment);
+  model.checked = constraints.size();
+  model.lastChecked =
+      constraints.empty() ? ref<Expr>() : *(constraints.end() - 1);
+}
+
 bool TimingSolver::evaluate(const ConstraintSet &constraints, ref<Expr> expr,
                             Solver::Validity &result,
                             SolverQueryMetaData &metaData) {
@@ -36,6 +76,23 @@ bool TimingSolver::evaluate(const ConstraintSet &constraints, ref<Expr> expr,
     return true;
   }
 
+  // The model of the state rules out either True or False, which leaves a
+  // single query. Without a model the validity query is cheaper than two
+  // queries for counterexamples.
+  if (const Assignment *model = getModel(constraints, metaData)) {
+    bool res;
+    if (model->evaluate(expr)->isTrue()) {
+      if (!mustBeTrue(constraints, expr, res, metaData))
+        return false;
+      result = res ? Solver::True : Solver::Unknown;
+    } else {
+      if (!mustBeFalse(constraints, expr, res, metaData))
+        return false;
+      result = res ? Solver::False : Solver::Unknown;
+    }
+    return true;
+  }
+
   TimerStatIncrementer timer(stats::solverTime);
 
   if (simplifyExprs)
@@ -44,6 +101,9 @@ bool TimingSolver::evaluate(const ConstraintSet &constraints, ref<Expr> expr,
   bool success = solver->evaluate(Query(constraints, expr), result);
 
   metaData.queryCost += timer.delta();
+  if (profiler)
+    profiler->record(QueryProfiler::Validity, constraints, expr,
+                     timer.delta(), success);
 
   return success;
 }
@@ -56,14 +116,40 @@ bool TimingSolver::mustBeTrue(const ConstraintSet &constraints, ref<Expr> expr,
     return true;
   }
 
+  // A model in which expr is false is a counterexample.
+  if (const Assignment *model = getModel(constraints, metaData)) {
+    if (model->evaluate(expr)->isFalse()) {
+      ++stats::queryModelHits;
+      result = false;
+      return true;
+    }
+  }
+
   TimerStatIncrementer timer(stats::solverTime);
 
   if (simplifyExprs)
     expr = ConstraintManager::simplifyExpr(constraints, expr);
 
-  bool success = solver->mustBeTrue(Query(constraints, expr), result);
+  bool success;
+  if (useStateModel && !isa<ConstantExpr>(expr)) {
+    // ask for the counterexample to keep the model of the state up to date
+    std::shared_ptr<const Assignment> assignment;
+    bool hasSolution;
+    success = solver->getInitialValues(Query(constraints, expr), assignment,
+                                       hasSolution);
+    if (success) {
+      result = !hasSolution;
+      if (hasSolution)
+        setModel(constraints, metaData, std::move(assignment));
+    }
+  } else {
+    success = solver->mustBeTrue(Query(constraints, expr), result);
+  }
 
   metaData.queryCost += timer.delta();
+  if (profiler)
+    profiler->record(QueryProfiler::Truth, constraints, expr, timer.delta(),
+                     success);
 
   return success;
 }
@@ -91,6 +177,57 @@ bool TimingSolver::mayBeFalse(const ConstraintSet &constraints, ref<Expr> expr,
   return true;
 }
 
+bool TimingSolver::mayBeTrue(const ConstraintSet &constraints,
+                             std::vector<ref<Expr>> exprs,
+                             std::vector<bool> &results,
+                             SolverQueryMetaData &metaData) {
+  // Fast path, to avoid timer and OS overhead.
+  if (std::all_of(exprs.begin(), exprs.end(),
+                  [](const ref<Expr> &e) { return isa<ConstantExpr>(e); })) {
+    results.clear();
+    for (const auto &e : exprs)
+      results.push_back(cast<ConstantExpr>(e)->isTrue());
+    return true;
+  }
+
+  // the expressions true in the model of the state need no query
+  std::vector<unsigned> pending;
+  const Assignment *model = getModel(constraints, metaData);
+  for (unsigned i = 0; i != exprs.size(); ++i) {
+    if (model && model->evaluate(exprs[i])->isTrue())
+      ++stats::queryModelHits;
+    else
+      pending.push_back(i);
+  }
+  if (pending.size() != exprs.size()) {
+    std::vector<ref<Expr>> rest;
+    for (unsigned i : pending)
+      rest.push_back(exprs[i]);
+    std::vector<bool> restResults;
+    if (!mayBeTrue(constraints, rest, restResults, metaData))
+      return false;
+    results.assign(exprs.size(), true);
+    for (unsigned i = 0; i != pending.size(); ++i)
+      results[pending[i]] = restResults[i];
+    return true;
+  }
+
+  TimerStatIncrementer timer(stats::solverTime);
+
+  if (simplifyExprs)
+    for (auto &e : exprs)
+      e = ConstraintManager::simplifyExpr(constraints, e);
+
+  bool success = solver->mayBeTrue(constraints, exprs, results);
+
+  metaData.queryCost += timer.delta();
+  if (profiler)
+    profiler->record(QueryProfiler::MultiTruth, constraints, exprs,
+                     timer.delta(), success);
+
+  return success;
+}
+
 bool TimingSolver::getValue(const ConstraintSet &constraints, ref<Expr> expr,
                             ref<ConstantExpr> &result,
                             SolverQueryMetaData &metaData) {
@@ -99,15 +236,25 @@ bool TimingSolver::getValue(const ConstraintSet &constraints, ref<Expr> expr,
     result = CE;
     return true;
   }
-  
+
+  if (const Assignment *model = getModel(constraints, metaData)) {
+    ++stats::queryModelHits;
+    result = cast<ConstantExpr>(model->evaluate(expr));
+    return true;
+  }
+
   TimerStatIncrementer timer(stats::solverTime);
 
   if (simplifyExprs)
     expr = ConstraintManager::simplifyExpr(constraints, expr);
 
+  // a model of all constraints would need every independent factor solved
   bool success = solver->getValue(Query(constraints, expr), result);
 
   metaData.queryCost += timer.delta();
+  if (profiler)
+    profiler->record(QueryProfiler::Value, constraints, expr, timer.delta(),
+                     success);
 
   return success;
 }
@@ -127,6 +274,13 @@ bool TimingSolver::getValue(const ConstraintSet& constraints, KValue value,
     return getValue(constraints, segment, segmentResult, metaData);
   }
 
+  if (const Assignment *model = getModel(constraints, metaData)) {
+    ++stats::queryModelHits;
+    segmentResult = cast<ConstantExpr>(model->evaluate(segment));
+    offsetResult = cast<ConstantExpr>(model->evaluate(offset));
+    return true;
+  }
+
   TimerStatIncrementer timer(stats::solverTime);
 
   if (simplifyExprs) {
@@ -140,9 +294,14 @@ bool TimingSolver::getValue(const ConstraintSet& constraints, KValue value,
   if (success) {
     segmentResult = cast<ConstantExpr>(assignment->evaluate(segment));
     offsetResult = cast<ConstantExpr>(assignment->evaluate(offset));
+    if (useStateModel)
+      setModel(constraints, metaData, std::move(assignment));
   }
 
   metaData.queryCost += timer.delta() / 1e6;
+  if (profiler)
+    profiler->record(QueryProfiler::Value, constraints, {segment, offset},
+                     timer.delta(), success);
 
   return success;
 }
@@ -158,6 +317,9 @@ bool TimingSolver::getInitialValues(
                                           result);
 
   metaData.queryCost += timer.delta();
+  if (profiler)
+    profiler->record(QueryProfiler::InitialValues, constraints, ref<Expr>(),
+                     timer.delta(), success);
   return success;
 }
 
@@ -167,5 +329,8 @@ TimingSolver::getRange(const ConstraintSet &constraints, ref<Expr> expr,
   TimerStatIncrementer timer(stats::solverTime);
   auto result = solver->getRange(Query(constraints, expr));
   metaData.queryCost += timer.delta();
+  if (profiler)
+    profiler->record(QueryProfiler::Range, constraints, expr, timer.delta(),
+                     true);
   return result;
 }
@@ -22,6 +22,7 @@
 
 namespace klee {
 class ConstraintSet;
+class QueryProfiler;
 class Solver;
 
 /// TimingSolver - A simple class which wraps a solver and handles
@@ -30,6 +31,20 @@ class TimingSolver {
 public:
   std::unique_ptr<Solver> solver;
   bool simplifyExprs;
+  bool useStateModel;
+  /// Records the queries sent to the solver, null unless profiling
+  QueryProfiler *profiler = nullptr;
+
+private:
+  /// Returns the last model of the query meta data if it satisfies the
+  /// constraints, and drops it otherwise. Only the constraints added since
+  /// the last check are evaluated.
+  const Assignment *getModel(const ConstraintSet &constraints,
+                             SolverQueryMetaData &metaData);
+
+  void setModel(const ConstraintSet &constraints,
+                SolverQueryMetaData &metaData,
+                std::shared_ptr<const Assignment> model);
 
 public:
   /// TimingSolver - Construct a new timing solver.
@@ -37,8 +52,13 @@ public:
   /// \param _simplifyExprs - Whether expressions should be
   /// simplified (via the constraint manager interface) prior to
   /// querying.
-  TimingSolver(Solver *_solver, bool _simplifyExprs = true)
-      : solver(_solver), simplifyExprs(_simplifyExprs) {}
+  /// \param _useStateModel - Whether queries should first be evaluated
+  /// under the last model found for the state, and truth queries ask the
+  /// solver for counterexamples so that it stays up to date.
+  TimingSolver(Solver *_solver, bool _simplifyExprs = true,
+               bool _useStateModel = false)
+      : solver(_solver), simplifyExprs(_simplifyExprs),
+        useStateModel(_useStateModel) {}
 
   void setTimeout(time::Span t) { solver->setCoreSolverTimeout(t); }
 
@@ -61,6 +81,11 @@ public:
   bool mayBeFalse(const ConstraintSet &, ref<Expr>, bool &result,
                   SolverQueryMetaData &metaData);
 
+  /// Determine for each expression whether it may be true, see
+  /// Solver::mayBeTrue.
+  bool mayBeTrue(const ConstraintSet &, std::vector<ref<Expr>> exprs,
+                 std::vector<bool> &results, SolverQueryMetaData &metaData);
+
   bool getValue(const ConstraintSet &, ref<Expr> expr,
                 ref<ConstantExpr> &result, SolverQueryMetaData &metaData);
 
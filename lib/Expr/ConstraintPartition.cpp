@@ -0,0 +1,180 @@
+//===-- ConstraintPartition.cpp -------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ConstraintPartition.h"
+
+#include "klee/Expr/ExprUtil.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+void ConstraintPartition::getAccesses(const ref<Expr> &e,
+                                      std::vector<Access> &accesses) {
+  std::vector<ref<ReadExpr>> reads;
+  findReads(e, /* visitUpdates= */ true, reads);
+  for (const auto &re : reads) {
+    // Reads of a constant array don't alias.
+    if (re->updates.root->isConstantArray() && !re->updates.head)
+      continue;
+    if (auto CE = dyn_cast<ConstantExpr>(re->index))
+      accesses.push_back(
+          {re->updates.root, (unsigned)CE->getZExtValue(32), false});
+    else
+      accesses.push_back({re->updates.root, 0, true});
+  }
+}
+
+unsigned ConstraintPartition::find(unsigned node) const {
+  while (const auto *parent = parents.lookup(node))
+    node = parent->second;
+  return node;
+}
+
+unsigned ConstraintPartition::join(unsigned a, unsigned b) {
+  a = find(a);
+  b = find(b);
+  if (a == b)
+    return a;
+  Root ra = roots.lookup(a)->second;
+  Root rb = roots.lookup(b)->second;
+  // attach the smaller tree so that paths to the roots stay short
+  if (ra.numNodes < rb.numNodes) {
+    std::swap(a, b);
+    std::swap(ra, rb);
+  }
+  // and move the indices of the smaller group to the larger one
+  unsigned from = rb.group;
+  if (ra.numConstraints < rb.numConstraints)
+    std::swap(from, ra.group);
+  group_ty moved;
+  for (auto it = attached.lower_bound(std::make_pair(from, 0u)),
+            ie = attached.end();
+       it != ie && it->first == from; ++it)
+    moved.push_back(it->second);
+  for (unsigned index : moved)
+    attached = attached.remove(std::make_pair(from, index))
+                   .insert(std::make_pair(ra.group, index));
+  ra.numNodes += rb.numNodes;
+  ra.numConstraints += rb.numConstraints;
+
+  parents = parents.insert(std::make_pair(b, a));
+  roots = roots.remove(b).replace(std::make_pair(a, ra));
+  return a;
+}
+
+unsigned ConstraintPartition::newNode() {
+  unsigned node = numNodes++;
+  Root root;
+  root.group = node;
+  roots = roots.insert(std::make_pair(node, root));
+  return node;
+}
+
+unsigned ConstraintPartition::getNode(const Access &access) {
+  if (const auto *whole = wholeNodes.lookup(access.array))
+    return whole->second;
+  if (access.whole) {
+    unsigned node = newNode();
+    for (auto it = byteNodes.lower_bound(std::make_pair(access.array, 0u)),
+              ie = byteNodes.end();
+         it != ie && it->first.first == access.array; ++it)
+      node = join(node, it->second);
+    wholeNodes = wholeNodes.insert(std::make_pair(access.array, node));
+    return node;
+  }
+  auto key = std::make_pair(access.array, access.index);
+  if (const auto *byte = byteNodes.lookup(key))
+    return byte->second;
+  unsigned node = newNode();
+  byteNodes = byteNodes.insert(std::make_pair(key, node));
+  return node;
+}
+
+void ConstraintPartition::getRoots(const ref<Expr> &e,
+                                   std::vector<unsigned> &result) const {
+  std::vector<Access> accesses;
+  getAccesses(e, accesses);
+  for (const Access &access : accesses) {
+    if (const auto *whole = wholeNodes.lookup(access.array)) {
+      result.push_back(find(whole->second));
+    } else if (access.whole) {
+      for (auto it = byteNodes.lower_bound(std::make_pair(access.array, 0u)),
+                ie = byteNodes.end();
+           it != ie && it->first.first == access.array; ++it)
+        result.push_back(find(it->second));
+    } else if (const auto *byte = byteNodes.lookup(
+                   std::make_pair(access.array, access.index))) {
+      result.push_back(find(byte->second));
+    }
+  }
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+void ConstraintPartition::appendConstraints(unsigned root,
+                                            group_ty &result) const {
+  unsigned group = roots.lookup(root)->second.group;
+  for (auto it = attached.lower_bound(std::make_pair(group, 0u)),
+            ie = attached.end();
+       it != ie && it->first == group; ++it)
+    result.push_back(it->second);
+}
+
+void ConstraintPartition::add(const ref<Expr> &constraint) {
+  unsigned index = numConstraints++;
+  std::vector<Access> accesses;
+  getAccesses(constraint, accesses);
+  if (accesses.empty()) {
+    unattached = unattached.insert(index);
+    return;
+  }
+
+  unsigned root = find(getNode(accesses.front()));
+  for (const Access &access : accesses)
+    root = join(root, getNode(access));
+  Root r = roots.lookup(root)->second;
+  attached = attached.insert(std::make_pair(r.group, index));
+  ++r.numConstraints;
+  roots = roots.replace(std::make_pair(root, r));
+}
+
+void ConstraintPartition::getRelevant(const ref<Expr> &expr,
+                                      group_ty &result) const {
+  std::vector<unsigned> exprRoots;
+  getRoots(expr, exprRoots);
+  for (unsigned root : exprRoots)
+    appendConstraints(root, result);
+  std::sort(result.begin(), result.end());
+}
+
+void ConstraintPartition::getFactors(const ref<Expr> &expr,
+                                     std::vector<group_ty> &result) const {
+  std::vector<unsigned> exprRoots;
+  getRoots(expr, exprRoots);
+  result.emplace_back();
+  for (unsigned root : exprRoots)
+    appendConstraints(root, result.front());
+  std::sort(result.front().begin(), result.front().end());
+
+  // the indices of a group are already in ascending order
+  for (const auto &root : roots) {
+    if (root.second.numConstraints == 0 ||
+        std::binary_search(exprRoots.begin(), exprRoots.end(), root.first))
+      continue;
+    result.emplace_back();
+    appendConstraints(root.first, result.back());
+  }
+  for (unsigned index : unattached)
+    result.push_back(group_ty(1, index));
+  std::sort(result.begin() + 1, result.end(),
+            [](const group_ty &a, const group_ty &b) {
+              return a.front() < b.front();
+            });
+}
@@ -75,6 +75,9 @@ bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
   bool changed = false;
 
   std::swap(constraints, old);
+  // keep maintaining the partition if it was in use
+  if (old.partition)
+    constraints.partition = std::make_shared<ConstraintPartition>();
   for (auto &ce : old) {
     ref<Expr> e = visitor.visit(ce);
 
@@ -86,6 +89,10 @@ bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
     }
   }
 
+  // the old set still has its partition, so there is nothing to rebuild
+  if (!changed)
+    std::swap(constraints, old);
+
   return changed;
 }
 
@@ -175,4 +182,41 @@ klee::ConstraintSet::constraint_iterator ConstraintSet::end() const {
 
 size_t ConstraintSet::size() const noexcept { return constraints.size(); }
 
-void ConstraintSet::push_back(const ref<Expr> &e) { constraints.push_back(e); }
+void ConstraintSet::push_back(const ref<Expr> &e) {
+  constraints.push_back(e);
+  if (partition) {
+    if (partition.use_count() > 1)
+      partition = std::make_shared<ConstraintPartition>(*partition);
+    partition->add(e);
+  }
+}
+
+const ConstraintPartition &ConstraintSet::getPartition() const {
+  if (!partition) {
+    partition = std::make_shared<ConstraintPartition>();
+    for (const auto &constraint : constraints)
+      partition->add(constraint);
+  }
+  assert(partition->size() == constraints.size() &&
+         "partition out of sync with constraints");
+  return *partition;
+}
+
+void ConstraintSet::getRelevantConstraints(const ref<Expr> &expr,
+                                           constraints_ty &result) const {
+  ConstraintPartition::group_ty indices;
+  getPartition().getRelevant(expr, indices);
+  for (unsigned index : indices)
+    result.push_back(constraints[index]);
+}
+
+void ConstraintSet::getIndependentFactors(
+    const ref<Expr> &expr, std::vector<constraints_ty> &result) const {
+  std::vector<ConstraintPartition::group_ty> factors;
+  getPartition().getFactors(expr, factors);
+  for (const auto &factor : factors) {
+    result.emplace_back();
+    for (unsigned index : factor)
+      result.back().push_back(constraints[index]);
+  }
+}
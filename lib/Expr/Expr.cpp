@@ -24,6 +24,7 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <sstream>
+#include <unordered_map>
 
 using namespace klee;
 using namespace llvm;
@@ -40,11 +41,68 @@ cl::opt<bool> ConstArrayOpt(
     cl::desc(
         "Enable an optimization involving all-constant arrays (default=false)"),
     cl::cat(klee::ExprCat));
+
+cl::opt<bool, true> InternExprs(
+    "intern-exprs", cl::location(Expr::internExprs),
+    cl::desc("Share a single node between structurally equal expressions, "
+             "so that they are compared by identity (default=false)"),
+    cl::cat(klee::ExprCat));
+
+/// The interned expressions by hash. Expressions remove themselves when
+/// they are destroyed, so the table is never destroyed itself: expressions
+/// may outlive static destructors.
+typedef std::unordered_multimap<unsigned, Expr *> InternTable;
+
+InternTable &getInternTable() {
+  static InternTable *table = new InternTable();
+  return *table;
+}
 }
 
 /***/
 
 unsigned Expr::count = 0;
+bool Expr::internExprs = false;
+
+ref<Expr> Expr::lookupOrInsert(const ref<Expr> &e) {
+  InternTable &table = getInternTable();
+  const Kind kind = e->getKind();
+  const unsigned numKids = e->getNumKids();
+  // A node built from kids that were created before interning was enabled
+  // is left out of the table: equal nodes with distinct kids would end up
+  // as distinct interned nodes, which ExprCmp tells apart by identity.
+  for (unsigned i = 0; i != numKids; ++i)
+    if (!e->getKid(i)->isInterned())
+      return e;
+
+  auto range = table.equal_range(e->hashValue);
+  for (auto it = range.first; it != range.second; ++it) {
+    const Expr &candidate = *it->second;
+    // the kids are interned, so they are compared by identity
+    if (candidate.getKind() != kind || candidate.getWidth() != e->getWidth() ||
+        candidate.compareContents(*e))
+      continue;
+    bool sameKids = true;
+    for (unsigned i = 0; sameKids && i != numKids; ++i)
+      sameKids = candidate.getKid(i).get() == e->getKid(i).get();
+    if (sameKids)
+      return it->second;
+  }
+  e->interned = true;
+  table.emplace(e->hashValue, e.get());
+  return e;
+}
+
+void Expr::removeInterned() {
+  InternTable &table = getInternTable();
+  auto range = table.equal_range(hashValue);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == this) {
+      table.erase(it);
+      return;
+    }
+  }
+}
 
 ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
   UpdateList ul(array, 0);
@@ -17,6 +17,7 @@ using namespace klee;
 
 KInstruction::~KInstruction() {
   delete[] operands;
+  delete[] successors;
 }
 
 std::string KInstruction::getSourceLocation() const {
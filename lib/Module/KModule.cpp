@@ -466,8 +466,24 @@ KFunction::KFunction(llvm::Function *_function,
       Instruction *inst = &*it;
       ki->inst = inst;
       ki->dest = registerMap[inst];
+      ki->opcode = inst->getOpcode();
+      ki->width = inst->getType()->isSized()
+                      ? km->targetData->getTypeSizeInBits(inst->getType())
+                      : 0;
       instructionsMap[inst] = ki;
 
+      if (inst->isTerminator() && inst->getNumSuccessors()) {
+        unsigned numSuccessors = inst->getNumSuccessors();
+        ki->successors = new KSuccessor[numSuccessors];
+        for (unsigned j = 0; j != numSuccessors; ++j) {
+          BasicBlock *successor = inst->getSuccessor(j);
+          ki->successors[j].entry = basicBlockEntry[successor];
+          PHINode *phi = dyn_cast<PHINode>(&successor->front());
+          ki->successors[j].incomingBBIndex =
+              phi ? phi->getBasicBlockIndex(&*bbit) : -1;
+        }
+      }
+
       if (isa<CallInst>(it) || isa<InvokeInst>(it)) {
 #if LLVM_VERSION_CODE >= LLVM_VERSION(8, 0)
         const CallBase &cs = cast<CallBase>(*inst);
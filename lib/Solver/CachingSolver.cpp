@@ -77,10 +77,7 @@ public:
   }
   bool computeInitialValues(const Query& query,
                             std::shared_ptr<const Assignment> &result,
-                            bool &hasSolution) {
-    ++stats::queryCacheMisses;
-    return solver->impl->computeInitialValues(query, result, hasSolution);
-  }
+                            bool &hasSolution);
   SolverRunStatus getOperationStatusCode();
   char *getConstraintLog(const Query&);
   void setCoreSolverTimeout(time::Span timeout);
@@ -239,6 +236,38 @@ bool CachingSolver::computeTruth(const Query& query,
   return true;
 }
 
+bool CachingSolver::computeInitialValues(const Query& query,
+                                         std::shared_ptr<const Assignment> &result,
+                                         bool &hasSolution) {
+  // A valid query has no counterexample. Otherwise the assignment has to
+  // come from the solver, but its outcome is still cached for computeTruth.
+  IncompleteSolver::PartialValidity cachedResult;
+  bool cacheHit = cacheLookup(query, cachedResult);
+  if (cacheHit && cachedResult == IncompleteSolver::MustBeTrue) {
+    ++stats::queryCacheHits;
+    hasSolution = false;
+    return true;
+  }
+  ++stats::queryCacheMisses;
+
+  if (!solver->impl->computeInitialValues(query, result, hasSolution))
+    return false;
+
+  if (!hasSolution) {
+    cachedResult = IncompleteSolver::MustBeTrue;
+  } else if (cacheHit) {
+    // a counterexample shows that the query may be false
+    if (cachedResult != IncompleteSolver::MayBeTrue)
+      return true;
+    cachedResult = IncompleteSolver::TrueOrFalse;
+  } else {
+    cachedResult = IncompleteSolver::MayBeFalse;
+  }
+
+  cacheInsert(query, cachedResult);
+  return true;
+}
+
 SolverImpl::SolverRunStatus CachingSolver::getOperationStatusCode() {
   return solver->impl->getOperationStatusCode();
 }
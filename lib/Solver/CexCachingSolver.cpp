@@ -9,10 +9,11 @@
 
 #include "klee/Solver/Solver.h"
 
-#include "klee/ADT/MapOfSets.h"
+#include "klee/ADT/SetIndex.h"
 #include "klee/Expr/Assignment.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
 #include "klee/Expr/ExprUtil.h"
 #include "klee/Expr/ExprVisitor.h"
 #include "klee/Support/OptionCategories.h"
@@ -45,6 +46,13 @@ cl::opt<bool>
                               "before asking the SMT solver (default=false)"),
                      cl::cat(SolvingCat));
 
+cl::opt<unsigned> CexCacheSize(
+    "cex-cache-size", cl::init(1 << 20),
+    cl::desc("Maximum number of constraint sets kept in the counterexample "
+             "cache, the least recently used ones are dropped first. 0 means "
+             "unbounded (default=1048576)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool> CexCacheExperimental(
     "cex-cache-exp", cl::init(false),
     cl::desc("Optimization for validity queries (default=false)"),
@@ -57,14 +65,11 @@ cl::opt<bool> CexCacheExperimental(
 typedef std::set< ref<Expr> > KeyType;
 
 class CexCachingSolver : public SolverImpl {
-  typedef std::set<std::shared_ptr<const Assignment> >
-          assignmentsTable_ty;
-
   Solver *solver;
-  
-  MapOfSets<ref<Expr>, std::shared_ptr<const Assignment>> cache;
-  // memo table
-  assignmentsTable_ty assignmentsTable;
+
+  SetIndex<ref<Expr>, std::shared_ptr<const Assignment>, util::ExprHash,
+           util::ExprCmp>
+      cache;
 
   bool searchForAssignment(KeyType &key, 
                            std::shared_ptr<const Assignment> &result);
@@ -82,7 +87,7 @@ class CexCachingSolver : public SolverImpl {
                      std::shared_ptr<const Assignment> &result);
   
 public:
-  CexCachingSolver(Solver *_solver) : solver(_solver) {}
+  CexCachingSolver(Solver *_solver) : solver(_solver), cache(CexCacheSize) {}
   ~CexCachingSolver();
   
   bool computeTruth(const Query&, bool &isValid);
@@ -148,15 +153,14 @@ bool CexCachingSolver::searchForAssignment(KeyType &key,
       return true;
     }
 
-    // Otherwise, iterate through the set of current assignments to see if one
-    // of them satisfies the query.
-    for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
-           ie = assignmentsTable.end(); it != ie; ++it) {
-      std::shared_ptr<const Assignment> a = *it;
-      if (a->satisfies(key.begin(), key.end())) {
-        result = a;
-        return true;
-      }
+    // Otherwise, iterate through the cached assignments to see if one of
+    // them satisfies the query.
+    lookup = cache.findAny([&key](const std::shared_ptr<const Assignment> &a) {
+      return a && a->satisfies(key.begin(), key.end());
+    });
+    if (lookup) {
+      result = *lookup;
+      return true;
     }
   } else {
     // FIXME: Which order? one is sure to be better.
@@ -196,6 +200,7 @@ bool CexCachingSolver::searchForAssignment(KeyType &key,
 bool CexCachingSolver::lookupAssignment(const Query &query, 
                                         KeyType &key,
                                         std::shared_ptr<const Assignment> &result) {
+  TimerStatIncrementer t(stats::cexCacheLookupTime);
   key = KeyType(query.constraints.begin(), query.constraints.end());
   ref<Expr> neg = Expr::createIsZero(query.expr);
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(neg)) {
@@ -228,13 +233,9 @@ bool CexCachingSolver::getAssignment(const Query& query,
     return false;
 
     
-  if (hasSolution) {
-    // Memoize the result.
-    assignmentsTable.insert(result);
-  } else {
+  if (!hasSolution)
     result = 0;
-  }
-  
+
   cache.insert(key, result);
 
   return true;
@@ -24,10 +24,26 @@ Solver *constructSolverChain(Solver *coreSolver,
                              std::string querySMT2LogPath,
                              std::string baseSolverQuerySMT2LogPath,
                              std::string queryKQueryLogPath,
-                             std::string baseSolverQueryKQueryLogPath) {
+                             std::string baseSolverQueryKQueryLogPath,
+                             SolverLayerTimes *layerTimes) {
   Solver *solver = coreSolver;
   const time::Span minQueryTimeToLog(MinQueryTimeToLog);
 
+  if (PortfolioSolverBackend != NO_SOLVER) {
+    Solver *secondary = createCoreSolver(PortfolioSolverBackend);
+    if (!secondary)
+      klee_error("Failed to create portfolio solver backend");
+    solver = createPortfolioSolver(solver, CoreSolverToUse, secondary,
+                                   PortfolioSolverBackend,
+                                   time::Span(PortfolioThreshold));
+    klee_message("Racing the core solver against a second backend on "
+                 "queries taking longer than %s",
+                 PortfolioThreshold.c_str());
+  }
+
+  if (layerTimes)
+    solver = createProfilingSolver(solver, SolverLayerTimes::Core, *layerTimes);
+
   if (QueryLoggingOptions.isSet(SOLVER_KQUERY)) {
     solver = createKQueryLoggingSolver(solver, baseSolverQueryKQueryLogPath, minQueryTimeToLog, LogTimedOutQueries);
     klee_message("Logging queries that reach solver in .kquery format to %s\n",
@@ -40,20 +56,40 @@ Solver *constructSolverChain(Solver *coreSolver,
                  baseSolverQuerySMT2LogPath.c_str());
   }
 
+  if (!PersistentQueryCache.empty()) {
+    solver = createPersistentCachingSolver(solver, PersistentQueryCache);
+    klee_message("Using persistent query cache %s",
+                 PersistentQueryCache.c_str());
+  }
+
   if (UseAssignmentValidatingSolver)
     solver = createAssignmentValidatingSolver(solver);
 
   if (UseFastCexSolver)
     solver = createFastCexSolver(solver);
 
-  if (UseCexCache)
+  // layers without a profiling solver of their own are charged to the
+  // next one above them
+  if (UseCexCache) {
     solver = createCexCachingSolver(solver);
+    if (layerTimes)
+      solver = createProfilingSolver(solver, SolverLayerTimes::CexCaching,
+                                     *layerTimes);
+  }
 
-  if (UseBranchCache)
+  if (UseBranchCache) {
     solver = createCachingSolver(solver);
+    if (layerTimes)
+      solver = createProfilingSolver(solver, SolverLayerTimes::Caching,
+                                     *layerTimes);
+  }
 
-  if (UseIndependentSolver)
+  if (UseIndependentSolver) {
     solver = createIndependentSolver(solver);
+    if (layerTimes)
+      solver = createProfilingSolver(solver, SolverLayerTimes::Independent,
+                                     *layerTimes);
+  }
 
   if (DebugValidateSolver)
     solver = createValidatingSolver(solver, coreSolver);
@@ -45,7 +45,7 @@ Solver *createCoreSolver(CoreSolverType cst) {
   case Z3_SOLVER:
 #ifdef ENABLE_Z3
     klee_message("Using Z3 solver backend");
-    return new Z3Solver();
+    return new Z3Solver(Z3IncrementalSolvers, Z3ConstructCacheSize);
 #else
     klee_message("Not compiled with Z3 support");
     return NULL;
@@ -0,0 +1,370 @@
+//===-- PersistentCachingSolver.cpp -----------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/ADT/StringExtras.h"
+
+#include <sqlite3.h>
+
+#include <map>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+/// Writes a query as text that does not depend on the names or addresses
+/// of its arrays. Arrays are numbered in the order they are first seen, so
+/// the same query built in another run, where the arrays got other names,
+/// produces the same text. Shared subexpressions are written once and
+/// referred to by their number.
+class QueryCanonicalizer {
+  std::ostringstream out;
+  ExprHashMap<unsigned> exprs;
+  std::unordered_map<const UpdateNode *, unsigned> updates;
+  std::map<const Array *, unsigned> arrayIds;
+
+  unsigned visitArray(const Array *array) {
+    auto it = arrayIds.find(array);
+    if (it != arrayIds.end())
+      return it->second;
+    unsigned id = arrays.size();
+    arrays.push_back(array);
+    arrayIds[array] = id;
+    out << "a" << id << " " << array->size << " " << array->domain << " "
+        << array->range;
+    for (const auto &value : array->constantValues)
+      out << " " << value->getZExtValue();
+    out << "\n";
+    return id;
+  }
+
+  unsigned visitUpdate(const UpdateNode *un) {
+    // update lists can be long, so the nodes not seen yet are written
+    // oldest first without recursing along the list
+    std::vector<const UpdateNode *> fresh;
+    unsigned next = 0;
+    for (; un; un = un->next.get()) {
+      auto it = updates.find(un);
+      if (it != updates.end()) {
+        next = it->second;
+        break;
+      }
+      fresh.push_back(un);
+    }
+    for (auto it = fresh.rbegin(); it != fresh.rend(); ++it) {
+      unsigned index = visit((*it)->index);
+      unsigned value = visit((*it)->value);
+      unsigned id = updates.size() + 1;
+      updates[*it] = id;
+      out << "u" << id << " " << next << " " << index << " " << value
+          << "\n";
+      next = id;
+    }
+    return next;
+  }
+
+public:
+  /// Arrays of the query, indexed by their canonical number
+  std::vector<const Array *> arrays;
+
+  unsigned visit(const ref<Expr> &e) {
+    auto it = exprs.find(e);
+    if (it != exprs.end())
+      return it->second;
+
+    std::vector<unsigned> kids;
+    unsigned array = 0, update = 0;
+    if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+      array = visitArray(re->updates.root);
+      update = visitUpdate(re->updates.head.get());
+    }
+    for (unsigned i = 0; i < e->getNumKids(); ++i)
+      kids.push_back(visit(e->getKid(i)));
+
+    unsigned id = exprs.size();
+    out << "e" << id << " " << e->getKind() << " " << e->getWidth();
+    if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(e)) {
+      std::string value;
+      ce->toString(value, 16);
+      out << " " << value;
+    } else if (const ExtractExpr *ee = dyn_cast<ExtractExpr>(e)) {
+      out << " " << ee->offset;
+    } else if (isa<ReadExpr>(e)) {
+      out << " a" << array << " u" << update;
+    }
+    for (unsigned kid : kids)
+      out << " " << kid;
+    out << "\n";
+    exprs.insert(std::make_pair(e, id));
+    return id;
+  }
+
+  std::string str() const { return out.str(); }
+};
+
+uint64_t fnv1a(const std::string &data) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+} // namespace
+
+/// Caches query results in an SQLite database that outlives the run.
+///
+/// Queries are keyed by their canonical text (see QueryCanonicalizer), so
+/// a result computed in one run is found in a later run that builds the
+/// same query, even if the program around it changed. Only successful
+/// results are stored.
+class PersistentCachingSolver : public SolverImpl {
+  enum QueryKind { Truth = 0, Validity = 1, Value = 2, InitialValues = 3 };
+
+  struct Key {
+    std::string text;
+    uint64_t hash;
+    QueryKind kind;
+    std::vector<const Array *> arrays;
+  };
+
+  Solver *solver;
+  std::string path;
+  sqlite3 *db = nullptr;
+  sqlite3_stmt *lookupStmt = nullptr;
+  sqlite3_stmt *insertStmt = nullptr;
+
+  Key makeKey(const Query &query, QueryKind kind);
+  bool lookup(const Key &key, std::string &result);
+  void insert(const Key &key, const std::string &result);
+
+public:
+  PersistentCachingSolver(Solver *solver, std::string path);
+  ~PersistentCachingSolver();
+
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() {
+    return solver->impl->getOperationStatusCode();
+  }
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span timeout) {
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+};
+
+PersistentCachingSolver::PersistentCachingSolver(Solver *solver,
+                                                 std::string path)
+    : solver(solver), path(std::move(path)) {
+  if (sqlite3_open(this->path.c_str(), &db) != SQLITE_OK)
+    klee_error("Can't open persistent query cache %s: %s", this->path.c_str(),
+               sqlite3_errmsg(db));
+
+  // another process may hold the database while it commits
+  sqlite3_busy_timeout(db, 10000);
+  const char *setup =
+      "PRAGMA synchronous = OFF;"
+      "CREATE TABLE IF NOT EXISTS queries ("
+      "Hash INTEGER, Kind INTEGER, Query BLOB, Result BLOB);"
+      "CREATE INDEX IF NOT EXISTS queries_hash ON queries (Hash, Kind);";
+  char *zErrMsg = nullptr;
+  if (sqlite3_exec(db, setup, nullptr, nullptr, &zErrMsg) != SQLITE_OK) {
+    std::string error = zErrMsg;
+    sqlite3_free(zErrMsg);
+    klee_error("Can't set up persistent query cache %s: %s",
+               this->path.c_str(), error.c_str());
+  }
+
+  if (sqlite3_prepare_v2(db,
+                         "SELECT Result FROM queries WHERE Hash = ? AND "
+                         "Kind = ? AND Query = ?",
+                         -1, &lookupStmt, nullptr) != SQLITE_OK ||
+      sqlite3_prepare_v2(db,
+                         "INSERT INTO queries (Hash, Kind, Query, Result) "
+                         "VALUES (?, ?, ?, ?)",
+                         -1, &insertStmt, nullptr) != SQLITE_OK)
+    klee_error("Cannot create prepared statement: %s", sqlite3_errmsg(db));
+}
+
+PersistentCachingSolver::~PersistentCachingSolver() {
+  sqlite3_finalize(lookupStmt);
+  sqlite3_finalize(insertStmt);
+  sqlite3_close(db);
+  delete solver;
+}
+
+PersistentCachingSolver::Key
+PersistentCachingSolver::makeKey(const Query &query, QueryKind kind) {
+  QueryCanonicalizer canonicalizer;
+  std::ostringstream roots;
+  for (const auto &constraint : query.constraints)
+    roots << " " << canonicalizer.visit(constraint);
+  roots << " q" << canonicalizer.visit(query.expr);
+
+  Key key;
+  key.text = canonicalizer.str() + roots.str();
+  key.hash = fnv1a(key.text);
+  key.kind = kind;
+  key.arrays = std::move(canonicalizer.arrays);
+  return key;
+}
+
+bool PersistentCachingSolver::lookup(const Key &key, std::string &result) {
+  sqlite3_bind_int64(lookupStmt, 1, static_cast<sqlite3_int64>(key.hash));
+  sqlite3_bind_int(lookupStmt, 2, key.kind);
+  sqlite3_bind_blob(lookupStmt, 3, key.text.data(), key.text.size(),
+                    SQLITE_STATIC);
+  bool found = false;
+  if (sqlite3_step(lookupStmt) == SQLITE_ROW) {
+    const char *data =
+        static_cast<const char *>(sqlite3_column_blob(lookupStmt, 0));
+    result.assign(data, sqlite3_column_bytes(lookupStmt, 0));
+    found = true;
+  }
+  sqlite3_reset(lookupStmt);
+  if (found)
+    ++stats::queryPersistentCacheHits;
+  else
+    ++stats::queryPersistentCacheMisses;
+  return found;
+}
+
+// Every insert commits on its own: parallel workers share the database, and
+// a transaction kept open across queries would hold its write lock for
+// that long.
+void PersistentCachingSolver::insert(const Key &key,
+                                     const std::string &result) {
+  sqlite3_bind_int64(insertStmt, 1, static_cast<sqlite3_int64>(key.hash));
+  sqlite3_bind_int(insertStmt, 2, key.kind);
+  sqlite3_bind_blob(insertStmt, 3, key.text.data(), key.text.size(),
+                    SQLITE_STATIC);
+  sqlite3_bind_blob(insertStmt, 4, result.data(), result.size(),
+                    SQLITE_STATIC);
+  if (sqlite3_step(insertStmt) != SQLITE_DONE)
+    klee_warning("Error writing persistent query cache: %s",
+                 sqlite3_errmsg(db));
+  sqlite3_reset(insertStmt);
+}
+
+bool PersistentCachingSolver::computeValidity(const Query &query,
+                                              Solver::Validity &result) {
+  Key key = makeKey(query, Validity);
+  std::string cached;
+  if (lookup(key, cached)) {
+    result = static_cast<Solver::Validity>(std::stoi(cached));
+    return true;
+  }
+  if (!solver->impl->computeValidity(query, result))
+    return false;
+  insert(key, llvm::itostr(result));
+  return true;
+}
+
+bool PersistentCachingSolver::computeTruth(const Query &query,
+                                           bool &isValid) {
+  Key key = makeKey(query, Truth);
+  std::string cached;
+  if (lookup(key, cached)) {
+    isValid = cached == "1";
+    return true;
+  }
+  if (!solver->impl->computeTruth(query, isValid))
+    return false;
+  insert(key, isValid ? "1" : "0");
+  return true;
+}
+
+bool PersistentCachingSolver::computeValue(const Query &query,
+                                           ref<Expr> &result) {
+  Key key = makeKey(query, Value);
+  std::string cached;
+  if (lookup(key, cached)) {
+    std::istringstream in(cached);
+    unsigned width;
+    std::string value;
+    in >> width >> value;
+    result = ConstantExpr::alloc(llvm::APInt(width, value, 16));
+    return true;
+  }
+  if (!solver->impl->computeValue(query, result))
+    return false;
+  std::string value;
+  cast<ConstantExpr>(result)->toString(value, 16);
+  insert(key, llvm::utostr(result->getWidth()) + " " + value);
+  return true;
+}
+
+bool PersistentCachingSolver::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  Key key = makeKey(query, InitialValues);
+  std::string cached;
+  if (lookup(key, cached)) {
+    // one line per canonical array, listing index:value pairs
+    std::istringstream in(cached);
+    std::string line;
+    std::getline(in, line);
+    hasSolution = line == "1";
+    if (hasSolution) {
+      Assignment::map_bindings_ty bindings;
+      for (const Array *array : key.arrays) {
+        std::getline(in, line);
+        if (line.empty() || line[0] != '+')
+          continue;
+        MapArrayModel &model = bindings[array];
+        std::istringstream values(line.substr(1));
+        unsigned index, value;
+        char colon;
+        while (values >> index >> colon >> value)
+          model.add(index, value);
+      }
+      result = std::make_shared<Assignment>(bindings);
+    }
+    return true;
+  }
+
+  if (!solver->impl->computeInitialValues(query, result, hasSolution))
+    return false;
+  std::ostringstream out;
+  out << (hasSolution ? "1" : "0") << "\n";
+  if (hasSolution) {
+    for (const Array *array : key.arrays) {
+      if (const CompactArrayModel *model = result->getBindingsOrNull(array)) {
+        out << "+";
+        for (const auto &value : model->asMap())
+          out << " " << value.first << ":" << unsigned(value.second);
+      }
+      out << "\n";
+    }
+  }
+  insert(key, out.str());
+  return true;
+}
+
+Solver *klee::createPersistentCachingSolver(Solver *s, std::string path) {
+  return new Solver(new PersistentCachingSolver(s, std::move(path)));
+}
@@ -0,0 +1,496 @@
+//===-- PortfolioSolver.cpp -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/Statistics/Statistics.h"
+#include "klee/Support/ErrorHandling.h"
+#include "klee/System/Time.h"
+
+#include "llvm/Support/Errno.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace klee {
+
+/// Sends queries to a primary core solver and, once a query has been
+/// running for longer than a threshold, races the primary against a
+/// secondary solver. Both run in forked processes so that the loser can be
+/// killed as soon as the other one answers; the primary is forked when the
+/// query starts and keeps running in the race.
+class PortfolioSolver : public SolverImpl {
+private:
+  /// A result produced in a forked racer, serialized as raw bytes
+  typedef std::string Payload;
+  typedef std::function<bool(Solver *, Payload &)> RaceBody;
+
+  struct Racer {
+    Solver *solver;
+    CoreSolverType type;
+    pid_t pid = -1;
+    int fd = -1;
+    Payload payload;
+  };
+
+  Solver *primary, *secondary;
+  CoreSolverType primaryType, secondaryType;
+  time::Span threshold;
+  time::Span timeout;
+  SolverRunStatus runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+
+  bool isRaceable() const {
+    return threshold && (!timeout || threshold < timeout);
+  }
+  /// Run body on the primary solver in this process.
+  bool runPrimary(const std::function<bool()> &body);
+  /// Fork a process running body on the solver of racer.
+  bool start(Racer &racer, const RaceBody &body, time::Span racerTimeout);
+  /// Run body on the primary solver in a forked process and, once the
+  /// threshold has passed, on the secondary solver as well.
+  /// \return false if neither of them succeeded
+  bool race(const RaceBody &body, Payload &winner);
+  /// Read the statistics and the outcome a racer sent before its result.
+  /// \return false if the payload is malformed
+  bool finish(Racer &racer, bool &success);
+  void recordWin(CoreSolverType type);
+  bool fail() {
+    runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+    return false;
+  }
+
+public:
+  PortfolioSolver(Solver *primary, CoreSolverType primaryType,
+                  Solver *secondary, CoreSolverType secondaryType,
+                  time::Span threshold)
+      : primary(primary), secondary(secondary), primaryType(primaryType),
+        secondaryType(secondaryType), threshold(threshold) {}
+  ~PortfolioSolver() {
+    delete primary;
+    delete secondary;
+  }
+
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() { return runStatusCode; }
+  char *getConstraintLog(const Query &query) {
+    return primary->impl->getConstraintLog(query);
+  }
+  // the racers set their own timeouts in their processes
+  void setCoreSolverTimeout(time::Span _timeout) {
+    timeout = _timeout;
+    primary->setCoreSolverTimeout(timeout);
+  }
+};
+
+namespace {
+template <typename T> void append(std::string &out, const T &value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+class Reader {
+  const std::string &in;
+  std::size_t pos = 0;
+
+public:
+  explicit Reader(const std::string &in) : in(in) {}
+
+  template <typename T> bool read(T &value) {
+    if (pos + sizeof(T) > in.size())
+      return false;
+    std::memcpy(&value, in.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+  }
+
+  std::size_t remaining() const { return in.size() - pos; }
+  bool atEnd() const { return pos == in.size(); }
+};
+
+bool writeAll(int fd, const std::string &data) {
+  std::size_t written = 0;
+  while (written < data.size()) {
+    ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    written += n;
+  }
+  return true;
+}
+
+std::vector<std::uint64_t> getStatistics() {
+  std::vector<std::uint64_t> values;
+  values.reserve(theStatisticManager->getNumStatistics());
+  for (unsigned i = 0, e = theStatisticManager->getNumStatistics(); i != e;
+       ++i)
+    values.push_back(
+        theStatisticManager->getValue(theStatisticManager->getStatistic(i)));
+  return values;
+}
+} // namespace
+
+bool PortfolioSolver::runPrimary(const std::function<bool()> &body) {
+  bool success = body();
+  runStatusCode = primary->impl->getOperationStatusCode();
+  return success;
+}
+
+void PortfolioSolver::recordWin(CoreSolverType type) {
+  switch (type) {
+  case STP_SOLVER:
+    ++stats::queryPortfolioWinsSTP;
+    break;
+  case Z3_SOLVER:
+    ++stats::queryPortfolioWinsZ3;
+    break;
+  case METASMT_SOLVER:
+    ++stats::queryPortfolioWinsMetaSMT;
+    break;
+  default:
+    break;
+  }
+}
+
+bool PortfolioSolver::start(Racer &racer, const RaceBody &body,
+                            time::Span racerTimeout) {
+  int fds[2];
+  if (pipe(fds) == -1) {
+    klee_warning("pipe failed (for portfolio solver) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return false;
+  }
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid == -1) {
+    klee_warning("fork failed (for portfolio solver) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+  if (pid == 0) {
+    // the racer is killed by the parent or interrupted along with it
+    ::signal(SIGINT, SIG_DFL);
+    close(fds[0]);
+    racer.solver->setCoreSolverTimeout(racerTimeout);
+    std::vector<std::uint64_t> before = getStatistics();
+    Payload result;
+    bool success = body(racer.solver, result);
+    std::vector<std::uint64_t> after = getStatistics();
+
+    // statistics deltas, outcome, then the result if there is one
+    Payload payload;
+    append<uint32_t>(payload, after.size());
+    for (unsigned i = 0; i != after.size(); ++i)
+      append<uint64_t>(payload, after[i] - before[i]);
+    append<uint8_t>(payload, success);
+    append<uint32_t>(payload, racer.solver->impl->getOperationStatusCode());
+    payload += result;
+    _exit(writeAll(fds[1], payload) ? 0 : 1);
+  }
+  close(fds[1]);
+  racer.pid = pid;
+  racer.fd = fds[0];
+  return true;
+}
+
+bool PortfolioSolver::finish(Racer &racer, bool &success) {
+  Reader in(racer.payload);
+  uint32_t numStatistics;
+  if (!in.read(numStatistics) ||
+      numStatistics != theStatisticManager->getNumStatistics())
+    return false;
+  std::vector<uint64_t> deltas(numStatistics);
+  for (auto &delta : deltas)
+    if (!in.read(delta))
+      return false;
+  uint8_t succeeded;
+  uint32_t status;
+  if (!in.read(succeeded) || !in.read(status))
+    return false;
+
+  // the work of the racer is charged as if it had run in this process
+  for (unsigned i = 0; i != deltas.size(); ++i)
+    if (deltas[i])
+      theStatisticManager->incrementStatistic(
+          theStatisticManager->getStatistic(i), deltas[i]);
+  success = succeeded;
+  runStatusCode = static_cast<SolverRunStatus>(status);
+  racer.payload.erase(0, racer.payload.size() - in.remaining());
+  return true;
+}
+
+bool PortfolioSolver::race(const RaceBody &body, Payload &winner) {
+  Racer racers[2];
+  racers[0].solver = primary;
+  racers[0].type = primaryType;
+  racers[1].solver = secondary;
+  racers[1].type = secondaryType;
+  Racer &first = racers[0], &second = racers[1];
+
+  if (!start(first, body, timeout)) {
+    bool success = body(primary, winner);
+    runStatusCode = primary->impl->getOperationStatusCode();
+    return success;
+  }
+  const time::Point raceStart = time::getWallTime() + threshold;
+  bool raced = false;
+  runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+
+  Racer *won = nullptr;
+  unsigned running = 1;
+  while (running && !won) {
+    int wait = -1;
+    if (!raced) {
+      const time::Point now = time::getWallTime();
+      if (now >= raceStart) {
+        // the primary keeps its progress and runs on in the race
+        raced = true;
+        ++stats::queryPortfolioRaces;
+        if (start(second, body, timeout ? timeout - threshold : time::Span()))
+          ++running;
+        continue;
+      }
+      wait = static_cast<int>((raceStart - now).toMicroseconds() / 1000) + 1;
+    }
+
+    struct pollfd pfds[2];
+    nfds_t count = 0;
+    Racer *polled[2];
+    for (auto &racer : racers) {
+      if (racer.fd == -1)
+        continue;
+      pfds[count] = {racer.fd, POLLIN, 0};
+      polled[count++] = &racer;
+    }
+    if (poll(pfds, count, wait) < 0) {
+      if (errno == EINTR)
+        continue;
+      klee_warning("poll failed (for portfolio solver) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      break;
+    }
+    for (nfds_t i = 0; i < count && !won; ++i) {
+      if (!pfds[i].revents)
+        continue;
+      Racer &racer = *polled[i];
+      char buffer[4096];
+      ssize_t n = read(racer.fd, buffer, sizeof(buffer));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n > 0) {
+        racer.payload.append(buffer, n);
+        continue;
+      }
+      // end of file, the racer is done
+      close(racer.fd);
+      racer.fd = -1;
+      --running;
+      int status;
+      while (waitpid(racer.pid, &status, 0) < 0 && errno == EINTR)
+        ;
+      racer.pid = -1;
+      bool success = false;
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+          !finish(racer, success)) {
+        klee_warning_once(0, "portfolio solver: a racer died without a "
+                             "result");
+        runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+      }
+      if (success)
+        won = &racer;
+    }
+  }
+
+  for (auto &racer : racers) {
+    if (racer.pid != -1) {
+      kill(racer.pid, SIGKILL);
+      while (waitpid(racer.pid, nullptr, 0) < 0 && errno == EINTR)
+        ;
+    }
+    if (racer.fd != -1)
+      close(racer.fd);
+  }
+
+  if (!won)
+    return false;
+  if (raced)
+    recordWin(won->type);
+  winner = std::move(won->payload);
+  return true;
+}
+
+bool PortfolioSolver::computeTruth(const Query &query, bool &isValid) {
+  if (!isRaceable())
+    return runPrimary(
+        [&] { return primary->impl->computeTruth(query, isValid); });
+
+  Payload winner;
+  if (!race(
+          [&query](Solver *solver, Payload &out) {
+            bool valid;
+            if (!solver->impl->computeTruth(query, valid))
+              return false;
+            append<uint8_t>(out, valid);
+            return true;
+          },
+          winner))
+    return false;
+  Reader in(winner);
+  uint8_t valid;
+  if (!in.read(valid) || valid > 1 || !in.atEnd())
+    return fail();
+  isValid = valid;
+  runStatusCode = isValid ? SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE
+                          : SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  return true;
+}
+
+bool PortfolioSolver::computeValue(const Query &query, ref<Expr> &result) {
+  if (!isRaceable())
+    return runPrimary(
+        [&] { return primary->impl->computeValue(query, result); });
+
+  Payload winner;
+  if (!race(
+          [&query](Solver *solver, Payload &out) {
+            ref<Expr> value;
+            if (!solver->impl->computeValue(query, value))
+              return false;
+            const llvm::APInt &bits = cast<ConstantExpr>(value)->getAPValue();
+            append<uint32_t>(out, bits.getBitWidth());
+            append<uint32_t>(out, bits.getNumWords());
+            out.append(reinterpret_cast<const char *>(bits.getRawData()),
+                       bits.getNumWords() * sizeof(uint64_t));
+            return true;
+          },
+          winner))
+    return false;
+  Reader in(winner);
+  uint32_t width, numWords;
+  if (!in.read(width) || !in.read(numWords) || width == 0 ||
+      numWords != (width + 63) / 64)
+    return fail();
+  std::vector<uint64_t> words(numWords);
+  for (auto &word : words)
+    if (!in.read(word))
+      return fail();
+  if (!in.atEnd())
+    return fail();
+  result = ConstantExpr::alloc(llvm::APInt(width, words));
+  runStatusCode = SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  return true;
+}
+
+bool PortfolioSolver::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  if (!isRaceable())
+    return runPrimary([&] {
+      return primary->impl->computeInitialValues(query, result, hasSolution);
+    });
+
+  // the racers share the arrays of the parent, so they are referred to by
+  // their address
+  std::vector<const Array *> objects;
+  findSymbolicObjects(query.expr, objects);
+  findSymbolicObjects(query.constraints.begin(), query.constraints.end(),
+                      objects);
+  std::sort(objects.begin(), objects.end());
+  objects.erase(std::unique(objects.begin(), objects.end()), objects.end());
+
+  Payload winner;
+  if (!race(
+          [&query, &objects](Solver *solver, Payload &out) {
+            std::shared_ptr<const Assignment> assignment;
+            bool solvable;
+            if (!solver->impl->computeInitialValues(query, assignment,
+                                                    solvable))
+              return false;
+            append<uint8_t>(out, solvable);
+            if (!solvable)
+              return true;
+            for (const Array *array : objects) {
+              const CompactArrayModel *model =
+                  assignment->getBindingsOrNull(array);
+              std::map<uint32_t, uint8_t> values;
+              if (model)
+                values = model->asMap();
+              append<uint8_t>(out, model != nullptr);
+              append<uint32_t>(out, values.size());
+              for (const auto &value : values) {
+                append<uint32_t>(out, value.first);
+                append<uint8_t>(out, value.second);
+              }
+            }
+            return true;
+          },
+          winner))
+    return false;
+
+  Reader in(winner);
+  uint8_t solvable;
+  if (!in.read(solvable) || solvable > 1)
+    return fail();
+  Assignment::map_bindings_ty bindings;
+  if (solvable) {
+    for (const Array *array : objects) {
+      uint8_t bound;
+      uint32_t count;
+      if (!in.read(bound) || !in.read(count) ||
+          count > in.remaining() / (sizeof(uint32_t) + sizeof(uint8_t)))
+        return fail();
+      if (bound)
+        bindings[array];
+      for (uint32_t i = 0; i < count; ++i) {
+        uint32_t index;
+        uint8_t value;
+        if (!in.read(index) || !in.read(value) || index >= array->getSize())
+          return fail();
+        bindings[array].add(index, value);
+      }
+    }
+  }
+  if (!in.atEnd())
+    return fail();
+  hasSolution = solvable;
+  if (hasSolution)
+    result = std::make_shared<Assignment>(bindings);
+  runStatusCode = hasSolution ? SOLVER_RUN_STATUS_SUCCESS_SOLVABLE
+                              : SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE;
+  return true;
+}
+
+Solver *createPortfolioSolver(Solver *primary, CoreSolverType primaryType,
+                              Solver *secondary, CoreSolverType secondaryType,
+                              time::Span threshold) {
+  return new Solver(new PortfolioSolver(primary, primaryType, secondary,
+                                        secondaryType, threshold));
+}
+} // namespace klee
@@ -0,0 +1,93 @@
+//===-- ProfilingSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+
+#include <functional>
+
+namespace klee {
+
+const char *SolverLayerTimes::getLayerName(Layer layer) {
+  switch (layer) {
+  case Independent:
+    return "Independent";
+  case Caching:
+    return "Caching";
+  case CexCaching:
+    return "CexCaching";
+  case Core:
+    return "Core";
+  default:
+    return "Unknown";
+  }
+}
+
+class ProfilingSolver : public SolverImpl {
+private:
+  Solver *solver;
+  SolverLayerTimes::Layer layer;
+  SolverLayerTimes &times;
+
+  bool profile(const std::function<bool()> &body);
+
+public:
+  ProfilingSolver(Solver *solver, SolverLayerTimes::Layer layer,
+                  SolverLayerTimes &times)
+      : solver(solver), layer(layer), times(times) {}
+  ~ProfilingSolver() { delete solver; }
+
+  bool computeValidity(const Query &query, Solver::Validity &result) {
+    return profile(
+        [&] { return solver->impl->computeValidity(query, result); });
+  }
+  bool computeTruth(const Query &query, bool &isValid) {
+    return profile([&] { return solver->impl->computeTruth(query, isValid); });
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    return profile([&] { return solver->impl->computeValue(query, result); });
+  }
+  bool computeInitialValues(const Query &query,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution) {
+    return profile([&] {
+      return solver->impl->computeInitialValues(query, result, hasSolution);
+    });
+  }
+  SolverRunStatus getOperationStatusCode() {
+    return solver->impl->getOperationStatusCode();
+  }
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span timeout) {
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+};
+
+bool ProfilingSolver::profile(const std::function<bool()> &body) {
+  const time::Span outerNested = times.nested;
+  times.nested = time::Span();
+  const time::Point start = time::getWallTime();
+
+  bool success = body();
+
+  const time::Span total = time::getWallTime() - start;
+  // layers below charged their own time in the meantime
+  if (times.nested < total)
+    times.times[layer] += total - times.nested;
+  times.nested = outerNested + total;
+  return success;
+}
+
+Solver *createProfilingSolver(Solver *s, SolverLayerTimes::Layer layer,
+                              SolverLayerTimes &times) {
+  return new Solver(new ProfilingSolver(s, layer, times));
+}
+} // namespace klee
@@ -70,6 +70,66 @@ bool Solver::mayBeTrue(const Query& query, bool &result) {
   return true;
 }
 
+bool Solver::mayBeTrue(const ConstraintSet &constraints,
+                       const std::vector<ref<Expr>> &exprs,
+                       std::vector<bool> &results) {
+  results.assign(exprs.size(), false);
+
+  std::vector<unsigned> pending;
+  for (unsigned i = 0; i != exprs.size(); ++i) {
+    assert(exprs[i]->getWidth() == Expr::Bool && "Invalid expression type!");
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(exprs[i]))
+      results[i] = CE->isTrue();
+    else
+      pending.push_back(i);
+  }
+
+  while (!pending.empty()) {
+    if (pending.size() == 1) {
+      bool result;
+      if (!mayBeTrue(Query(constraints, exprs[pending.front()]), result))
+        return false;
+      results[pending.front()] = result;
+      break;
+    }
+
+    ref<Expr> any = ConstantExpr::alloc(0, Expr::Bool);
+    for (unsigned i : pending)
+      any = OrExpr::create(exprs[i], any);
+
+    // a model of the constraints in which any of the pending ones holds
+    std::shared_ptr<const Assignment> model;
+    bool hasSolution;
+    if (!impl->computeInitialValues(
+            Query(constraints, Expr::createIsZero(any)), model, hasSolution))
+      return false;
+    if (!hasSolution)
+      break;
+
+    std::vector<unsigned> undecided;
+    for (unsigned i : pending) {
+      if (model->evaluate(exprs[i])->isTrue())
+        results[i] = true;
+      else
+        undecided.push_back(i);
+    }
+
+    if (undecided.size() == pending.size()) {
+      // the model does not decide any of them, fall back to single queries
+      for (unsigned i : pending) {
+        bool result;
+        if (!mayBeTrue(Query(constraints, exprs[i]), result))
+          return false;
+        results[i] = result;
+      }
+      break;
+    }
+    pending.swap(undecided);
+  }
+
+  return true;
+}
+
 bool Solver::mayBeFalse(const Query& query, bool &result) {
   bool res;
   if (!mustBeTrue(query, res))
@@ -107,6 +167,12 @@ Solver::getInitialValues(const Query& query,
   return success;
 }
 
+bool Solver::getInitialValues(const Query &query,
+                              std::shared_ptr<const Assignment> &result,
+                              bool &hasSolution) {
+  return impl->computeInitialValues(query, result, hasSolution);
+}
+
 std::pair< ref<ConstantExpr>, ref<ConstantExpr> > Solver::getRange(const Query& query) {
   ref<Expr> e = query.expr;
   Expr::Width width = e->getWidth();
@@ -51,6 +51,13 @@ cl::opt<bool> UseBranchCache("use-branch-cache", cl::init(true),
                              cl::desc("Use the branch cache (default=true)"),
                              cl::cat(SolvingCat));
 
+cl::opt<std::string> PersistentQueryCache(
+    "persistent-query-cache",
+    cl::desc("Cache solver results in the given SQLite database and reuse "
+             "them in later runs. Queries are matched regardless of the "
+             "names of their arrays (default=off)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool>
     UseIndependentSolver("use-independent-solver", cl::init(true),
                          cl::desc("Use constraint independence (default=true)"),
@@ -90,6 +97,21 @@ cl::opt<bool> CoreSolverOptimizeDivides(
              "passing them to the core SMT solver (default=false)"),
     cl::init(false), cl::cat(SolvingCat));
 
+cl::opt<unsigned> Z3IncrementalSolvers(
+    "z3-incremental-solvers",
+    cl::desc("Keep up to this many Z3 solvers alive between queries and "
+             "reuse the constraints they already hold via push/pop, a query "
+             "goes to the solver sharing the longest constraint prefix with "
+             "it. 0 creates a fresh solver for every query (default=0)"),
+    cl::init(0), cl::cat(SolvingCat));
+
+cl::opt<unsigned> Z3ConstructCacheSize(
+    "z3-construct-cache-size",
+    cl::desc("Maximum number of translated expressions kept between queries "
+             "by the incremental Z3 solver, least recently used ones are "
+             "dropped first (default=65536)"),
+    cl::init(65536), cl::cat(SolvingCat));
+
 cl::bits<QueryLoggingSolverType> QueryLoggingOptions(
     "use-query-log",
     cl::desc("Log queries to a file. Multiple options can be specified "
@@ -206,6 +228,24 @@ cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith(
                clEnumValN(Z3_SOLVER, "z3", "Z3"),
                clEnumValN(NO_SOLVER, "none", "Do not crosscheck (default)")),
     cl::init(NO_SOLVER), cl::cat(SolvingCat));
+
+cl::opt<CoreSolverType> PortfolioSolverBackend(
+    "portfolio-solver-backend",
+    cl::desc("Race the core solver against this solver backend on queries "
+             "running longer than --portfolio-threshold"),
+    cl::values(clEnumValN(STP_SOLVER, "stp", "STP"),
+               clEnumValN(METASMT_SOLVER, "metasmt", "metaSMT"),
+               clEnumValN(Z3_SOLVER, "z3", "Z3"),
+               clEnumValN(NO_SOLVER, "none", "Do not race (default)")),
+    cl::init(NO_SOLVER), cl::cat(SolvingCat));
+
+cl::opt<std::string> PortfolioThreshold(
+    "portfolio-threshold",
+    cl::desc("Time a query runs on the core solver alone before it is raced "
+             "against --portfolio-solver-backend. Every core solver query "
+             "then runs in a forked process, which keeps running in the "
+             "race (default=1s)"),
+    cl::init("1s"), cl::cat(SolvingCat));
 } // namespace klee
 
 #undef STP_IS_DEFAULT_STR
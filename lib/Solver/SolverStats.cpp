@@ -11,6 +11,7 @@
 
 using namespace klee;
 
+Statistic stats::cexCacheLookupTime("CexCacheLookupTime", "CClookupTime");
 Statistic stats::cexCacheTime("CexCacheTime", "CCtime");
 Statistic stats::queries("Queries", "Q");
 Statistic stats::queriesInvalid("QueriesInvalid", "Qiv");
@@ -21,6 +22,16 @@ Statistic stats::queryCexCacheHits("QueryCexCacheHits", "QCexHits") ;
 Statistic stats::queryCexCacheMisses("QueryCexCacheMisses", "QCexMisses");
 Statistic stats::queryConstructs("QueryConstructs", "QB");
 Statistic stats::queryCounterexamples("QueriesCEX", "Qcex");
+Statistic stats::queryModelHits("QueryModelHits", "QMhits");
+Statistic stats::queryPersistentCacheHits("QueryPersistentCacheHits",
+                                          "QPChits");
+Statistic stats::queryPersistentCacheMisses("QueryPersistentCacheMisses",
+                                            "QPCmisses");
+Statistic stats::queryPortfolioRaces("QueryPortfolioRaces", "QPraces");
+Statistic stats::queryPortfolioWinsMetaSMT("QueryPortfolioWinsMetaSMT",
+                                           "QPwinsMetaSMT");
+Statistic stats::queryPortfolioWinsSTP("QueryPortfolioWinsSTP", "QPwinsSTP");
+Statistic stats::queryPortfolioWinsZ3("QueryPortfolioWinsZ3", "QPwinsZ3");
 Statistic stats::queryTime("QueryTime", "Qtime");
 
 #ifdef KLEE_ARRAY_DEBUG
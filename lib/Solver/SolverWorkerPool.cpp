@@ -0,0 +1,272 @@
+//===-- SolverWorkerPool.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SolverWorkerPool.h"
+
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/Support/Errno.h"
+
+#include <cassert>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+// Sockets are written with MSG_NOSIGNAL, a dead peer must not raise SIGPIPE
+// in the executor.
+bool writeAll(int fd, const void *data, std::size_t size) {
+  auto bytes = static_cast<const char *>(data);
+  while (size) {
+    ssize_t n = ::send(fd, bytes, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    bytes += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool readAll(int fd, void *data, std::size_t size) {
+  auto bytes = static_cast<char *>(data);
+  while (size) {
+    ssize_t n = ::read(fd, bytes, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    bytes += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool writeMessage(int fd, const std::string &message) {
+  std::uint64_t size = message.size();
+  return writeAll(fd, &size, sizeof(size)) &&
+         writeAll(fd, message.data(), message.size());
+}
+
+bool readMessage(int fd, std::string &message) {
+  std::uint64_t size;
+  if (!readAll(fd, &size, sizeof(size)))
+    return false;
+  message.resize(size);
+  return readAll(fd, &message[0], size);
+}
+
+/// \return 1 if fd can be read, 0 on timeout, -1 on error
+int waitReadable(int fd, time::Span timeout) {
+  const time::Point deadline = time::getWallTime() + timeout;
+  while (true) {
+    int ms = -1;
+    if (timeout) {
+      const time::Point now = time::getWallTime();
+      ms = now < deadline ? (deadline - now).toMicroseconds() / 1000 : 0;
+    }
+    struct pollfd pfd = {fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, ms);
+    if (ready >= 0 || errno != EINTR)
+      return ready;
+  }
+}
+
+/// Send a worker to the pool, fd is passed as ancillary data. A pid of -1
+/// without a descriptor reports that the worker could not be started.
+bool sendWorker(int socket, pid_t pid, int fd) {
+  struct iovec iov = {&pid, sizeof(pid)};
+  struct msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  char control[CMSG_SPACE(sizeof(int))] = {};
+  if (fd != -1) {
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+  ssize_t n;
+  while ((n = sendmsg(socket, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+    ;
+  return n == sizeof(pid);
+}
+
+bool receiveWorker(int socket, pid_t &pid, int &fd) {
+  struct iovec iov = {&pid, sizeof(pid)};
+  struct msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  char control[CMSG_SPACE(sizeof(int))];
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t n;
+  while ((n = recvmsg(socket, &msg, 0)) < 0 && errno == EINTR)
+    ;
+  if (n != sizeof(pid) || pid == -1)
+    return false;
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS)
+    return false;
+  std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+  return true;
+}
+
+[[noreturn]] void runWorker(int fd, const SolverWorkerPool::Handler &handler) {
+  ::signal(SIGCHLD, SIG_DFL);
+  std::string request, reply;
+  while (readMessage(fd, request)) {
+    reply.clear();
+    char answered = handler(request, reply);
+    if (!writeAll(fd, &answered, 1) ||
+        (answered && !writeMessage(fd, reply)))
+      break;
+  }
+  _exit(0);
+}
+
+/// Forks a worker for every byte received on fd until the pool goes away.
+[[noreturn]] void runZygote(int fd, const SolverWorkerPool::Handler &handler) {
+  // the pool decides when workers stop, and they are reaped automatically
+  ::signal(SIGINT, SIG_IGN);
+  ::signal(SIGCHLD, SIG_IGN);
+  char request;
+  while (readAll(fd, &request, 1)) {
+    int fds[2];
+    pid_t pid = -1;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0) {
+      pid = fork();
+      if (pid == 0) {
+        close(fd);
+        close(fds[0]);
+        runWorker(fds[1], handler);
+      }
+      close(fds[1]);
+      if (pid == -1)
+        close(fds[0]);
+    }
+    bool sent = sendWorker(fd, pid, pid == -1 ? -1 : fds[0]);
+    if (pid != -1)
+      close(fds[0]);
+    if (!sent)
+      break;
+  }
+  _exit(0);
+}
+} // namespace
+
+SolverWorkerPool::SolverWorkerPool(Handler handler, unsigned maxQueries)
+    : handler(std::move(handler)), maxQueries(maxQueries), owner(getpid()) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+    klee_warning("socketpair failed (for solver workers) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return;
+  }
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid == -1) {
+    klee_warning("fork failed (for solver workers) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    close(fds[0]);
+    close(fds[1]);
+    return;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    runZygote(fds[1], this->handler);
+  }
+  close(fds[1]);
+  zygote = pid;
+  zygoteFd = fds[0];
+
+  // have a worker ready for the first query
+  spawn();
+}
+
+SolverWorkerPool::~SolverWorkerPool() {
+  if (!isOwner())
+    return;
+  for (auto &worker : idle)
+    retire(worker, false);
+  if (zygoteFd != -1) {
+    close(zygoteFd);
+    while (waitpid(zygote, nullptr, 0) < 0 && errno == EINTR)
+      ;
+  }
+}
+
+bool SolverWorkerPool::isOwner() const { return getpid() == owner; }
+
+bool SolverWorkerPool::spawn() {
+  if (zygoteFd == -1)
+    return false;
+  char request = 0;
+  pid_t pid;
+  int fd;
+  if (!writeAll(zygoteFd, &request, 1) || !receiveWorker(zygoteFd, pid, fd)) {
+    klee_warning("could not start a solver worker");
+    return false;
+  }
+  idle.push_back({pid, fd, 0});
+  return true;
+}
+
+void SolverWorkerPool::retire(Worker &worker, bool kill) {
+  // closing the socket ends a worker waiting for requests
+  if (kill)
+    ::kill(worker.pid, SIGKILL);
+  close(worker.fd);
+}
+
+SolverWorkerPool::Status SolverWorkerPool::run(const std::string &request,
+                                               std::string &reply,
+                                               time::Span timeout) {
+  assert(isOwner() && "solver workers used from a forked process");
+  if (idle.empty() && !spawn())
+    return Unavailable;
+  Worker worker = idle.back();
+  idle.pop_back();
+
+  if (!writeMessage(worker.fd, request)) {
+    retire(worker, true);
+    return Crashed;
+  }
+  int ready = waitReadable(worker.fd, timeout);
+  if (ready == 0) {
+    retire(worker, true);
+    return Timeout;
+  }
+  char answered;
+  if (ready < 0 || !readAll(worker.fd, &answered, 1) ||
+      (answered && !readMessage(worker.fd, reply))) {
+    retire(worker, true);
+    return Crashed;
+  }
+
+  if (maxQueries && ++worker.queries >= maxQueries)
+    retire(worker, false);
+  else
+    idle.push_back(worker);
+  return answered ? Success : Failed;
+}
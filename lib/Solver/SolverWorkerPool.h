@@ -0,0 +1,95 @@
+//===-- SolverWorkerPool.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SOLVERWORKERPOOL_H
+#define KLEE_SOLVERWORKERPOOL_H
+
+#include "klee/System/Time.h"
+
+#include <sys/types.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace klee {
+
+/// Long-lived worker processes that answer serialized solver queries.
+///
+/// Forking the executor for every query copies its page tables, which gets
+/// slower the more memory the executor holds. Instead, a small zygote
+/// process is forked once when the pool is created, and workers are forked
+/// from the zygote and handed to the pool over a UNIX socket. A worker
+/// answers queries until it crashes, times out or has answered a given
+/// number of them; it is then replaced by a fresh one, so a crashing solver
+/// never takes the executor down.
+///
+/// Requests and replies are arbitrary byte strings sent with their length,
+/// so results of any size can be returned.
+class SolverWorkerPool {
+public:
+  /// Computes the reply to a request inside a worker.
+  /// \return false if the request could not be answered
+  typedef std::function<bool(const std::string &request, std::string &reply)>
+      Handler;
+
+  enum Status {
+    Success,
+    /// The handler could not answer the request
+    Failed,
+    /// The worker was killed after the timeout
+    Timeout,
+    /// The worker died while answering the request
+    Crashed,
+    /// No worker could be started
+    Unavailable
+  };
+
+private:
+  struct Worker {
+    pid_t pid;
+    int fd;
+    unsigned queries;
+  };
+
+  Handler handler;
+  unsigned maxQueries;
+  /// The process that created the pool, processes forked from it must not
+  /// use the pool
+  pid_t owner;
+  pid_t zygote = -1;
+  int zygoteFd = -1;
+  std::vector<Worker> idle;
+
+  bool spawn();
+  void retire(Worker &worker, bool kill);
+
+public:
+  /// \param handler - Run in the workers on every request.
+  /// \param maxQueries - Number of queries after which a worker is
+  /// replaced, 0 for no limit.
+  SolverWorkerPool(Handler handler, unsigned maxQueries);
+  ~SolverWorkerPool();
+
+  SolverWorkerPool(const SolverWorkerPool &) = delete;
+  SolverWorkerPool &operator=(const SolverWorkerPool &) = delete;
+
+  /// Whether this process may use the pool. Processes forked from the
+  /// executor share its sockets and have to solve on their own.
+  bool isOwner() const;
+
+  /// Send request to a worker and wait for its reply.
+  /// \param timeout - How long to wait for the reply, none if zero.
+  Status run(const std::string &request, std::string &reply,
+             time::Span timeout);
+};
+
+} // namespace klee
+
+#endif /* KLEE_SOLVERWORKERPOOL_H */
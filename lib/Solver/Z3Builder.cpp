@@ -454,23 +454,40 @@ Z3ASTHandle Z3Builder::construct(ref<Expr> e, int *width_out) {
   if (!UseConstructHashZ3 || isa<ConstantExpr>(e)) {
     return constructActual(e, width_out);
   } else {
-    ExprHashMap<std::pair<Z3ASTHandle, unsigned> >::iterator it =
-        constructed.find(e);
+    ExprHashMap<ConstructedEntry>::iterator it = constructed.find(e);
     if (it != constructed.end()) {
       if (width_out)
-        *width_out = it->second.second;
-      return it->second.first;
+        *width_out = it->second.width;
+      if (constructCacheLimit)
+        constructedLRU.splice(constructedLRU.begin(), constructedLRU,
+                              it->second.lruPosition);
+      return it->second.ast;
     } else {
       int width;
       if (!width_out)
         width_out = &width;
       Z3ASTHandle res = constructActual(e, width_out);
-      constructed.insert(std::make_pair(e, std::make_pair(res, *width_out)));
+      ConstructedEntry entry{res, static_cast<unsigned>(*width_out), {}};
+      if (constructCacheLimit) {
+        while (constructed.size() >= constructCacheLimit) {
+          constructed.erase(constructedLRU.back());
+          constructedLRU.pop_back();
+        }
+        constructedLRU.push_front(e);
+        entry.lruPosition = constructedLRU.begin();
+      }
+      constructed.insert(std::make_pair(e, entry));
       return res;
     }
   }
 }
 
+void Z3Builder::setConstructCacheLimit(size_t limit) {
+  // the recency of existing entries is not known, start over
+  clearConstructCache();
+  constructCacheLimit = limit;
+}
+
 /** if *width_out!=1 then result is a bitvector,
     otherwise it is a bool */
 Z3ASTHandle Z3Builder::constructActual(ref<Expr> e, int *width_out) {
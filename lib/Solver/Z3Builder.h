@@ -14,6 +14,7 @@
 #include "klee/Expr/ArrayExprHash.h"
 #include "klee/Expr/ExprHashMap.h"
 
+#include <list>
 #include <unordered_map>
 #include <z3.h>
 #include <vector>
@@ -104,7 +105,17 @@ public:
 };
 
 class Z3Builder {
-  ExprHashMap<std::pair<Z3ASTHandle, unsigned> > constructed;
+  struct ConstructedEntry {
+    Z3ASTHandle ast;
+    unsigned width;
+    /// Position in constructedLRU, only valid when the cache is bounded
+    std::list<ref<Expr> >::iterator lruPosition;
+  };
+  ExprHashMap<ConstructedEntry> constructed;
+  /// Keys of constructed, most recently used first
+  std::list<ref<Expr> > constructedLRU;
+  /// Maximum number of entries in constructed, 0 means unbounded
+  size_t constructCacheLimit = 0;
   Z3ArrayExprHash _arr_hash;
 
 private:
@@ -189,7 +200,14 @@ public:
     return res;
   }
 
-  void clearConstructCache() { constructed.clear(); }
+  void clearConstructCache() {
+    constructed.clear();
+    constructedLRU.clear();
+  }
+
+  /// Bound the construct cache to the given number of expressions, the
+  /// least recently used ones are dropped first. 0 means unbounded.
+  void setConstructCacheLimit(size_t limit);
 };
 }
 
@@ -12,7 +12,9 @@
 #include "klee/Support/FileHandling.h"
 #include "klee/Support/OptionCategories.h"
 
+#include <algorithm>
 #include <csignal>
+#include <iterator>
 
 #ifdef ENABLE_Z3
 
@@ -59,7 +61,19 @@ namespace klee {
 
 class Z3SolverImpl : public SolverImpl {
 private:
+  /// A solver kept alive between queries. Every constraint it holds is
+  /// asserted in a scope of its own, so a later query sharing a prefix of
+  /// the constraints only pops the scopes past that prefix.
+  struct IncrementalSolver {
+    ::Z3_solver solver;
+    std::vector<ref<Expr> > asserted;
+    uint64_t lastUse;
+  };
+
   Z3Builder *builder;
+  unsigned maxIncrementalSolvers;
+  std::vector<IncrementalSolver> incrementalSolvers;
+  uint64_t incrementalQueries = 0;
   time::Span timeout;
   SolverRunStatus runStatusCode;
   std::unique_ptr<llvm::raw_fd_ostream> dumpedQueriesFile;
@@ -73,8 +87,11 @@ private:
                          bool needsModel);
   bool validateZ3Model(::Z3_solver &theSolver, ::Z3_model &theModel);
 
+  IncrementalSolver &getIncrementalSolver(const ConstraintSet &constraints);
+  void releaseIncrementalSolvers();
+
 public:
-  Z3SolverImpl();
+  Z3SolverImpl(unsigned incrementalSolvers, unsigned constructCacheSize);
   ~Z3SolverImpl();
 
   char *getConstraintLog(const Query &);
@@ -101,14 +118,18 @@ public:
   SolverRunStatus getOperationStatusCode();
 };
 
-Z3SolverImpl::Z3SolverImpl()
+Z3SolverImpl::Z3SolverImpl(unsigned incrementalSolvers,
+                           unsigned constructCacheSize)
     : builder(new Z3Builder(
           /*autoClearConstructCache=*/false,
           /*z3LogInteractionFileArg=*/Z3LogInteractionFile.size() > 0
               ? Z3LogInteractionFile.c_str()
               : NULL)),
+      maxIncrementalSolvers(incrementalSolvers),
       runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
   assert(builder && "unable to create Z3Builder");
+  if (maxIncrementalSolvers)
+    builder->setConstructCacheLimit(constructCacheSize);
   solverParameters = Z3_mk_params(builder->ctx);
   Z3_params_inc_ref(builder->ctx, solverParameters);
   timeoutParamStrSymbol = Z3_mk_string_symbol(builder->ctx, "timeout");
@@ -135,11 +156,13 @@ Z3SolverImpl::Z3SolverImpl()
 }
 
 Z3SolverImpl::~Z3SolverImpl() {
+  releaseIncrementalSolvers();
   Z3_params_dec_ref(builder->ctx, solverParameters);
   delete builder;
 }
 
-Z3Solver::Z3Solver() : Solver(new Z3SolverImpl()) {}
+Z3Solver::Z3Solver(unsigned incrementalSolvers, unsigned constructCacheSize)
+    : Solver(new Z3SolverImpl(incrementalSolvers, constructCacheSize)) {}
 
 char *Z3Solver::getConstraintLog(const Query &query) {
   return impl->getConstraintLog(query);
@@ -251,22 +274,44 @@ bool Z3SolverImpl::internalRunSolver(
     bool needsModel) {
 
   TimerStatIncrementer t(stats::queryTime);
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+
   // NOTE: Z3 will switch to using a slower solver internally if push/pop are
-  // used so for now it is likely that creating a new solver each time is the
-  // right way to go until Z3 changes its behaviour.
+  // used so by default we create a new solver for each query. The
+  // incremental mode pays that price to avoid translating and asserting
+  // the shared prefix of consecutive queries again.
   //
   // TODO: Investigate using a custom tactic as described in
   // https://github.com/klee/klee/issues/653
-  Z3_solver theSolver = Z3_mk_solver(builder->ctx);
-  Z3_solver_inc_ref(builder->ctx, theSolver);
-  Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
-
-  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
-
+  IncrementalSolver *incremental = nullptr;
+  Z3_solver theSolver;
   ConstantArrayFinder constant_arrays_in_query;
-  for (auto const &constraint : query.constraints) {
-    Z3_solver_assert(builder->ctx, theSolver, builder->construct(constraint));
-    constant_arrays_in_query.visit(constraint);
+  if (maxIncrementalSolvers) {
+    incremental = &getIncrementalSolver(query.constraints);
+    theSolver = incremental->solver;
+    Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+    // only constraints past the shared prefix are new to the solver
+    auto it = query.constraints.begin();
+    std::advance(it, incremental->asserted.size());
+    for (; it != query.constraints.end(); ++it) {
+      Z3_solver_push(builder->ctx, theSolver);
+      Z3_solver_assert(builder->ctx, theSolver, builder->construct(*it));
+      incremental->asserted.push_back(*it);
+    }
+    for (auto const &constraint : query.constraints)
+      constant_arrays_in_query.visit(constraint);
+    // the query expression and constant arrays go to a scope that is
+    // dropped right after the check
+    Z3_solver_push(builder->ctx, theSolver);
+  } else {
+    theSolver = Z3_mk_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, theSolver);
+    Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+
+    for (auto const &constraint : query.constraints) {
+      Z3_solver_assert(builder->ctx, theSolver, builder->construct(constraint));
+      constant_arrays_in_query.visit(constraint);
+    }
   }
   ++stats::queries;
   if (needsModel)
@@ -307,13 +352,25 @@ bool Z3SolverImpl::internalRunSolver(
   runStatusCode = handleSolverResponse(query, theSolver, satisfiable, result,
                                        hasSolution, needsModel);
 
-  Z3_solver_dec_ref(builder->ctx, theSolver);
-  // Clear the builder's cache to prevent memory usage exploding.
-  // By using ``autoClearConstructCache=false`` and clearning now
-  // we allow Z3_ast expressions to be shared from an entire
-  // ``Query`` rather than only sharing within a single call to
-  // ``builder->construct()``.
-  builder->clearConstructCache();
+  if (incremental) {
+    if (satisfiable == Z3_L_UNDEF) {
+      // do not trust a solver that gave up or was interrupted with later
+      // queries, start from scratch instead
+      Z3_solver_reset(builder->ctx, theSolver);
+      incremental->asserted.clear();
+    } else {
+      Z3_solver_pop(builder->ctx, theSolver, 1);
+    }
+  } else {
+    Z3_solver_dec_ref(builder->ctx, theSolver);
+    // Clear the builder's cache to prevent memory usage exploding.
+    // By using ``autoClearConstructCache=false`` and clearning now
+    // we allow Z3_ast expressions to be shared from an entire
+    // ``Query`` rather than only sharing within a single call to
+    // ``builder->construct()``.
+    // The incremental mode keeps the cache, it is bounded instead.
+    builder->clearConstructCache();
+  }
 
   if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
       runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
@@ -330,6 +387,60 @@ bool Z3SolverImpl::internalRunSolver(
   return false; // failed
 }
 
+Z3SolverImpl::IncrementalSolver &
+Z3SolverImpl::getIncrementalSolver(const ConstraintSet &constraints) {
+  // pick the solver sharing the longest prefix with the constraints, ties
+  // go to the most recently used one
+  IncrementalSolver *best = nullptr;
+  std::size_t bestPrefix = 0;
+  for (auto &candidate : incrementalSolvers) {
+    std::size_t prefix = 0;
+    auto it = constraints.begin();
+    while (prefix < candidate.asserted.size() && it != constraints.end() &&
+           candidate.asserted[prefix] == *it) {
+      ++prefix;
+      ++it;
+    }
+    if (!best || prefix > bestPrefix ||
+        (prefix == bestPrefix && candidate.lastUse > best->lastUse)) {
+      best = &candidate;
+      bestPrefix = prefix;
+    }
+  }
+
+  if (!best || (bestPrefix == 0 && !best->asserted.empty())) {
+    // an unrelated lineage, give it a solver of its own if there is room or
+    // recycle the least recently used one
+    if (incrementalSolvers.size() < maxIncrementalSolvers) {
+      ::Z3_solver solver = Z3_mk_solver(builder->ctx);
+      Z3_solver_inc_ref(builder->ctx, solver);
+      incrementalSolvers.push_back({solver, {}, 0});
+      best = &incrementalSolvers.back();
+    } else {
+      best = &*std::min_element(
+          incrementalSolvers.begin(), incrementalSolvers.end(),
+          [](const IncrementalSolver &a, const IncrementalSolver &b) {
+            return a.lastUse < b.lastUse;
+          });
+    }
+    bestPrefix = 0;
+  }
+
+  if (best->asserted.size() > bestPrefix) {
+    Z3_solver_pop(builder->ctx, best->solver,
+                  best->asserted.size() - bestPrefix);
+    best->asserted.resize(bestPrefix);
+  }
+  best->lastUse = ++incrementalQueries;
+  return *best;
+}
+
+void Z3SolverImpl::releaseIncrementalSolvers() {
+  for (auto &incremental : incrementalSolvers)
+    Z3_solver_dec_ref(builder->ctx, incremental.solver);
+  incrementalSolvers.clear();
+}
+
 class ModelVisitor : public ExprVisitor {
 private:
   Z3Builder *builder;
@@ -18,7 +18,14 @@ namespace klee {
 class Z3Solver : public Solver {
 public:
   /// Z3Solver - Construct a new Z3Solver.
-  Z3Solver();
+  ///
+  /// \param incrementalSolvers - The number of solvers kept between
+  /// queries, each holding the constraints of its last query in push/pop
+  /// scopes. 0 creates a fresh solver for every query.
+  /// \param constructCacheSize - The number of translated expressions
+  /// kept between queries when incrementalSolvers is non-zero, 0 means
+  /// unbounded.
+  Z3Solver(unsigned incrementalSolvers = 0, unsigned constructCacheSize = 0);
 
   /// Get the query in SMT-LIBv2 format.
   /// \return A C-style string. The caller is responsible for freeing this.
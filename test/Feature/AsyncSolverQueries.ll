@@ -0,0 +1,69 @@
+; RUN: %llvmas %s -o %t.bc
+; RUN: rm -rf %t.sync %t.async
+; RUN: %klee --output-dir=%t.sync %t.bc > %t.sync.log 2> %t.sync.err
+; RUN: %klee --output-dir=%t.async --async-solver-queries=2 %t.bc > %t.async.log 2> %t.async.err
+; RUN: FileCheck --input-file=%t.sync.err %s
+; RUN: FileCheck --input-file=%t.async.err %s
+; RUN: sort %t.sync.log > %t.sync.paths
+; RUN: sort %t.async.log > %t.async.paths
+; RUN: diff %t.sync.paths %t.async.paths
+
+; Every path prints which of the four symbolic bytes are above 100. With
+; the branch conditions solved in child processes, the same paths have to
+; be explored and a test case is generated for each of them. The last
+; branch is infeasible on every path and is decided without the core
+; solver once its cache has seen the contradiction.
+; CHECK: KLEE: done: completed paths = 16
+; CHECK: KLEE: done: partially completed paths = 0
+; CHECK: KLEE: done: generated tests = 16
+
+@.name = private unnamed_addr constant [2 x i8] c"b\00"
+@.fmt = private unnamed_addr constant [4 x i8] c"%u\0A\00"
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
+declare i32 @printf(i8*, ...)
+
+define i32 @main() {
+entry:
+  %buf = alloca [4 x i8]
+  %maskp = alloca i32
+  %bp = bitcast [4 x i8]* %buf to i8*
+  call void @klee_make_symbolic(i8* %bp, i64 4, i8* getelementptr ([2 x i8], [2 x i8]* @.name, i64 0, i64 0))
+  store i32 0, i32* %maskp
+  br label %loop
+
+loop:
+  %i = phi i64 [0, %entry], [%inc, %latch]
+  %bit = phi i32 [1, %entry], [%bit2, %latch]
+  %slot = getelementptr [4 x i8], [4 x i8]* %buf, i64 0, i64 %i
+  %v = load i8, i8* %slot
+  %big = icmp ugt i8 %v, 100
+  br i1 %big, label %set, label %latch
+
+set:
+  %mask = load i32, i32* %maskp
+  %mask1 = or i32 %mask, %bit
+  store i32 %mask1, i32* %maskp
+  br label %latch
+
+latch:
+  %bit2 = add i32 %bit, %bit
+  %inc = add i64 %i, 1
+  %done = icmp eq i64 %inc, 4
+  br i1 %done, label %check, label %loop
+
+check:
+  %first = load i8, i8* %bp
+  %small = icmp ult i8 %first, 50
+  %large = icmp ugt i8 %first, 200
+  %both = and i1 %small, %large
+  br i1 %both, label %impossible, label %exit
+
+impossible:
+  unreachable
+
+exit:
+  %final = load i32, i32* %maskp
+  %call = call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @.fmt, i64 0, i64 0), i32 %final)
+  ret i32 0
+}
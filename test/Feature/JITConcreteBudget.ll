@@ -0,0 +1,29 @@
+; RUN: %llvmas %s -o %t.bc
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --jit-concrete-functions --jit-concrete-budget=1000 --max-instructions=5000 -optimize=false %t.bc 2>&1 | FileCheck %s
+
+; spin(0) never returns. The native call gives up after 1000 basic blocks
+; and the call is interpreted, where -max-instructions stops it.
+; CHECK: KLEE: WARNING ONCE: spin did not finish natively within 1000 basic blocks, it is interpreted from now on
+; CHECK: KLEE: done: total instructions = 5000
+; CHECK: KLEE: done: completed paths = 0
+
+define i32 @spin(i32 %x) {
+entry:
+  br label %loop
+
+loop:
+  %v = phi i32 [ %x, %entry ], [ %m, %loop ]
+  %m = mul i32 %v, 3
+  %done = icmp eq i32 %m, 1
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %m
+}
+
+define i32 @main() {
+entry:
+  %r = call i32 @spin(i32 0)
+  ret i32 %r
+}
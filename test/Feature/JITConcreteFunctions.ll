@@ -0,0 +1,106 @@
+; RUN: %llvmas %s -o %t.bc
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --jit-concrete-functions --check-div-zero=false -optimize=false %t.bc 2>&1 | FileCheck %s
+; RUN: %klee-stats --table-format=csv --print-columns 'Instrs,ICovered,IUncovered' %t.klee-out | FileCheck --check-prefix=CHECK-STATS %s
+
+; Both calls of hash and the call of clamp run natively, take no
+; interpreted instructions and compute the value the interpreter does. The call of round on a symbolic
+; value and the call of divide, which may trap natively, are interpreted.
+; CHECK: KLEE: ERROR: {{.*}}abort failure
+; CHECK: KLEE: done: total instructions = {{[1-9][0-9]$}}
+; CHECK: KLEE: done: completed paths = 1
+; CHECK: KLEE: done: partially completed paths = 1
+
+; The instructions of the blocks that ran natively are covered as if they
+; were interpreted, but are not counted. The block of clamp that never ran
+; stays uncovered.
+; CHECK-STATS: Instrs,ICovered,IUncovered
+; CHECK-STATS-NEXT: {{[1-9][0-9]}},42,2
+
+@.name = private unnamed_addr constant [2 x i8] c"x\00"
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
+declare void @abort() noreturn nounwind
+
+; mixes %n rounds like a hash function, with -O0 style stack slots
+define i32 @hash(i32 %seed, i32 %n) {
+entry:
+  %h = alloca i32
+  %i = alloca i32
+  store i32 %seed, i32* %h
+  store i32 0, i32* %i
+  br label %loop
+
+loop:
+  %iv = load i32, i32* %i
+  %done = icmp eq i32 %iv, %n
+  br i1 %done, label %exit, label %body
+
+body:
+  %hv = load i32, i32* %h
+  %m = mul i32 %hv, 16777619
+  %s = lshr i32 %m, 13
+  %x = xor i32 %m, %s
+  %r = call i32 @round(i32 %x, i32 %iv)
+  store i32 %r, i32* %h
+  %inc = add i32 %iv, 1
+  store i32 %inc, i32* %i
+  br label %loop
+
+exit:
+  %result = load i32, i32* %h
+  ret i32 %result
+}
+
+define i32 @round(i32 %x, i32 %k) {
+  %a = add i32 %x, %k
+  %b = urem i32 %a, 1000003
+  ret i32 %b
+}
+
+define i32 @clamp(i32 %x) {
+entry:
+  %big = icmp ugt i32 %x, 1000
+  br i1 %big, label %cut, label %keep
+
+cut:
+  %r = call i32 @round(i32 %x, i32 0)
+  ret i32 %r
+
+keep:
+  ret i32 %x
+}
+
+define i32 @divide(i32 %a, i32 %b) {
+  %q = udiv i32 %a, %b
+  ret i32 %q
+}
+
+define i32 @main() {
+entry:
+  %x = alloca i32
+  %v = call i32 @hash(i32 2166136261, i32 200000)
+  %n = call i32 @clamp(i32 0)
+  %w = call i32 @hash(i32 %v, i32 %n)
+  %same = icmp eq i32 %w, 151544
+  br i1 %same, label %symbolic, label %unreachable
+
+symbolic:
+  %xp = bitcast i32* %x to i8*
+  call void @klee_make_symbolic(i8* %xp, i64 4, i8* getelementptr ([2 x i8], [2 x i8]* @.name, i64 0, i64 0))
+  %xv = load i32, i32* %x
+  %y = call i32 @round(i32 %xv, i32 1)
+  %d = call i32 @divide(i32 %v, i32 7)
+  %big = icmp ugt i32 %y, %d
+  br i1 %big, label %fail, label %exit
+
+exit:
+  ret i32 0
+
+fail:
+  call void @abort()
+  unreachable
+
+unreachable:
+  unreachable
+}
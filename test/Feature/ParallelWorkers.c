@@ -0,0 +1,52 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --parallel-workers=3 %t.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out | FileCheck --check-prefix=CHECK-FILES %s
+// RUN: %klee-stats --print-columns 'ICov(%),BCov(%)' --table-format=csv %t.klee-out | FileCheck --check-prefix=CHECK-STATS %s
+// RUN: not %klee --output-dir=%t.klee-out-one --parallel-workers=1 %t.bc 2>&1 | FileCheck --check-prefix=CHECK-ONE %s
+
+// The workers explore disjoint subtrees, so together they find each path
+// exactly once.
+// CHECK: KLEE: done: completed paths = 24
+// CHECK: KLEE: done: generated tests = 24
+
+// CHECK-FILES-DAG: run.istats
+// CHECK-FILES-DAG: run.stats
+// CHECK-FILES-DAG: test000001.ktest
+// CHECK-FILES-DAG: test000024.ktest
+// CHECK-FILES-NOT: test000025.ktest
+// CHECK-FILES-DAG: worker-0
+// CHECK-FILES-DAG: worker-2
+
+// The statistics of the workers are merged, together they cover the whole
+// program.
+// CHECK-STATS: 100.00,100.00
+
+// CHECK-ONE: --parallel-workers needs at least 2 workers
+
+#include "klee/klee.h"
+
+int main() {
+  int res = 1;
+  unsigned x, y;
+
+  klee_make_symbolic(&x, sizeof x, "x");
+  klee_make_symbolic(&y, sizeof y, "y");
+
+  if (x & 1) res *= 2;
+  if (x & 2) res *= 3;
+  if (x & 4) res *= 5;
+
+  switch (y % 3) {
+  case 0:
+    res += 1;
+    break;
+  case 1:
+    res += 2;
+    break;
+  default:
+    res += 3;
+  }
+
+  return res;
+}
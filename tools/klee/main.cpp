@@ -50,13 +50,17 @@
 
 
 #include <dirent.h>
+#include <poll.h>
 #include <signal.h>
+#include <sqlite3.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <ctime>
+#include <deque>
 #include <fstream>
 #include <iomanip>
 #include <iterator>
@@ -194,6 +198,21 @@ namespace {
                    cl::cat(StartCat));
   
 
+  /*** Parallel exploration options ***/
+
+  cl::OptionCategory ParallelCat("Parallel exploration options",
+                                 "These options control exploring the program with several processes.");
+
+  cl::opt<unsigned>
+  ParallelWorkers("parallel-workers",
+                  cl::desc("Explore the program with the given number of worker processes, each with its own solver. "
+                           "Idle workers take over pending states of busy ones by replaying their paths, "
+                           "the test cases and statistics of all workers are collected in the output directory. "
+                           "Needs at least 2 workers (default=0 (off))"),
+                  cl::init(0),
+                  cl::cat(ParallelCat));
+
+
   /*** Linking options ***/
 
   cl::OptionCategory LinkCat("Linking options",
@@ -337,6 +356,93 @@ class ExecutionState;
 
 /***/
 
+// Pipes of a worker process of a parallel exploration, the coordinator
+// sends commands and receives replies. Both are -1 outside of workers.
+static int workerCommandFd = -1;
+static int workerReplyFd = -1;
+
+static bool isParallelWorker() { return workerReplyFd >= 0; }
+
+// Messages between the coordinator and the workers are single lines.
+static void sendMessage(int fd, const std::string &message) {
+  std::string line = message + '\n';
+  const char *data = line.data();
+  size_t left = line.size();
+  while (left) {
+    ssize_t written = write(fd, data, left);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      klee_warning("cannot send message to %s: %s",
+                   isParallelWorker() ? "coordinator" : "worker",
+                   strerror(errno));
+      return;
+    }
+    data += written;
+    left -= written;
+  }
+}
+
+namespace {
+class MessageReader {
+  int fd;
+  std::string buffer;
+
+public:
+  explicit MessageReader(int fd) : fd(fd) {}
+
+  int getFd() const { return fd; }
+
+  /// Read the available input once, returns false at the end of input.
+  bool fill() {
+    char chunk[4096];
+    ssize_t count;
+    do {
+      count = read(fd, chunk, sizeof(chunk));
+    } while (count < 0 && errno == EINTR);
+    if (count <= 0)
+      return false;
+    buffer.append(chunk, count);
+    return true;
+  }
+
+  /// Take the next complete message out of the buffered input.
+  bool next(std::string &message) {
+    auto end = buffer.find('\n');
+    if (end == std::string::npos)
+      return false;
+    message = buffer.substr(0, end);
+    buffer.erase(0, end + 1);
+    return true;
+  }
+
+  /// Block until a message arrives, returns false at the end of input.
+  bool receive(std::string &message) {
+    while (!next(message))
+      if (!fill())
+        return false;
+    return true;
+  }
+};
+} // namespace
+
+// Paths are sent as "path <branches>" with a '0' or '1' for each branch.
+static std::string encodePath(const std::vector<bool> &path) {
+  std::string message = "path ";
+  for (bool branch : path)
+    message += branch ? '1' : '0';
+  return message;
+}
+
+static bool decodePath(const std::string &message, std::vector<bool> &path) {
+  if (message.compare(0, 5, "path ") != 0)
+    return false;
+  path.clear();
+  for (auto it = message.begin() + 5, ie = message.end(); it != ie; ++it)
+    path.push_back(*it == '1');
+  return true;
+}
+
 class KleeHandler : public InterpreterHandler {
 private:
   Interpreter *m_interpreter;
@@ -378,6 +484,8 @@ public:
                        const char *errorMessage,
                        const char *errorSuffix);
 
+  void processDonatedPath(const std::vector<bool> *path);
+
   std::string getOutputFilename(const std::string &filename);
   std::unique_ptr<llvm::raw_fd_ostream> openOutputFile(const std::string &filename);
   std::string getTestFilename(const std::string &suffix, unsigned id);
@@ -475,12 +583,15 @@ KleeHandler::~KleeHandler() {
   delete m_symPathWriter;
   fclose(klee_warning_file);
   fclose(klee_message_file);
+  klee_warning_file = nullptr;
+  klee_message_file = nullptr;
 }
 
 void KleeHandler::setInterpreter(Interpreter *i) {
   m_interpreter = i;
 
-  if (WritePaths) {
+  // workers of a parallel exploration give away states by their paths
+  if (WritePaths || isParallelWorker()) {
     m_pathWriter = new TreeStreamWriter(getOutputFilename("paths.ts"));
     assert(m_pathWriter->good());
     m_interpreter->setPathWriter(m_pathWriter);
@@ -493,6 +604,11 @@ void KleeHandler::setInterpreter(Interpreter *i) {
   }
 }
 
+void KleeHandler::processDonatedPath(const std::vector<bool> *path) {
+  if (isParallelWorker())
+    sendMessage(workerReplyFd, path ? encodePath(*path) : "none");
+}
+
 std::string KleeHandler::getOutputFilename(const std::string &filename) {
   SmallString<128> path = m_outputDirectory;
   sys::path::append(path,filename);
@@ -874,7 +990,7 @@ void KleeHandler::processTestCase(const ExecutionState &state,
       }
     }
 
-    if (m_pathWriter) {
+    if (WritePaths) {
       std::vector<unsigned char> concreteBranches;
       m_pathWriter->readStream(m_interpreter->getPathStreamID(state),
                                concreteBranches);
@@ -1415,6 +1531,684 @@ static void halt_via_gdb(int pid) {
     perror("system");
 }
 
+/// A worker process of a parallel exploration as seen by the coordinator.
+struct ParallelWorker {
+  enum class Status { Busy, Idle, Stopping, Finished };
+
+  pid_t pid = 0;
+  int commandFd = -1;
+  MessageReader replies{-1};
+  Status status = Status::Busy;
+  bool exitSent = false;
+  bool done = false;
+
+  // totals reported by the worker when it is done
+  uint64_t instructions = 0;
+  unsigned pathsCompleted = 0;
+  unsigned pathsExplored = 0;
+  unsigned testCases = 0;
+};
+
+static std::vector<ParallelWorker> parallelWorkers;
+
+static std::string getWorkerDirectoryName(unsigned id) {
+  return "worker-" + std::to_string(id);
+}
+
+static void donation_handle(int) {
+  if (theInterpreter)
+    theInterpreter->requestPathDonation();
+}
+
+static void interrupt_handle_coordinator() {
+  if (!interrupted) {
+    llvm::errs() << "KLEE: ctrl-c detected, requesting workers to halt.\n";
+    sys::SetInterruptFunction(interrupt_handle_coordinator);
+  } else {
+    llvm::errs() << "KLEE: ctrl-c detected, exiting.\n";
+    for (const auto &worker : parallelWorkers)
+      if (worker.status != ParallelWorker::Status::Finished)
+        kill(worker.pid, SIGKILL);
+    exit(1);
+  }
+  interrupted = true;
+}
+
+/// Start the worker processes of a parallel exploration.
+/// \return the id of the worker in the workers, -1 in the coordinator
+static int forkWorkers(unsigned count) {
+  // buffered output would be written by the workers as well
+  fflush(nullptr);
+  llvm::errs().flush();
+  llvm::outs().flush();
+
+  for (unsigned id = 0; id < count; ++id) {
+    int commands[2], replies[2];
+    if (pipe(commands) < 0 || pipe(replies) < 0)
+      klee_error("unable to create pipes for worker: %s", strerror(errno));
+
+    pid_t pid = fork();
+    if (pid < 0)
+      klee_error("unable to fork worker: %s", strerror(errno));
+
+    if (pid == 0) {
+      close(commands[1]);
+      close(replies[0]);
+      for (const auto &worker : parallelWorkers) {
+        close(worker.commandFd);
+        close(worker.replies.getFd());
+      }
+      parallelWorkers.clear();
+      workerCommandFd = commands[0];
+      workerReplyFd = replies[1];
+
+      // interrupts reach the workers through the coordinator only
+      setpgid(0, 0);
+      signal(SIGUSR1, donation_handle);
+      return id;
+    }
+
+    close(commands[0]);
+    close(replies[1]);
+    ParallelWorker worker;
+    worker.pid = pid;
+    worker.commandFd = commands[1];
+    worker.replies = MessageReader(replies[0]);
+    parallelWorkers.push_back(std::move(worker));
+  }
+  return -1;
+}
+
+/// Explore the subtrees handed out by the coordinator until it lets the
+/// worker exit.
+static void runWorker(Interpreter *interpreter, unsigned id, Function *mainFn,
+                      int argc, char **argv, char **envp) {
+  MessageReader commands(workerCommandFd);
+  std::vector<bool> prefix;
+
+  // the first worker starts the exploration, the others wait for states
+  // given away by busy workers
+  bool hasWork = id == 0;
+  while (!interrupted) {
+    if (hasWork) {
+      // --max-time applies to each run, the coordinator limits the total
+      interpreter->setHaltExecution(false);
+      interpreter->setPathPrefix(&prefix);
+      interpreter->runFunctionAsMain(mainFn, argc, argv, envp);
+      interpreter->setPathPrefix(nullptr);
+      if (interrupted)
+        break;
+    }
+
+    sendMessage(workerReplyFd, "idle");
+    std::string command;
+    if (!commands.receive(command) || !decodePath(command, prefix))
+      break;
+    hasWork = true;
+  }
+}
+
+/// Hand the states given away by busy workers to idle ones until all of
+/// them are idle, then let them exit.
+static void coordinateWorkers() {
+  typedef ParallelWorker::Status Status;
+
+  std::deque<std::string> pendingPaths;
+  const time::Span maxTime(MaxTime);
+  const auto startTime = time::getWallTime();
+  bool stopping = false;
+
+  // only one worker at a time is asked to give away a state; a request
+  // that reaches a worker before its interpreter exists is never answered
+  ParallelWorker *donor = nullptr;
+  time::Point donorDeadline;
+  unsigned nextDonor = 0;
+
+  auto release = [](ParallelWorker &worker) {
+    if (!worker.exitSent) {
+      sendMessage(worker.commandFd, "exit");
+      worker.exitSent = true;
+    }
+    worker.status = Status::Stopping;
+  };
+
+  for (;;) {
+    if (!stopping && (interrupted || (maxTime && time::getWallTime() -
+                                                     startTime > maxTime))) {
+      stopping = true;
+      for (auto &worker : parallelWorkers) {
+        if (worker.status == Status::Busy) {
+          kill(worker.pid, SIGINT);
+          worker.status = Status::Stopping;
+        } else if (worker.status == Status::Idle) {
+          release(worker);
+        }
+      }
+    }
+
+    if (donor && time::getWallTime() > donorDeadline)
+      donor = nullptr;
+
+    unsigned busy = 0, idle = 0, running = 0;
+    for (auto &worker : parallelWorkers) {
+      if (worker.status == Status::Idle && !pendingPaths.empty()) {
+        sendMessage(worker.commandFd, pendingPaths.front());
+        pendingPaths.pop_front();
+        worker.status = Status::Busy;
+      }
+      busy += worker.status == Status::Busy;
+      idle += worker.status == Status::Idle;
+      running += worker.status != Status::Finished;
+    }
+    if (!running)
+      break;
+
+    if (!stopping && !busy && !donor) {
+      // every state has been explored
+      stopping = true;
+      for (auto &worker : parallelWorkers)
+        if (worker.status == Status::Idle)
+          release(worker);
+    } else if (!stopping && idle && busy && !donor) {
+      for (unsigned i = 0, e = parallelWorkers.size(); i < e; ++i) {
+        unsigned index = (nextDonor + i) % e;
+        if (parallelWorkers[index].status == Status::Busy) {
+          donor = &parallelWorkers[index];
+          donorDeadline = time::getWallTime() + time::seconds(1);
+          nextDonor = index + 1;
+          kill(donor->pid, SIGUSR1);
+          break;
+        }
+      }
+    }
+
+    std::vector<pollfd> fds;
+    std::vector<ParallelWorker *> polled;
+    for (auto &worker : parallelWorkers) {
+      if (worker.status == Status::Finished)
+        continue;
+      fds.push_back({worker.replies.getFd(), POLLIN, 0});
+      polled.push_back(&worker);
+    }
+    // busy workers without a state to spare are asked again after a while
+    int timeout = !donor && idle && busy ? 10 : 100;
+    if (poll(fds.data(), fds.size(), timeout) < 0) {
+      if (errno == EINTR)
+        continue;
+      klee_error("unable to wait for workers: %s", strerror(errno));
+    }
+
+    for (unsigned i = 0; i < fds.size(); ++i) {
+      if (!fds[i].revents)
+        continue;
+      ParallelWorker &worker = *polled[i];
+
+      std::string message;
+      bool open = worker.replies.fill();
+      while (worker.replies.next(message)) {
+        if (message == "idle") {
+          if (worker.status == Status::Stopping)
+            release(worker);
+          else
+            worker.status = Status::Idle;
+          if (donor == &worker)
+            donor = nullptr;
+        } else if (message == "none") {
+          if (donor == &worker)
+            donor = nullptr;
+        } else if (message.compare(0, 5, "path ") == 0) {
+          if (donor == &worker)
+            donor = nullptr;
+          pendingPaths.push_back(message);
+        } else if (message.compare(0, 5, "done ") == 0) {
+          std::istringstream totals(message.substr(5));
+          totals >> worker.instructions >> worker.pathsCompleted >>
+              worker.pathsExplored >> worker.testCases;
+          worker.done = true;
+        }
+      }
+
+      if (!open) {
+        if (!worker.done)
+          klee_warning("worker %d exited unexpectedly, its states are lost",
+                       (int)(&worker - parallelWorkers.data()));
+        close(worker.commandFd);
+        close(worker.replies.getFd());
+        worker.status = Status::Finished;
+        if (donor == &worker)
+          donor = nullptr;
+      }
+    }
+  }
+
+  if (!pendingPaths.empty())
+    klee_warning("%zu states given away by workers were not explored",
+                 pendingPaths.size());
+
+  for (const auto &worker : parallelWorkers)
+    waitpid(worker.pid, nullptr, 0);
+}
+
+/// Move the test cases of the workers into the output directory and number
+/// them consecutively.
+static void collectTestCases(KleeHandler &handler) {
+  unsigned nextID = 0;
+  for (unsigned i = 0; i < parallelWorkers.size(); ++i) {
+    std::string directory = handler.getOutputFilename(getWorkerDirectoryName(i));
+
+    // suffixes of the files of each test case
+    std::map<unsigned, std::vector<std::string>> testCases;
+    std::error_code ec;
+    llvm::sys::fs::directory_iterator it(directory, ec), ie;
+    for (; it != ie && !ec; it.increment(ec)) {
+      std::string name = sys::path::filename(it->path()).str();
+      size_t dot = name.find('.');
+      unsigned id;
+      if (name.compare(0, 4, "test") != 0 || dot == std::string::npos ||
+          StringRef(name).substr(4, dot - 4).getAsInteger(10, id))
+        continue;
+      testCases[id].push_back(name.substr(dot + 1));
+    }
+    if (ec)
+      klee_warning("unable to read worker directory %s: %s",
+                   directory.c_str(), ec.message().c_str());
+
+    for (const auto &testCase : testCases) {
+      ++nextID;
+      for (const auto &suffix : testCase.second) {
+        SmallString<128> from(directory);
+        sys::path::append(from, handler.getTestFilename(suffix, testCase.first));
+        std::string to =
+            handler.getOutputFilename(handler.getTestFilename(suffix, nextID));
+        if (rename(from.c_str(), to.c_str()) < 0)
+          klee_warning("unable to move %s: %s", from.c_str(), strerror(errno));
+      }
+    }
+  }
+}
+
+/// The costs of one instruction in run.istats and of the calls it made.
+struct IStatsPosition {
+  struct Call {
+    std::string callee;   // cfl= and cfn= lines
+    uint64_t count = 0;
+    std::string position; // instr and line of the callee
+    std::vector<uint64_t> costs;
+  };
+
+  std::string context;    // fl= and fn= lines in front of the instruction
+  std::string position;   // instr and line of the instruction
+  std::vector<uint64_t> costs;
+  std::vector<Call> calls;
+};
+
+struct IStatsFile {
+  std::vector<std::string> header;
+  std::vector<std::string> events;
+  std::vector<IStatsPosition> positions;
+};
+
+/// Coverage of the program by all workers together.
+struct ParallelCoverage {
+  uint64_t coveredInstructions = 0;
+  uint64_t fullBranches = 0;
+  uint64_t partialBranches = 0;
+};
+
+static bool parseIStatsCosts(const std::string &line, unsigned count,
+                             std::string &position,
+                             std::vector<uint64_t> &costs) {
+  std::istringstream in(line);
+  std::string instr, source;
+  if (!(in >> instr >> source))
+    return false;
+  position = instr + " " + source;
+  costs.resize(count);
+  for (auto &cost : costs)
+    if (!(in >> cost))
+      return false;
+  return true;
+}
+
+static bool readIStats(const std::string &path, IStatsFile &file) {
+  std::ifstream in(path);
+  if (!in)
+    return false;
+
+  std::string line;
+  while (std::getline(in, line)) {
+    file.header.push_back(line);
+    if (line.compare(0, 8, "events: ") == 0) {
+      std::istringstream names(line.substr(8));
+      std::string name;
+      while (names >> name)
+        file.events.push_back(name);
+    } else if (line.compare(0, 3, "ob=") == 0) {
+      break;
+    }
+  }
+
+  std::string context, callee;
+  while (std::getline(in, line)) {
+    if (line.empty())
+      continue;
+    if (line.compare(0, 3, "fl=") == 0 || line.compare(0, 3, "fn=") == 0) {
+      context += line + '\n';
+    } else if (line.compare(0, 4, "cfl=") == 0 ||
+               line.compare(0, 4, "cfn=") == 0) {
+      callee += line + '\n';
+    } else if (line.compare(0, 6, "calls=") == 0) {
+      if (file.positions.empty())
+        return false;
+      IStatsPosition::Call call;
+      std::istringstream target(line.substr(6));
+      std::string instr, source, costs, position;
+      if (!(target >> call.count >> instr >> source) ||
+          !std::getline(in, costs) ||
+          !parseIStatsCosts(costs, file.events.size(), position, call.costs))
+        return false;
+      call.callee = std::move(callee);
+      call.position = instr + " " + source;
+      callee.clear();
+      file.positions.back().calls.push_back(std::move(call));
+    } else {
+      IStatsPosition position;
+      if (!parseIStatsCosts(line, file.events.size(), position.position,
+                            position.costs))
+        return false;
+      position.context = std::move(context);
+      context.clear();
+      file.positions.push_back(std::move(position));
+    }
+  }
+  return !file.events.empty();
+}
+
+/// Add the costs of a worker to the merged ones. Coverage flags are set if
+/// any worker covered the instruction, distances are the shortest one.
+static void mergeIStatsCosts(const std::vector<std::string> &events,
+                             std::vector<uint64_t> &merged,
+                             const std::vector<uint64_t> &costs) {
+  for (unsigned i = 0; i < events.size(); ++i) {
+    const std::string &event = events[i];
+    if (event == "Icov" || event == "Bt" || event == "Bf")
+      merged[i] = std::max(merged[i], costs[i]);
+    else if (event == "Iuncov" || event == "UCdist")
+      merged[i] = std::min(merged[i], costs[i]);
+    else
+      merged[i] += costs[i];
+  }
+}
+
+/// Merge the run.istats of the workers into the output directory.
+/// \return false if the files of the workers are missing or do not match
+static bool mergeIStats(KleeHandler &handler, ParallelCoverage &coverage) {
+  IStatsFile merged;
+  for (unsigned i = 0; i < parallelWorkers.size(); ++i) {
+    SmallString<128> path(handler.getOutputFilename(getWorkerDirectoryName(i)));
+    sys::path::append(path, "run.istats");
+
+    IStatsFile file;
+    if (!readIStats(path.str().str(), file))
+      return false;
+    if (i == 0) {
+      merged = std::move(file);
+      continue;
+    }
+
+    // all workers run the same module, so their files list the same
+    // instructions in the same order
+    if (file.events != merged.events ||
+        file.positions.size() != merged.positions.size())
+      return false;
+    for (unsigned j = 0; j < file.positions.size(); ++j) {
+      IStatsPosition &into = merged.positions[j];
+      const IStatsPosition &from = file.positions[j];
+      if (from.position != into.position)
+        return false;
+      mergeIStatsCosts(merged.events, into.costs, from.costs);
+
+      for (const auto &call : from.calls) {
+        auto it = std::find_if(into.calls.begin(), into.calls.end(),
+                               [&call](const IStatsPosition::Call &c) {
+                                 return c.callee == call.callee &&
+                                        c.position == call.position;
+                               });
+        if (it == into.calls.end()) {
+          into.calls.push_back(call);
+        } else {
+          it->count += call.count;
+          mergeIStatsCosts(merged.events, it->costs, call.costs);
+        }
+      }
+    }
+  }
+  if (merged.positions.empty())
+    return false;
+
+  auto of = handler.openOutputFile("run.istats");
+  if (!of)
+    return false;
+
+  for (const auto &line : merged.header) {
+    if (line.compare(0, 5, "pid: ") == 0)
+      *of << "pid: " << getpid() << '\n';
+    else
+      *of << line << '\n';
+  }
+
+  auto find = [&merged](const char *event) {
+    return std::find(merged.events.begin(), merged.events.end(), event) -
+           merged.events.begin();
+  };
+  unsigned covered = find("Icov"), trueBranches = find("Bt"),
+           falseBranches = find("Bf");
+
+  for (const auto &position : merged.positions) {
+    *of << position.context << position.position;
+    for (auto cost : position.costs)
+      *of << ' ' << cost;
+    *of << '\n';
+    for (const auto &call : position.calls) {
+      *of << call.callee << "calls=" << call.count << ' ' << call.position
+          << '\n'
+          << position.position;
+      for (auto cost : call.costs)
+        *of << ' ' << cost;
+      *of << '\n';
+    }
+
+    if (covered < merged.events.size() && position.costs[covered])
+      ++coverage.coveredInstructions;
+    if (trueBranches < merged.events.size() &&
+        falseBranches < merged.events.size()) {
+      bool hasTrue = position.costs[trueBranches];
+      bool hasFalse = position.costs[falseBranches];
+      if (hasTrue && hasFalse)
+        ++coverage.fullBranches;
+      else if (hasTrue || hasFalse)
+        ++coverage.partialBranches;
+    }
+  }
+  return true;
+}
+
+/// Merge the last line of the run.stats of each worker into the run.stats
+/// of the output directory. Counters are summed, the coverage is taken from
+/// the merged run.istats if there is one.
+static void mergeStats(KleeHandler &handler,
+                       const ParallelCoverage *coverage) {
+  std::string schema;
+  std::vector<std::string> columns;
+  std::vector<int64_t> values;
+
+  for (unsigned i = 0; i < parallelWorkers.size(); ++i) {
+    SmallString<128> path(handler.getOutputFilename(getWorkerDirectoryName(i)));
+    sys::path::append(path, "run.stats");
+    if (!sys::fs::exists(path))
+      return;
+
+    sqlite3 *db;
+    if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) !=
+        SQLITE_OK) {
+      klee_warning("unable to open %s: %s", path.c_str(), sqlite3_errmsg(db));
+      sqlite3_close(db);
+      return;
+    }
+
+    sqlite3_stmt *stmt;
+    if (i == 0) {
+      if (sqlite3_prepare_v2(db,
+                             "SELECT sql FROM sqlite_master "
+                             "WHERE type = 'table' AND name = 'stats'",
+                             -1, &stmt, nullptr) == SQLITE_OK &&
+          sqlite3_step(stmt) == SQLITE_ROW)
+        schema = (const char *)sqlite3_column_text(stmt, 0);
+      sqlite3_finalize(stmt);
+    }
+
+    bool read = false;
+    if (sqlite3_prepare_v2(db, "SELECT * FROM stats ORDER BY rowid DESC LIMIT 1",
+                           -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+      unsigned count = sqlite3_column_count(stmt);
+      if (i == 0) {
+        for (unsigned j = 0; j < count; ++j)
+          columns.push_back(sqlite3_column_name(stmt, j));
+        values.assign(count, 0);
+      }
+      read = count == columns.size();
+      for (unsigned j = 0; read && j < count; ++j) {
+        const std::string &column = columns[j];
+        int64_t value = sqlite3_column_int64(stmt, j);
+        if (i == 0 || values[j] < 0)
+          values[j] = value;
+        else if (value < 0)
+          values[j] = value; // not recorded
+        else if (column == "WallTime" || column == "NumBranches" ||
+                 column == "CoveredInstructions" ||
+                 column == "UncoveredInstructions" ||
+                 column == "FullBranches" || column == "PartialBranches")
+          values[j] = std::max(values[j], value);
+        else
+          values[j] += value;
+      }
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+
+    if (!read || schema.empty()) {
+      klee_warning("unable to read %s", path.c_str());
+      return;
+    }
+  }
+
+  auto column = [&columns](const char *name) {
+    return std::find(columns.begin(), columns.end(), name) - columns.begin();
+  };
+  if (coverage) {
+    unsigned covered = column("CoveredInstructions"),
+             uncovered = column("UncoveredInstructions");
+    if (covered < columns.size() && uncovered < columns.size()) {
+      // each worker knows all instructions of the program
+      int64_t instructions = values[covered] + values[uncovered];
+      values[covered] = coverage->coveredInstructions;
+      values[uncovered] = instructions - coverage->coveredInstructions;
+    }
+    unsigned full = column("FullBranches"), partial = column("PartialBranches");
+    if (full < columns.size() && partial < columns.size()) {
+      values[full] = coverage->fullBranches;
+      values[partial] = coverage->partialBranches;
+    }
+  }
+
+  std::string path = handler.getOutputFilename("run.stats");
+  std::string insert = "INSERT INTO stats VALUES (";
+  for (unsigned j = 0; j < columns.size(); ++j)
+    insert += j ? ",?" : "?";
+  insert += ")";
+
+  sqlite3 *db;
+  sqlite3_stmt *stmt = nullptr;
+  bool written = sqlite3_open(path.c_str(), &db) == SQLITE_OK &&
+                 sqlite3_exec(db, schema.c_str(), nullptr, nullptr,
+                              nullptr) == SQLITE_OK &&
+                 sqlite3_prepare_v2(db, insert.c_str(), -1, &stmt,
+                                    nullptr) == SQLITE_OK;
+  for (unsigned j = 0; written && j < columns.size(); ++j)
+    sqlite3_bind_int64(stmt, j + 1, values[j]);
+  if (written)
+    written = sqlite3_step(stmt) == SQLITE_DONE;
+  if (!written)
+    klee_warning("unable to write %s: %s", path.c_str(), sqlite3_errmsg(db));
+  sqlite3_finalize(stmt);
+  sqlite3_close(db);
+}
+
+/// Merge the statistics of the workers into the output directory so that
+/// klee-stats and KCachegrind report the whole exploration.
+static void mergeStatistics(KleeHandler &handler) {
+  ParallelCoverage coverage;
+  bool merged = mergeIStats(handler, coverage);
+  SmallString<128> istats(handler.getOutputFilename(getWorkerDirectoryName(0)));
+  sys::path::append(istats, "run.istats");
+  if (!merged && sys::fs::exists(istats))
+    klee_warning("unable to merge the run.istats of the workers");
+  mergeStats(handler, merged ? &coverage : nullptr);
+}
+
+static void reportTotals(KleeHandler &handler, uint64_t instructions,
+                         unsigned pathsCompleted, unsigned pathsExplored,
+                         unsigned testCases) {
+  std::stringstream stats;
+  stats << '\n'
+        << "KLEE: done: total instructions = " << instructions << '\n'
+        << "KLEE: done: completed paths = " << pathsCompleted
+        << '\n'
+        << "KLEE: done: partially completed paths = "
+        << pathsExplored - pathsCompleted
+        << '\n'
+        << "KLEE: done: generated tests = " << testCases
+        << '\n';
+
+  bool useColors = llvm::errs().is_displayed();
+  if (useColors)
+    llvm::errs().changeColor(llvm::raw_ostream::GREEN,
+                             /*bold=*/true,
+                             /*bg=*/false);
+
+  llvm::errs() << stats.str();
+
+  if (useColors)
+    llvm::errs().resetColor();
+
+  handler.getInfoStream() << stats.str();
+}
+
+/// Coordinate the workers of a parallel exploration and collect their
+/// results in the output directory of handler.
+static void runCoordinator(KleeHandler &handler) {
+  sys::SetInterruptFunction(interrupt_handle_coordinator);
+  // a worker may exit before it reads its commands
+  signal(SIGPIPE, SIG_IGN);
+
+  klee_message("exploring with %zu workers", parallelWorkers.size());
+  coordinateWorkers();
+  collectTestCases(handler);
+  mergeStatistics(handler);
+
+  uint64_t instructions = 0;
+  unsigned pathsCompleted = 0, pathsExplored = 0, testCases = 0;
+  for (const auto &worker : parallelWorkers) {
+    instructions += worker.instructions;
+    pathsCompleted += worker.pathsCompleted;
+    pathsExplored += worker.pathsExplored;
+    testCases += worker.testCases;
+  }
+  reportTotals(handler, instructions, pathsCompleted, pathsExplored,
+               testCases);
+}
+
 #ifndef SUPPORT_KLEE_UCLIBC
 static void
 linkWithUclibc(StringRef libDir, std::string opt_suffix,
@@ -1789,8 +2583,43 @@ int main(int argc, char **argv, char **envp) {
     KleeHandler::loadPathFile(ReplayPathFile, replayPath);
   }
 
+  int workerId = -1;
+  if (ParallelWorkers == 1)
+    klee_error("--parallel-workers needs at least 2 workers, omit it to "
+               "explore the program in a single process");
+  if (ParallelWorkers > 1) {
+    if (!ReplayKTestDir.empty() || !ReplayKTestFile.empty() ||
+        ReplayPathFile != "" || !ReplayNondets.empty() ||
+        !SeedOutFile.empty() || !SeedOutDir.empty())
+      klee_error("--parallel-workers cannot be combined with replaying or "
+                 "seeding");
+
+    KleeHandler *coordinator = new KleeHandler(pArgc, pArgv);
+    for (int i=0; i<argc; i++) {
+      coordinator->getInfoStream() << argv[i] << (i+1<argc ? " ":"\n");
+    }
+    coordinator->getInfoStream() << "PID: " << getpid() << "\n";
+    coordinator->getInfoStream().flush();
+
+    workerId = forkWorkers(ParallelWorkers);
+    if (workerId < 0) {
+      runCoordinator(*coordinator);
+      delete coordinator;
+
+      for (unsigned i=0; i<InputArgv.size()+1; i++)
+        delete[] pArgv[i];
+      delete[] pArgv;
+      return 0;
+    }
+
+    // each worker has its own directory within the output directory
+    OutputDir = coordinator->getOutputFilename(getWorkerDirectoryName(workerId));
+    delete coordinator;
+  }
+
   Interpreter::InterpreterOptions IOpts;
   IOpts.MakeConcreteSymbolic = MakeConcreteSymbolic;
+  IOpts.ExactPaths = isParallelWorker();
   KleeHandler *handler = new KleeHandler(pArgc, pArgv);
   Interpreter *interpreter =
     theInterpreter = Interpreter::create(ctx, IOpts, handler);
@@ -1925,7 +2754,10 @@ int main(int argc, char **argv, char **envp) {
                    sys::StrError(errno).c_str());
       }
     }
-    interpreter->runFunctionAsMain(mainFn, pArgc, pArgv, pEnvp);
+    if (isParallelWorker())
+      runWorker(interpreter, workerId, mainFn, pArgc, pArgv, pEnvp);
+    else
+      interpreter->runFunctionAsMain(mainFn, pArgc, pArgv, pEnvp);
 
     while (!seeds.empty()) {
       kTest_free(seeds.back());
@@ -1989,29 +2821,17 @@ int main(int argc, char **argv, char **envp) {
     << "KLEE: done: invalid queries = " << queriesInvalid << "\n"
     << "KLEE: done: query cex = " << queryCounterexamples << "\n";
 
-  std::stringstream stats;
-  stats << '\n'
-        << "KLEE: done: total instructions = " << instructions << '\n'
-        << "KLEE: done: completed paths = " << handler->getNumPathsCompleted()
-        << '\n'
-        << "KLEE: done: partially completed paths = "
-        << handler->getNumPathsExplored() - handler->getNumPathsCompleted()
-        << '\n'
-        << "KLEE: done: generated tests = " << handler->getNumTestCases()
-        << '\n';
+  reportTotals(*handler, instructions, handler->getNumPathsCompleted(),
+               handler->getNumPathsExplored(), handler->getNumTestCases());
 
-  bool useColors = llvm::errs().is_displayed();
-  if (useColors)
-    llvm::errs().changeColor(llvm::raw_ostream::GREEN,
-                             /*bold=*/true,
-                             /*bg=*/false);
-
-  llvm::errs() << stats.str();
-
-  if (useColors)
-    llvm::errs().resetColor();
-
-  handler->getInfoStream() << stats.str();
+  if (isParallelWorker()) {
+    std::stringstream totals;
+    totals << "done " << instructions << ' '
+           << handler->getNumPathsCompleted() << ' '
+           << handler->getNumPathsExplored() << ' '
+           << handler->getNumTestCases();
+    sendMessage(workerReplyFd, totals.str());
+  }
 
   delete handler;
 
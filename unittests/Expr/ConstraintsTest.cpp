@@ -0,0 +1,159 @@
+//===-- ConstraintsTest.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> readByte(const Array *array, uint64_t index) {
+  return ReadExpr::create(UpdateList(array, 0),
+                          ConstantExpr::create(index, Expr::Int32));
+}
+
+ref<Expr> readAt(const Array *array, const ref<Expr> &index) {
+  return ReadExpr::create(UpdateList(array, 0),
+                          ZExtExpr::create(index, Expr::Int32));
+}
+
+ref<Expr> ult(const ref<Expr> &e, uint64_t value) {
+  return UltExpr::create(e, ConstantExpr::create(value, Expr::Int8));
+}
+
+TEST(ConstraintsTest, RelevantConstraints) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  const Array *b = ac.CreateArray("b", 4);
+
+  ConstraintSet constraints;
+  ref<Expr> c0 = ult(readByte(a, 0), 10);
+  ref<Expr> c1 = ult(readByte(b, 0), 20);
+  ref<Expr> c2 = ult(readByte(a, 1), 30);
+  constraints.push_back(c0);
+  constraints.push_back(c1);
+  constraints.push_back(c2);
+
+  ConstraintSet::constraints_ty result;
+  constraints.getRelevantConstraints(ult(readByte(a, 0), 5), result);
+  EXPECT_EQ(ConstraintSet::constraints_ty({c0}), result);
+
+  // joins a[0] and a[1]
+  ref<Expr> c3 = UltExpr::create(readByte(a, 0), readByte(a, 1));
+  constraints.push_back(c3);
+  result.clear();
+  constraints.getRelevantConstraints(ult(readByte(a, 1), 5), result);
+  EXPECT_EQ(ConstraintSet::constraints_ty({c0, c2, c3}), result);
+
+  // a symbolic index joins every byte of the array
+  ref<Expr> c4 = ult(readAt(b, readByte(b, 3)), 40);
+  constraints.push_back(c4);
+  result.clear();
+  constraints.getRelevantConstraints(ult(readByte(b, 2), 5), result);
+  EXPECT_EQ(ConstraintSet::constraints_ty({c1, c4}), result);
+
+  result.clear();
+  constraints.getRelevantConstraints(ult(readByte(a, 3), 5), result);
+  EXPECT_TRUE(result.empty());
+
+  std::vector<ConstraintSet::constraints_ty> factors;
+  constraints.getIndependentFactors(ult(readByte(b, 1), 5), factors);
+  ASSERT_EQ(2U, factors.size());
+  EXPECT_EQ(ConstraintSet::constraints_ty({c1, c4}), factors[0]);
+  EXPECT_EQ(ConstraintSet::constraints_ty({c0, c2, c3}), factors[1]);
+}
+
+TEST(ConstraintsTest, CopiesDoNotShareUpdates) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+
+  ConstraintSet constraints;
+  ref<Expr> c0 = ult(readByte(a, 0), 10);
+  ref<Expr> c1 = ult(readByte(a, 1), 20);
+  constraints.push_back(c0);
+  constraints.push_back(c1);
+
+  ConstraintSet::constraints_ty result;
+  constraints.getRelevantConstraints(ult(readByte(a, 1), 5), result);
+  EXPECT_EQ(ConstraintSet::constraints_ty({c1}), result);
+
+  ConstraintSet copy(constraints);
+  ref<Expr> c2 = UltExpr::create(readByte(a, 0), readByte(a, 1));
+  copy.push_back(c2);
+
+  result.clear();
+  copy.getRelevantConstraints(ult(readByte(a, 1), 5), result);
+  EXPECT_EQ(ConstraintSet::constraints_ty({c0, c1, c2}), result);
+  result.clear();
+  constraints.getRelevantConstraints(ult(readByte(a, 1), 5), result);
+  EXPECT_EQ(ConstraintSet::constraints_ty({c1}), result);
+}
+
+TEST(ConstraintsTest, CopiesJoinGroupsIndependently) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 64);
+
+  ConstraintSet constraints;
+  for (unsigned i = 0; i != 64; ++i)
+    constraints.push_back(ult(readByte(a, i), i + 1));
+  std::vector<ConstraintSet::constraints_ty> factors;
+  constraints.getIndependentFactors(ult(readByte(a, 0), 5), factors);
+  EXPECT_EQ(64U, factors.size());
+
+  // join the bytes in pairs, then the pairs, and so on, in the copy only
+  ConstraintSet copy(constraints);
+  for (unsigned step = 1; step != 64; step *= 2)
+    for (unsigned i = 0; i + step < 64; i += 2 * step)
+      copy.push_back(UltExpr::create(readByte(a, i), readByte(a, i + step)));
+
+  factors.clear();
+  copy.getIndependentFactors(ult(readByte(a, 63), 5), factors);
+  ASSERT_EQ(1U, factors.size());
+  ConstraintSet::constraints_ty all(copy.begin(), copy.end());
+  EXPECT_EQ(all, factors[0]);
+
+  factors.clear();
+  constraints.getIndependentFactors(ult(readByte(a, 63), 5), factors);
+  ASSERT_EQ(64U, factors.size());
+  EXPECT_EQ(ConstraintSet::constraints_ty({*(constraints.end() - 1)}),
+            factors[0]);
+}
+
+TEST(ConstraintsTest, RewrittenConstraints) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+
+  ConstraintSet constraints;
+  ConstraintManager cm(constraints);
+  ref<Expr> c0 = UltExpr::create(readByte(a, 0), readByte(a, 1));
+  cm.addConstraint(c0);
+
+  ConstraintSet::constraints_ty result;
+  constraints.getRelevantConstraints(ult(readByte(a, 1), 5), result);
+  EXPECT_EQ(ConstraintSet::constraints_ty({c0}), result);
+
+  // a[0] == 3 rewrites c0 to 3 < a[1], which no longer reads a[0]
+  ref<Expr> eq =
+      EqExpr::create(ConstantExpr::create(3, Expr::Int8), readByte(a, 0));
+  cm.addConstraint(eq);
+  ASSERT_EQ(2U, constraints.size());
+
+  result.clear();
+  constraints.getRelevantConstraints(ult(readByte(a, 0), 5), result);
+  EXPECT_EQ(ConstraintSet::constraints_ty({eq}), result);
+  result.clear();
+  constraints.getRelevantConstraints(ult(readByte(a, 1), 5), result);
+  ASSERT_EQ(1U, result.size());
+  EXPECT_NE(c0, result[0]);
+}
+} // namespace
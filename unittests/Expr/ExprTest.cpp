@@ -12,6 +12,7 @@
 
 #include "klee/Expr/ArrayCache.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
 
 using namespace klee;
 
@@ -264,4 +265,46 @@ TEST(ExprTest, ReadExprFoldingSymbolicIndexUpdate) {
     EXPECT_EQ(Expr::Read, read.get()->getKind());
   }
 }
+
+TEST(ExprTest, Interning) {
+  Expr::internExprs = true;
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  ref<Expr> read = Expr::createTempRead(array, Expr::Int32);
+  ref<Expr> a = AddExpr::create(read, ConstantExpr::create(1, Expr::Int32));
+  ref<Expr> b = AddExpr::create(Expr::createTempRead(array, Expr::Int32),
+                                ConstantExpr::create(1, Expr::Int32));
+  EXPECT_TRUE(a->isInterned());
+  EXPECT_EQ(a.get(), b.get());
+
+  // nodes leave the table with their last reference
+  const unsigned count = Expr::count;
+  a = b = nullptr;
+  EXPECT_LT(Expr::count, count);
+  ref<Expr> c = AddExpr::create(read, ConstantExpr::create(2, Expr::Int32));
+  EXPECT_TRUE(c->isInterned());
+  EXPECT_NE(c, AddExpr::create(read, ConstantExpr::create(1, Expr::Int32)));
+  Expr::internExprs = false;
+}
+
+TEST(ExprTest, InterningNeedsInternedKids) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  ref<Expr> x = Expr::createTempRead(array, Expr::Int32);
+  ref<Expr> y = Expr::createTempRead(array, Expr::Int32);
+  ASSERT_NE(x.get(), y.get());
+
+  // kids built before interning was enabled keep their parents out of the
+  // table, so equal parents are still equal in an ExprHashSet
+  Expr::internExprs = true;
+  ref<Expr> one = ConstantExpr::create(1, Expr::Int32);
+  ref<Expr> a = AddExpr::create(x, one);
+  ref<Expr> b = AddExpr::create(y, one);
+  EXPECT_FALSE(a->isInterned());
+  EXPECT_FALSE(b->isInterned());
+  ExprHashSet set;
+  set.insert(a);
+  EXPECT_EQ(1u, set.count(b));
+  Expr::internExprs = false;
+}
 }
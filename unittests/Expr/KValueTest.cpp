@@ -0,0 +1,86 @@
+//===-- KValueTest.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Module/KValue.h"
+
+using namespace klee;
+
+namespace {
+
+const uint64_t g_values[] = {0, 1, 5, 0x80, 0xdeadbeef, ~0ULL};
+const Expr::Width g_widths[] = {Expr::Bool, Expr::Int8, Expr::Int32,
+                                Expr::Int64};
+
+TEST(KValueTest, UnboxedMatchesExprs) {
+  for (Expr::Width w : g_widths) {
+    for (uint64_t a : g_values) {
+      for (uint64_t b : g_values) {
+        KValue l = KValue::createConstant(a, w);
+        KValue r = KValue::createConstant(b, w);
+        ref<Expr> ea = l.getValue(), eb = r.getValue();
+
+        EXPECT_EQ(AddExpr::create(ea, eb), l.Add(r).getValue());
+        EXPECT_EQ(SubExpr::create(ea, eb), l.Sub(r).getValue());
+        EXPECT_EQ(MulExpr::create(ea, eb), l.Mul(r).getValue());
+        EXPECT_EQ(XorExpr::create(ea, eb), l.Xor(r).getValue());
+        EXPECT_EQ(ShlExpr::create(ea, eb), l.Shl(r).getValue());
+        EXPECT_EQ(AShrExpr::create(ea, eb), l.AShr(r).getValue());
+        EXPECT_EQ(SltExpr::create(ea, eb), l.Slt(r).getValue());
+        EXPECT_EQ(UgeExpr::create(ea, eb), l.Uge(r).getValue());
+        if (!cast<ConstantExpr>(eb)->isZero()) {
+          EXPECT_EQ(SDivExpr::create(ea, eb), l.SDiv(r).getValue());
+          EXPECT_EQ(URemExpr::create(ea, eb), l.URem(r).getValue());
+        }
+      }
+      KValue v = KValue::createConstant(a, w);
+      EXPECT_EQ(SExtExpr::create(v.getValue(), 64), v.SExt(64).getValue());
+      EXPECT_EQ(ZExtExpr::create(v.getValue(), 128), v.ZExt(128).getValue());
+      EXPECT_EQ(ExtractExpr::create(v.getValue(), 0, 1),
+                v.Extract(0, 1).getValue());
+    }
+  }
+}
+
+TEST(KValueTest, UnboxedPointers) {
+  KValue pointer = KValue::createConstant(16, Expr::Int64, 12);
+  KValue moved = pointer.Add(KValue::createConstant(4, Expr::Int64));
+  EXPECT_EQ(12u, cast<ConstantExpr>(moved.getSegment())->getZExtValue());
+  EXPECT_EQ(20u, cast<ConstantExpr>(moved.getOffset())->getZExtValue());
+
+  // pointers into different segments are ordered by their segments
+  KValue other = KValue::createConstant(100, Expr::Int64, 11);
+  EXPECT_TRUE(other.Ult(pointer).isConstant());
+  EXPECT_TRUE(cast<ConstantExpr>(other.Ult(pointer).getValue())->isTrue());
+  EXPECT_TRUE(cast<ConstantExpr>(other.Eq(pointer).getValue())->isFalse());
+
+  KValue bytes = KValue::concatValues(
+      std::vector<KValue>{KValue::createConstant(0x12, Expr::Int8),
+                          KValue::createConstant(0x34, Expr::Int8)});
+  EXPECT_EQ(16u, bytes.getWidth());
+  EXPECT_EQ(0x1234u, cast<ConstantExpr>(bytes.getValue())->getZExtValue());
+  EXPECT_TRUE(bytes.getSegment()->isZero());
+}
+
+TEST(KValueTest, MixedWithSymbolic) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 8);
+  ref<Expr> read = Expr::createTempRead(array, Expr::Int32);
+  KValue symbolic(read);
+  KValue sum = symbolic.Add(KValue::createConstant(3, Expr::Int32));
+  EXPECT_FALSE(sum.isConstant());
+  EXPECT_EQ(AddExpr::create(read, ConstantExpr::alloc(3, Expr::Int32)),
+            sum.getValue());
+  EXPECT_TRUE(sum.getSegment()->isZero());
+}
+
+} // namespace
@@ -0,0 +1,134 @@
+//===-- InterpreterTest.cpp -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "Core/CoreStats.h"
+#include "klee/Config/config.h"
+#include "klee/Core/Interpreter.h"
+#include "klee/System/Time.h"
+
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <iostream>
+
+using namespace klee;
+
+namespace {
+
+class BenchmarkHandler : public InterpreterHandler {
+  std::string directory;
+
+public:
+  unsigned paths = 0;
+
+  explicit BenchmarkHandler(std::string directory)
+      : directory(std::move(directory)) {}
+
+  llvm::raw_ostream &getInfoStream() const override { return llvm::nulls(); }
+  std::string getOutputFilename(const std::string &filename) override {
+    llvm::SmallString<128> path(directory);
+    llvm::sys::path::append(path, filename);
+    return path.str().str();
+  }
+  std::unique_ptr<llvm::raw_fd_ostream>
+  openOutputFile(const std::string &filename) override {
+    std::error_code ec;
+    return std::make_unique<llvm::raw_fd_ostream>(
+        getOutputFilename(filename), ec, llvm::sys::fs::OF_None);
+  }
+  void incPathsCompleted() override { ++paths; }
+  void incPathsExplored(std::uint32_t) override {}
+  void processTestCase(const ExecutionState &, const char *,
+                       const char *) override {}
+};
+
+// Concrete arithmetic, address computations and stores: 13 instructions
+// per iteration.
+const char *benchmark = R"(
+define i32 @main() {
+entry:
+  %buf = alloca [64 x i32]
+  br label %loop
+loop:
+  %i = phi i64 [0, %entry], [%inc, %loop]
+  %acc = phi i32 [7, %entry], [%acc3, %loop]
+  %idx = and i64 %i, 63
+  %g = getelementptr [64 x i32], [64 x i32]* %buf, i64 0, i64 %idx
+  %t = trunc i64 %i to i32
+  %m = mul i32 %t, 2654435761
+  %acc1 = xor i32 %acc, %m
+  %acc2 = shl i32 %acc1, 1
+  %acc3 = add i32 %acc2, %t
+  store i32 %acc3, i32* %g
+  %inc = add i64 %i, 1
+  %done = icmp eq i64 %inc, 100000
+  br i1 %done, label %exit, label %loop
+exit:
+  %r = and i32 %acc3, 1
+  ret i32 %r
+}
+)";
+
+/// Interpreter throughput on concrete code, reported in instructions per
+/// second.
+TEST(InterpreterTest, Throughput) {
+  llvm::InitializeNativeTarget();
+
+  llvm::LLVMContext context;
+  llvm::SMDiagnostic error;
+  std::unique_ptr<llvm::Module> module =
+      llvm::parseAssemblyString(benchmark, error, context);
+  ASSERT_TRUE(module);
+
+  llvm::SmallString<128> directory;
+  ASSERT_FALSE(
+      llvm::sys::fs::createUniqueDirectory("klee-interpreter", directory));
+  BenchmarkHandler handler(directory.str().str());
+  std::unique_ptr<Interpreter> interpreter(Interpreter::create(
+      context, Interpreter::InterpreterOptions(), &handler));
+
+  llvm::SmallString<128> libraryDir(KLEE_DIR);
+  llvm::sys::path::append(libraryDir, "runtime", "lib");
+  std::vector<std::unique_ptr<llvm::Module>> modules;
+  modules.push_back(std::move(module));
+  Interpreter::ModuleOptions options(
+      libraryDir.str().str(), "main",
+      std::string("64_") + RUNTIME_CONFIGURATION,
+      /*Optimize=*/false, /*CheckDivZero=*/false, /*CheckOvershift=*/false);
+  llvm::Module *final = interpreter->setModule(modules, options);
+
+  const std::uint64_t before = stats::instructions;
+  const time::Point start = time::getWallTime();
+  char *argv[] = {nullptr};
+  interpreter->runFunctionAsMain(final->getFunction("main"), 0, argv, argv);
+  const time::Span elapsed = time::getWallTime() - start;
+  const std::uint64_t instructions = stats::instructions - before;
+
+  EXPECT_EQ(1u, handler.paths);
+  EXPECT_GE(instructions, 1300000u);
+  const double perSecond = instructions / elapsed.toSeconds();
+  std::cout << "[ THROUGHPUT ] " << instructions << " instructions in "
+            << elapsed << " (" << static_cast<std::uint64_t>(perSecond)
+            << " instructions/s)\n";
+  RecordProperty("InstructionsPerSecond",
+                 std::to_string(static_cast<std::uint64_t>(perSecond)));
+
+  interpreter.reset();
+  llvm::sys::fs::remove_directories(directory);
+}
+
+} // namespace
@@ -0,0 +1,53 @@
+//===-- MemoryTest.cpp ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "Core/Context.h"
+#include "Core/Memory.h"
+#include "Core/MemoryManager.h"
+
+using namespace klee;
+
+namespace {
+
+class ObjectStateTest : public ::testing::Test {
+protected:
+  static void SetUpTestCase() { Context::initialize(true, Expr::Int64); }
+};
+
+TEST_F(ObjectStateTest, SmallObjectFootprint) {
+  MemoryManager memory(nullptr);
+  ArrayCache cache;
+  const Array *array = cache.CreateArray("byte", 1);
+  ref<Expr> symbolic =
+      ReadExpr::create(UpdateList(array, nullptr), ConstantExpr::create(0, 32));
+
+  MemoryObject *small = memory.allocate(8, true, false, nullptr, 8);
+  ref<ObjectState> os(new ObjectState(small));
+  os->initializeToZero();
+  os->write32(0, 0, 42);
+  os->write(4, KValue(symbolic));
+  // the per-byte stores of a small object do not take whole pages
+  EXPECT_LT(os->getStorageBytes(), 1024u);
+
+  // a copy shares the stores, a write to it copies only what it touches
+  ref<ObjectState> copy(new ObjectState(*os));
+  copy->write8(1, 0, 7);
+  EXPECT_LT(copy->getStorageBytes(), 1024u);
+
+  MemoryObject *large = memory.allocate(1 << 16, true, false, nullptr, 8);
+  ref<ObjectState> big(new ObjectState(large));
+  big->initializeToZero();
+  big->write8(100, 0, 1);
+  EXPECT_GT(big->getStorageBytes(), 1u << 16);
+}
+
+} // namespace
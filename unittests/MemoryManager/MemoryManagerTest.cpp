@@ -0,0 +1,132 @@
+//===-- MemoryManagerTest.cpp -----------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/ADT/SlabAllocator.h"
+#include "klee/System/Time.h"
+#include "Core/AddressSpace.h"
+#include "Core/Context.h"
+#include "Core/Memory.h"
+#include "Core/MemoryManager.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+class MemoryManagerTest : public ::testing::Test {
+protected:
+  static void SetUpTestCase() { Context::initialize(true, Expr::Int64); }
+};
+
+TEST(SlabAllocatorTest, ReusesReleasedChunks) {
+  SlabAllocator allocator;
+  void *a = allocator.allocate(40);
+  void *b = allocator.allocate(48);
+  EXPECT_NE(a, b);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(a) % SlabAllocator::Granularity, 0u);
+
+  // 40 and 48 bytes share a size class
+  allocator.deallocate(a, 40);
+  EXPECT_EQ(allocator.allocate(48), a);
+
+  // other size classes do not see the chunk
+  allocator.deallocate(b, 48);
+  EXPECT_NE(allocator.allocate(8), b);
+  EXPECT_EQ(allocator.getSlabBytes(), 2 * SlabAllocator::SlabBytes);
+
+  void *large = allocator.allocate(SlabAllocator::MaxSize + 1);
+  allocator.deallocate(large, SlabAllocator::MaxSize + 1);
+  EXPECT_EQ(allocator.getSlabBytes(), 2 * SlabAllocator::SlabBytes);
+}
+
+TEST_F(MemoryManagerTest, TracksLiveObjects) {
+  MemoryManager memory(nullptr);
+  std::vector<MemoryObject *> objects;
+  for (unsigned i = 0; i < 5; ++i)
+    objects.push_back(memory.allocate(8, true, false, nullptr, 8));
+  EXPECT_EQ(memory.getLiveObjectCount(), 5u);
+
+  // unlink from the head, the middle and the tail of the list
+  delete objects[4];
+  delete objects[2];
+  delete objects[0];
+  EXPECT_EQ(memory.getLiveObjectCount(), 2u);
+
+  // the remaining objects are released by the manager
+}
+
+TEST_F(MemoryManagerTest, AddressSpaceOwnedBytes) {
+  MemoryManager memory(nullptr);
+  MemoryObject *mo = memory.allocate(100, false, true, nullptr, 8);
+  ObjectState *os = new ObjectState(mo);
+  AddressSpace parent;
+  parent.bindObject(mo, os);
+  uint64_t objectBytes = parent.getOwnedBytes();
+  EXPECT_GT(objectBytes, 100u);
+
+  // forking shares the object, neither copy owns it
+  AddressSpace child(parent);
+  EXPECT_EQ(parent.getOwnedBytes(), 0u);
+  EXPECT_EQ(child.getOwnedBytes(), 0u);
+
+  child.getWriteable(mo, os);
+  EXPECT_EQ(child.getOwnedBytes(), objectBytes);
+  EXPECT_EQ(parent.getOwnedBytes(), 0u);
+
+  child.unbindObject(mo);
+  parent.unbindObject(mo);
+  EXPECT_EQ(child.getOwnedBytes(), 0u);
+  EXPECT_EQ(parent.getOwnedBytes(), 0u);
+}
+
+/// Simulates a recursive program that allocates a few locals in each call
+/// frame: objects are created on the way down and released in reverse
+/// order on the way up. Reports the allocate/free throughput.
+TEST_F(MemoryManagerTest, RecursiveFrameThroughput) {
+  const unsigned Depth = 1000;
+  const unsigned LocalsPerFrame = 4;
+  const unsigned Rounds = 50;
+
+  MemoryManager memory(nullptr);
+  std::vector<ref<ObjectState>> stack;
+  stack.reserve(Depth * LocalsPerFrame);
+
+  auto start = time::getWallTime();
+  for (unsigned round = 0; round < Rounds; ++round) {
+    for (unsigned frame = 0; frame < Depth; ++frame) {
+      for (unsigned local = 0; local < LocalsPerFrame; ++local) {
+        MemoryObject *mo =
+            memory.allocate(4 << local, true, false, nullptr, 8);
+        ObjectState *os = new ObjectState(mo);
+        os->initializeToZero();
+        stack.emplace_back(os);
+      }
+    }
+    EXPECT_EQ(memory.getLiveObjectCount(), Depth * LocalsPerFrame);
+    while (!stack.empty())
+      stack.pop_back();
+    EXPECT_EQ(memory.getLiveObjectCount(), 0u);
+  }
+  auto elapsed = time::getWallTime() - start;
+
+  uint64_t operations = 2ull * Rounds * Depth * LocalsPerFrame;
+  llvm::outs() << "allocated and freed " << operations / 2
+               << " objects in " << elapsed.toMicroseconds() << "us ("
+               << (uint64_t)(operations / std::max(elapsed.toSeconds(), 1e-6))
+               << " ops/s)\n";
+}
+
+} // namespace
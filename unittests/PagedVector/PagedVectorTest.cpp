@@ -0,0 +1,109 @@
+//===-- PagedVectorTest.cpp -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/ADT/PagedVector.h"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+typedef PagedVector<uint8_t, 16> SmallPagedVector;
+
+TEST(PagedVectorTest, ResizeFillsNewElements) {
+  SmallPagedVector v;
+  v.resize(20, 0xAB);
+  ASSERT_EQ(v.size(), 20u);
+  for (size_t i = 0; i < v.size(); ++i)
+    EXPECT_EQ(v[i], 0xAB);
+
+  v.set(19, 1);
+  v.resize(18);
+  v.resize(40, 7);
+  EXPECT_EQ(v[17], 0xAB);
+  for (size_t i = 18; i < v.size(); ++i)
+    EXPECT_EQ(v[i], 7);
+}
+
+TEST(PagedVectorTest, CopiesAreIndependent) {
+  SmallPagedVector a(64, 0);
+  a.set(3, 3);
+  SmallPagedVector b(a);
+  b.set(3, 4);
+  b.set(50, 5);
+  EXPECT_EQ(a[3], 3);
+  EXPECT_EQ(a[50], 0);
+  EXPECT_EQ(b[3], 4);
+  EXPECT_EQ(b[50], 5);
+
+  a.set(51, 6);
+  EXPECT_EQ(b[51], 0);
+}
+
+TEST(PagedVectorTest, BulkOperations) {
+  SmallPagedVector v(37, 0);
+  std::vector<uint8_t> data(37);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = i;
+
+  EXPECT_FALSE(v.equals(data.data()));
+  SmallPagedVector copy(v);
+  v.assign(data.data());
+  EXPECT_TRUE(v.equals(data.data()));
+  EXPECT_EQ(copy[36], 0);
+
+  std::vector<uint8_t> out(37);
+  v.copyTo(out.data());
+  EXPECT_EQ(out, data);
+}
+
+TEST(PagedVectorTest, LastPageFitsSize) {
+  PagedVector<uint8_t> v(8, 1);
+  EXPECT_LT(v.getStorageBytes(), 128u);
+
+  // growing within the last page keeps it below a full page
+  v.resize(100, 2);
+  EXPECT_LT(v.getStorageBytes(), 512u);
+  EXPECT_EQ(v[7], 1);
+  EXPECT_EQ(v[99], 2);
+
+  v.resize(5000, 3);
+  EXPECT_EQ(v[4095], 3);
+  EXPECT_EQ(v[4999], 3);
+  EXPECT_LT(v.getStorageBytes(), 8192u);
+
+  // shrinking a shared last page leaves the copy intact
+  PagedVector<uint8_t> copy(v);
+  v.resize(4100);
+  v.resize(4200, 4);
+  EXPECT_EQ(v[4099], 3);
+  EXPECT_EQ(v[4100], 4);
+  EXPECT_EQ(copy.size(), 5000u);
+  EXPECT_EQ(copy[4100], 3);
+}
+
+TEST(PagedBitArrayTest, SetAndResize) {
+  PagedBitArray bits(70, true);
+  bits.unset(3);
+  PagedBitArray copy(bits);
+  copy.unset(65);
+  EXPECT_FALSE(bits.get(3));
+  EXPECT_TRUE(bits.get(65));
+  EXPECT_FALSE(copy.get(65));
+
+  bits.resize(10);
+  bits.resize(100, false);
+  EXPECT_TRUE(bits.get(9));
+  for (unsigned i = 10; i < 100; ++i)
+    EXPECT_FALSE(bits.get(i));
+}
+
+} // namespace
@@ -0,0 +1,100 @@
+//===-- PersistentHashMapTest.cpp -------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/ADT/PersistentHashMap.h"
+#include "gtest/gtest.h"
+
+#include <map>
+
+using namespace klee;
+
+namespace {
+
+typedef PersistentHashMap<uint64_t, int> Map;
+
+/// Maps every key to the same hash to exercise collision nodes.
+struct ConstantHash {
+  size_t operator()(uint64_t) const { return 42; }
+};
+
+TEST(PersistentHashMapTest, InsertLookupRemove) {
+  Map m;
+  for (uint64_t i = 0; i < 5000; ++i)
+    m = m.insert(std::make_pair(i * 7, (int)i));
+  ASSERT_EQ(m.size(), 5000u);
+  for (uint64_t i = 0; i < 5000; ++i) {
+    const Map::value_type *res = m.lookup(i * 7);
+    ASSERT_NE(res, nullptr);
+    EXPECT_EQ(res->second, (int)i);
+  }
+  EXPECT_EQ(m.lookup(1), nullptr);
+
+  for (uint64_t i = 0; i < 5000; i += 2)
+    m = m.remove(i * 7);
+  EXPECT_EQ(m.size(), 2500u);
+  for (uint64_t i = 0; i < 5000; ++i)
+    EXPECT_EQ(m.count(i * 7), i % 2);
+}
+
+TEST(PersistentHashMapTest, InsertKeepsReplaceOverwrites) {
+  Map m;
+  m = m.insert(std::make_pair(1, 1));
+  m = m.insert(std::make_pair(1, 2));
+  EXPECT_EQ(m.lookup(1)->second, 1);
+  m = m.replace(std::make_pair(1, 3));
+  EXPECT_EQ(m.lookup(1)->second, 3);
+  EXPECT_EQ(m.size(), 1u);
+}
+
+TEST(PersistentHashMapTest, UpdatesDoNotAffectCopies) {
+  Map a;
+  for (uint64_t i = 0; i < 100; ++i)
+    a = a.insert(std::make_pair(i, (int)i));
+  Map b = a.replace(std::make_pair(5, -5)).remove(6);
+  EXPECT_EQ(a.lookup(5)->second, 5);
+  EXPECT_NE(a.lookup(6), nullptr);
+  EXPECT_EQ(b.lookup(5)->second, -5);
+  EXPECT_EQ(b.lookup(6), nullptr);
+  EXPECT_EQ(a.size(), 100u);
+  EXPECT_EQ(b.size(), 99u);
+}
+
+TEST(PersistentHashMapTest, IterationVisitsAllValues) {
+  Map m;
+  std::map<uint64_t, int> expected;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    m = m.insert(std::make_pair(i * 33, (int)i));
+    expected[i * 33] = i;
+  }
+  std::map<uint64_t, int> seen;
+  for (const Map::value_type &v : m)
+    seen.insert(v);
+  EXPECT_EQ(seen, expected);
+  EXPECT_TRUE(Map().begin() == Map().end());
+}
+
+TEST(PersistentHashMapTest, Collisions) {
+  typedef PersistentHashMap<uint64_t, int, ConstantHash> CollidingMap;
+  CollidingMap m;
+  for (uint64_t i = 0; i < 10; ++i)
+    m = m.insert(std::make_pair(i, (int)i));
+  EXPECT_EQ(m.size(), 10u);
+  for (uint64_t i = 0; i < 10; ++i)
+    EXPECT_EQ(m.lookup(i)->second, (int)i);
+  for (uint64_t i = 0; i < 9; ++i)
+    m = m.remove(i);
+  EXPECT_EQ(m.size(), 1u);
+  EXPECT_EQ(m.lookup(9)->second, 9);
+  EXPECT_EQ(m.lookup(0), nullptr);
+  m = m.remove(9);
+  EXPECT_TRUE(m.empty());
+  EXPECT_TRUE(m.begin() == m.end());
+}
+
+} // namespace
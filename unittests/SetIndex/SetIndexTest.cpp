@@ -0,0 +1,203 @@
+//===-- SetIndexTest.cpp ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/ADT/SetIndex.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <list>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+typedef std::set<int> Set;
+typedef SetIndex<int, int> Index;
+
+auto any = [](int) { return true; };
+
+TEST(SetIndexTest, ExactLookup) {
+  Index index;
+  index.insert(Set{1, 2, 3}, 10);
+  index.insert(Set{}, 20);
+  index.insert(Set{1, 2, 3}, 11);
+
+  ASSERT_EQ(index.size(), 2u);
+  ASSERT_NE(index.lookup(Set{3, 2, 1}), nullptr);
+  EXPECT_EQ(*index.lookup(Set{3, 2, 1}), 11);
+  EXPECT_EQ(*index.lookup(Set{}), 20);
+  EXPECT_EQ(index.lookup(Set{1, 2}), nullptr);
+  EXPECT_EQ(index.lookup(Set{1, 2, 4}), nullptr);
+}
+
+TEST(SetIndexTest, SubsetAndSuperset) {
+  Index index;
+  index.insert(Set{1, 2}, 1);
+  index.insert(Set{2, 3}, 2);
+  index.insert(Set{1, 2, 3, 4}, 3);
+  index.insert(Set{5}, 4);
+
+  // the oldest matching entry wins
+  EXPECT_EQ(*index.findSubset(Set{1, 2, 3}, any), 1);
+  EXPECT_EQ(*index.findSubset(Set{1, 2, 3}, [](int v) { return v != 1; }), 2);
+  EXPECT_EQ(index.findSubset(Set{1, 3, 6}, any), nullptr);
+  EXPECT_EQ(*index.findSuperset(Set{3}, any), 2);
+  EXPECT_EQ(*index.findSuperset(Set{1, 3}, any), 3);
+  EXPECT_EQ(index.findSuperset(Set{1, 5}, any), nullptr);
+  EXPECT_EQ(index.findSuperset(Set{7}, any), nullptr);
+  EXPECT_EQ(*index.findSuperset(Set{}, any), 1);
+  EXPECT_EQ(*index.findAny([](int v) { return v > 2; }), 3);
+
+  index.insert(Set{}, 5);
+  EXPECT_EQ(*index.findSubset(Set{9}, any), 5);
+}
+
+TEST(SetIndexTest, EvictsLeastRecentlyUsed) {
+  Index index(2);
+  index.insert(Set{1}, 1);
+  index.insert(Set{2}, 2);
+  // using {1} makes {2} the eviction candidate
+  ASSERT_NE(index.lookup(Set{1}), nullptr);
+  index.insert(Set{1, 2}, 3);
+
+  EXPECT_EQ(index.size(), 2u);
+  EXPECT_NE(index.lookup(Set{1}), nullptr);
+  EXPECT_EQ(index.lookup(Set{2}), nullptr);
+  EXPECT_NE(index.lookup(Set{1, 2}), nullptr);
+  EXPECT_EQ(*index.findSuperset(Set{2}, any), 3);
+
+  // dropping every entry with an element forgets the element
+  index.insert(Set{7}, 4);
+  index.insert(Set{8}, 5);
+  EXPECT_EQ(index.findSuperset(Set{1}, any), nullptr);
+  EXPECT_EQ(index.findSubset(Set{1, 2}, any), nullptr);
+}
+
+TEST(SetIndexTest, MatchesBruteForce) {
+  std::mt19937 rng(7);
+  std::vector<std::pair<Set, int>> reference;
+  Index index;
+  auto randomSet = [&rng]() {
+    Set s;
+    unsigned size = rng() % 5;
+    for (unsigned i = 0; i < size; ++i)
+      s.insert(rng() % 12);
+    return s;
+  };
+
+  for (int i = 0; i < 300; ++i) {
+    Set s = randomSet();
+    if (!index.lookup(s)) {
+      index.insert(s, i);
+      reference.emplace_back(s, i);
+    }
+  }
+
+  for (int i = 0; i < 300; ++i) {
+    Set key = randomSet();
+    const int *expectedSubset = nullptr, *expectedSuperset = nullptr;
+    for (const auto &entry : reference) {
+      if (!expectedSubset && std::includes(key.begin(), key.end(),
+                                           entry.first.begin(),
+                                           entry.first.end()))
+        expectedSubset = &entry.second;
+      if (!expectedSuperset && std::includes(entry.first.begin(),
+                                             entry.first.end(), key.begin(),
+                                             key.end()))
+        expectedSuperset = &entry.second;
+    }
+    int *subset = index.findSubset(key, any);
+    int *superset = index.findSuperset(key, any);
+    ASSERT_EQ(subset == nullptr, expectedSubset == nullptr);
+    ASSERT_EQ(superset == nullptr, expectedSuperset == nullptr);
+    if (subset) {
+      EXPECT_EQ(*subset, *expectedSubset);
+    }
+    if (superset) {
+      EXPECT_EQ(*superset, *expectedSuperset);
+    }
+  }
+}
+
+TEST(SetIndexTest, FindAnyTestsSharedValuesOnce) {
+  Index index;
+  index.insert(Set{1}, 7);
+  index.insert(Set{2}, 7);
+  index.insert(Set{3}, 8);
+  index.insert(Set{4}, 7);
+
+  unsigned calls = 0;
+  EXPECT_EQ(*index.findAny([&calls](int v) { ++calls; return v == 8; }), 8);
+  EXPECT_EQ(calls, 2u);
+}
+
+TEST(SetIndexTest, MatchesBruteForceWithEviction) {
+  std::mt19937 rng(11);
+  // reference entries, most recently used first
+  std::list<std::pair<Set, int>> reference;
+  const std::size_t capacity = 16;
+  Index index(capacity);
+  auto randomSet = [&rng]() {
+    Set s;
+    unsigned size = rng() % 5;
+    for (unsigned i = 0; i < size; ++i)
+      s.insert(rng() % 10);
+    return s;
+  };
+  auto use = [&reference](int value) {
+    for (auto it = reference.begin(); it != reference.end(); ++it) {
+      if (it->second == value) {
+        reference.splice(reference.begin(), reference, it);
+        return;
+      }
+    }
+  };
+
+  for (int i = 0; i < 1000; ++i) {
+    Set s = randomSet();
+    if (int *found = index.lookup(s)) {
+      use(*found);
+    } else {
+      index.insert(s, i);
+      reference.emplace_front(s, i);
+      if (reference.size() > capacity)
+        reference.pop_back();
+    }
+    ASSERT_EQ(index.size(), reference.size());
+
+    // values grow with insertion, so the oldest match has the least value
+    Set key = randomSet();
+    int expectedSubset = -1, expectedSuperset = -1;
+    for (const auto &entry : reference) {
+      if (std::includes(key.begin(), key.end(), entry.first.begin(),
+                        entry.first.end()) &&
+          (expectedSubset < 0 || entry.second < expectedSubset))
+        expectedSubset = entry.second;
+      if (std::includes(entry.first.begin(), entry.first.end(), key.begin(),
+                        key.end()) &&
+          (expectedSuperset < 0 || entry.second < expectedSuperset))
+        expectedSuperset = entry.second;
+    }
+    int *subset = index.findSubset(key, any);
+    ASSERT_EQ(subset ? *subset : -1, expectedSubset);
+    if (subset) {
+      use(*subset);
+    }
+    int *superset = index.findSuperset(key, any);
+    ASSERT_EQ(superset ? *superset : -1, expectedSuperset);
+    if (superset) {
+      use(*superset);
+    }
+  }
+}
+
+} // namespace
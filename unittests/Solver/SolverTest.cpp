@@ -14,10 +14,14 @@
 #include "klee/Expr/Expr.h"
 #include "klee/Solver/Solver.h"
 #include "klee/Solver/SolverCmdLine.h"
+#include "klee/Solver/SolverImpl.h"
 
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
 
+#include <chrono>
 #include <iostream>
+#include <thread>
 
 using namespace klee;
 
@@ -169,4 +173,202 @@ TEST(SolverTest, Evaluation) {
   delete solver;
 }
 
+TEST(SolverTest, BatchedMayBeTrue) {
+  Solver *solver = klee::createCoreSolver(CoreSolverToUse);
+  const Array *array = ac.CreateArray("batch", 1);
+  ref<Expr> read = Expr::createTempRead(array, Expr::Int8);
+  ConstraintSet constraints(
+      {UltExpr::create(read, ConstantExpr::alloc(3, Expr::Int8))});
+
+  std::vector<ref<Expr>> exprs;
+  for (unsigned i = 0; i != 6; ++i)
+    exprs.push_back(EqExpr::create(ConstantExpr::alloc(i, Expr::Int8), read));
+  exprs.push_back(ConstantExpr::alloc(1, Expr::Bool));
+  exprs.push_back(UgtExpr::create(read, ConstantExpr::alloc(1, Expr::Int8)));
+
+  std::vector<bool> results;
+  ASSERT_TRUE(solver->mayBeTrue(constraints, exprs, results));
+  EXPECT_EQ(std::vector<bool>({true, true, true, false, false, false, true,
+                               true}),
+            results);
+
+  // nothing may be true
+  exprs.assign(1, EqExpr::create(ConstantExpr::alloc(7, Expr::Int8), read));
+  exprs.push_back(EqExpr::create(ConstantExpr::alloc(8, Expr::Int8), read));
+  ASSERT_TRUE(solver->mayBeTrue(constraints, exprs, results));
+  EXPECT_EQ(std::vector<bool>({false, false}), results);
+
+  delete solver;
+}
+
+/// Answers every query the same way and counts how often it was asked.
+class CountingSolver : public SolverImpl {
+public:
+  unsigned &calls;
+  explicit CountingSolver(unsigned &calls) : calls(calls) {}
+
+  bool computeTruth(const Query &, bool &isValid) override {
+    ++calls;
+    isValid = true;
+    return true;
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) override {
+    ++calls;
+    result = ConstantExpr::alloc(0x12, query.expr->getWidth());
+    return true;
+  }
+  bool computeInitialValues(const Query &query,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution) override {
+    ++calls;
+    const ReadExpr *read = cast<ReadExpr>(query.constraints.begin()->get()
+                                              ->getKid(1));
+    Assignment::map_bindings_ty bindings;
+    bindings[read->updates.root].add(0, 42);
+    result = std::make_shared<Assignment>(bindings);
+    hasSolution = true;
+    return true;
+  }
+  SolverRunStatus getOperationStatusCode() override {
+    return SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  }
+};
+
+TEST(SolverTest, PersistentCacheSurvivesRenaming) {
+  llvm::SmallString<128> path;
+  ASSERT_FALSE(llvm::sys::fs::createTemporaryFile("query-cache", "sqlite",
+                                                  path));
+
+  // the same query over differently named arrays, as built by two runs
+  auto makeConstraints = [](const std::string &name) {
+    const Array *array = ac.CreateArray(name, 1);
+    ref<Expr> read = Expr::createTempRead(array, Expr::Int8);
+    return ConstraintSet(
+        {EqExpr::create(ConstantExpr::alloc(7, Expr::Int8), read)});
+  };
+  auto queryExpr = [](const ConstraintSet &constraints) {
+    return UltExpr::create(ConstantExpr::alloc(3, Expr::Int8),
+                           constraints.begin()->get()->getKid(1));
+  };
+
+  unsigned firstCalls = 0, secondCalls = 0;
+  {
+    Solver *solver = createPersistentCachingSolver(
+        new Solver(new CountingSolver(firstCalls)), path.str().str());
+    ConstraintSet constraints = makeConstraints("first_run");
+    bool result;
+    ASSERT_TRUE(solver->mustBeTrue(Query(constraints, queryExpr(constraints)),
+                                   result));
+    ref<ConstantExpr> value;
+    ASSERT_TRUE(solver->getValue(
+        Query(constraints, constraints.begin()->get()->getKid(1)), value));
+    std::shared_ptr<const Assignment> model;
+    ASSERT_TRUE(solver->getInitialValues(
+        Query(constraints, ConstantExpr::alloc(0, Expr::Bool)), model));
+    delete solver;
+  }
+  EXPECT_EQ(3u, firstCalls);
+
+  {
+    Solver *solver = createPersistentCachingSolver(
+        new Solver(new CountingSolver(secondCalls)), path.str().str());
+    ConstraintSet constraints = makeConstraints("second_run");
+    ref<Expr> read = constraints.begin()->get()->getKid(1);
+    bool result = false;
+    ASSERT_TRUE(solver->mustBeTrue(Query(constraints, queryExpr(constraints)),
+                                   result));
+    EXPECT_TRUE(result);
+    ref<ConstantExpr> value;
+    ASSERT_TRUE(solver->getValue(Query(constraints, read), value));
+    EXPECT_EQ(0x12u, value->getZExtValue());
+    std::shared_ptr<const Assignment> model;
+    ASSERT_TRUE(solver->getInitialValues(
+        Query(constraints, ConstantExpr::alloc(0, Expr::Bool)), model));
+    EXPECT_EQ(42u, model->getValue(cast<ReadExpr>(read)->updates.root, 0));
+
+    // a different query is not answered from the cache
+    ASSERT_TRUE(solver->mustBeTrue(
+        Query(constraints,
+              UltExpr::create(ConstantExpr::alloc(4, Expr::Int8), read)),
+        result));
+    delete solver;
+  }
+  EXPECT_EQ(1u, secondCalls);
+
+  llvm::sys::fs::remove(path);
+}
+
+TEST(SolverTest, PersistentCacheIsSharedRightAway) {
+  llvm::SmallString<128> path;
+  ASSERT_FALSE(llvm::sys::fs::createTemporaryFile("query-cache", "sqlite",
+                                                  path));
+
+  // two workers of a parallel run use the database at the same time
+  unsigned firstCalls = 0, secondCalls = 0;
+  Solver *first = createPersistentCachingSolver(
+      new Solver(new CountingSolver(firstCalls)), path.str().str());
+  Solver *second = createPersistentCachingSolver(
+      new Solver(new CountingSolver(secondCalls)), path.str().str());
+
+  const Array *array = ac.CreateArray("shared", 1);
+  ref<Expr> read = Expr::createTempRead(array, Expr::Int8);
+  ConstraintSet constraints(
+      {EqExpr::create(ConstantExpr::alloc(7, Expr::Int8), read)});
+  ref<Expr> expr = UltExpr::create(ConstantExpr::alloc(3, Expr::Int8), read);
+
+  bool result;
+  ASSERT_TRUE(first->mustBeTrue(Query(constraints, expr), result));
+  ASSERT_TRUE(second->mustBeTrue(Query(constraints, expr), result));
+  EXPECT_EQ(1u, firstCalls);
+  EXPECT_EQ(0u, secondCalls);
+
+  // and neither keeps the other from writing
+  ref<ConstantExpr> value;
+  ASSERT_TRUE(second->getValue(Query(constraints, read), value));
+  ASSERT_TRUE(first->getValue(Query(constraints, read), value));
+  EXPECT_EQ(1u, firstCalls);
+  EXPECT_EQ(1u, secondCalls);
+
+  delete first;
+  delete second;
+  llvm::sys::fs::remove(path);
+}
+
+/// Takes a while to answer truth queries.
+class SlowSolver : public CountingSolver {
+public:
+  using CountingSolver::CountingSolver;
+
+  bool computeTruth(const Query &query, bool &isValid) override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    return CountingSolver::computeTruth(query, isValid);
+  }
+};
+
+TEST(SolverTest, ProfilingSolverChargesLayers) {
+  unsigned calls = 0;
+  SolverLayerTimes times;
+  Solver *solver = createProfilingSolver(
+      new Solver(new SlowSolver(calls)), SolverLayerTimes::Core, times);
+  solver = createProfilingSolver(createCachingSolver(solver),
+                                 SolverLayerTimes::Caching, times);
+
+  const Array *array = ac.CreateArray("profiled", 1);
+  ref<Expr> read = Expr::createTempRead(array, Expr::Int8);
+  ref<Expr> expr = UltExpr::create(read, ConstantExpr::alloc(5, Expr::Int8));
+  ConstraintSet constraints;
+  bool result;
+  ASSERT_TRUE(solver->mustBeTrue(Query(constraints, expr), result));
+  EXPECT_GE(times.times[SolverLayerTimes::Core], time::milliseconds(20));
+  EXPECT_LT(times.times[SolverLayerTimes::Caching], time::milliseconds(20));
+
+  // answered by the cache
+  const time::Span core = times.times[SolverLayerTimes::Core];
+  ASSERT_TRUE(solver->mustBeTrue(Query(constraints, expr), result));
+  EXPECT_EQ(1u, calls);
+  EXPECT_EQ(core, times.times[SolverLayerTimes::Core]);
+  EXPECT_EQ(time::Span(), times.times[SolverLayerTimes::Independent]);
+  delete solver;
+}
+
 }
@@ -0,0 +1,80 @@
+//===-- SolverWorkerPoolTest.cpp ------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "Solver/SolverWorkerPool.h"
+
+#include <csignal>
+#include <string>
+
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+
+// Replies with the pid of the worker followed by the request, and
+// misbehaves on some requests.
+bool handle(const std::string &request, std::string &reply) {
+  if (request == "fail")
+    return false;
+  if (request == "crash")
+    raise(SIGKILL);
+  if (request == "hang")
+    pause();
+  reply = std::to_string(getpid()) + ":" + request;
+  return true;
+}
+
+std::string workerOf(const std::string &reply) {
+  return reply.substr(0, reply.find(':'));
+}
+
+TEST(SolverWorkerPoolTest, AnswersRequests) {
+  SolverWorkerPool pool(handle, 0);
+  ASSERT_TRUE(pool.isOwner());
+
+  std::string first, reply;
+  ASSERT_EQ(SolverWorkerPool::Success, pool.run("a", first, time::Span()));
+  EXPECT_EQ(":a", first.substr(first.find(':')));
+  EXPECT_NE(std::to_string(getpid()), workerOf(first));
+
+  // larger than any pipe or fixed buffer
+  std::string large(8 << 20, 'x');
+  ASSERT_EQ(SolverWorkerPool::Success, pool.run(large, reply, time::Span()));
+  EXPECT_EQ(workerOf(first).size() + 1 + large.size(), reply.size());
+  EXPECT_EQ(workerOf(first), workerOf(reply));
+
+  EXPECT_EQ(SolverWorkerPool::Failed, pool.run("fail", reply, time::Span()));
+  ASSERT_EQ(SolverWorkerPool::Success, pool.run("b", reply, time::Span()));
+  EXPECT_EQ(workerOf(first), workerOf(reply));
+}
+
+TEST(SolverWorkerPoolTest, ReplacesWorkers) {
+  SolverWorkerPool pool(handle, 2);
+
+  std::string first, reply;
+  ASSERT_EQ(SolverWorkerPool::Success, pool.run("a", first, time::Span()));
+  ASSERT_EQ(SolverWorkerPool::Success, pool.run("b", reply, time::Span()));
+  EXPECT_EQ(workerOf(first), workerOf(reply));
+  // recycled after two queries
+  ASSERT_EQ(SolverWorkerPool::Success, pool.run("c", reply, time::Span()));
+  EXPECT_NE(workerOf(first), workerOf(reply));
+
+  EXPECT_EQ(SolverWorkerPool::Crashed, pool.run("crash", reply, time::Span()));
+  ASSERT_EQ(SolverWorkerPool::Success, pool.run("d", reply, time::Span()));
+  EXPECT_EQ(":d", reply.substr(reply.find(':')));
+
+  EXPECT_EQ(SolverWorkerPool::Timeout,
+            pool.run("hang", reply, time::milliseconds(100)));
+  ASSERT_EQ(SolverWorkerPool::Success, pool.run("e", reply, time::Span()));
+  EXPECT_EQ(":e", reply.substr(reply.find(':')));
+}
+} // namespace
@@ -14,10 +14,12 @@
 
 #include "gtest/gtest.h"
 
+#include "Solver/Z3Solver.h"
 #include "klee/Expr/ArrayCache.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverStats.h"
 
 using namespace klee;
 
@@ -69,3 +71,100 @@ TEST_F(Z3SolverTest, GetConstraintLog) {
   ASSERT_STRNE(Occurence, nullptr);
   free(ConstraintsString);
 }
+
+TEST(Z3IncrementalSolverTest, SharedPrefixes) {
+  // two solvers and a tiny construct cache, so that the queries below pop
+  // scopes, recycle solvers and evict translated expressions
+  Z3Solver Solver(/*incrementalSolvers=*/2, /*constructCacheSize=*/4);
+  Solver.setCoreSolverTimeout(time::Span("10s"));
+
+  const Array *Arr = AC.CreateArray("arr", 4);
+  UpdateList UL(Arr, nullptr);
+  auto Byte = [&UL](uint64_t Index) {
+    return ReadExpr::alloc(UL, ConstantExpr::alloc(Index, Expr::Int32));
+  };
+  auto Const = [](uint64_t Value) {
+    return ConstantExpr::alloc(Value, Expr::Int8);
+  };
+
+  ref<Expr> Above10 = UltExpr::alloc(Const(10), Byte(0));
+  ref<Expr> Below20 = UltExpr::alloc(Byte(0), Const(20));
+  ref<Expr> Equal01 = EqExpr::alloc(Byte(0), Byte(1));
+  ConstraintSet Range({Above10, Below20});
+  ConstraintSet RangeEqual({Above10, Below20, Equal01});
+  ConstraintSet Lower({Above10});
+  ConstraintSet Other({EqExpr::alloc(Byte(2), Const(3))});
+  ConstraintSet Third({EqExpr::alloc(Byte(3), Const(7))});
+
+  bool Result;
+  ASSERT_TRUE(Solver.mayBeTrue(
+      Query(Range, EqExpr::alloc(Byte(0), Const(15))), Result));
+  EXPECT_TRUE(Result);
+  ASSERT_TRUE(Solver.mustBeTrue(
+      Query(RangeEqual, UltExpr::alloc(Const(10), Byte(1))), Result));
+  EXPECT_TRUE(Result);
+  // a shorter prefix of the same lineage
+  ASSERT_TRUE(Solver.mayBeTrue(
+      Query(Lower, EqExpr::alloc(Byte(0), Const(200))), Result));
+  EXPECT_TRUE(Result);
+
+  ref<ConstantExpr> Value;
+  ASSERT_TRUE(Solver.getValue(Query(Other, Byte(2)), Value));
+  EXPECT_EQ(3u, Value->getZExtValue());
+  // more lineages than solvers
+  ASSERT_TRUE(Solver.getValue(Query(Third, Byte(3)), Value));
+  EXPECT_EQ(7u, Value->getZExtValue());
+
+  ASSERT_TRUE(Solver.mayBeTrue(
+      Query(Range, EqExpr::alloc(Byte(0), Const(25))), Result));
+  EXPECT_FALSE(Result);
+  ASSERT_TRUE(Solver.mustBeFalse(
+      Query(RangeEqual, EqExpr::alloc(Byte(1), Const(30))), Result));
+  EXPECT_TRUE(Result);
+}
+
+TEST(PortfolioSolverTest, RacesSlowQueries) {
+  // with a 1ms threshold factoring a semiprime outlasts the primary, so
+  // both racers run and either may answer
+  Solver *Portfolio = createPortfolioSolver(
+      new Z3Solver(), Z3_SOLVER, new Z3Solver(), Z3_SOLVER,
+      time::Span("1ms"));
+  Portfolio->setCoreSolverTimeout(time::Span("10s"));
+
+  const Array *Factors = AC.CreateArray("factors", 4);
+  UpdateList UL(Factors, nullptr);
+  auto Factor = [&UL](unsigned Offset) {
+    return ZExtExpr::create(
+        ConcatExpr::create(
+            ReadExpr::alloc(UL, ConstantExpr::alloc(Offset + 1, Expr::Int32)),
+            ReadExpr::alloc(UL, ConstantExpr::alloc(Offset, Expr::Int32))),
+        Expr::Int32);
+  };
+  ref<Expr> X = Factor(0), Y = Factor(2);
+  ref<Expr> One = ConstantExpr::alloc(1, Expr::Int32);
+  ConstraintSet Constraints(
+      {UltExpr::create(One, X), UleExpr::create(X, Y),
+       EqExpr::create(MulExpr::create(X, Y),
+                      ConstantExpr::alloc(251 * 241, Expr::Int32))});
+
+  uint64_t Races = stats::queryPortfolioRaces;
+  ref<ConstantExpr> Value;
+  ASSERT_TRUE(Portfolio->getValue(Query(Constraints, X), Value));
+  EXPECT_EQ(241u, Value->getZExtValue());
+  EXPECT_EQ(Races + 1, stats::queryPortfolioRaces.getValue());
+  EXPECT_EQ(stats::queryPortfolioRaces.getValue(),
+            stats::queryPortfolioWinsZ3.getValue());
+
+  bool Result;
+  ASSERT_TRUE(Portfolio->mustBeTrue(
+      Query(Constraints, EqExpr::create(Y, ConstantExpr::alloc(251, Expr::Int32))),
+      Result));
+  EXPECT_TRUE(Result);
+
+  std::shared_ptr<const Assignment> Model;
+  ASSERT_TRUE(Portfolio->getInitialValues(
+      Query(Constraints, ConstantExpr::alloc(0, Expr::Bool)), Model));
+  EXPECT_TRUE(Model->satisfies(Constraints.begin(), Constraints.end()));
+
+  delete Portfolio;
+}
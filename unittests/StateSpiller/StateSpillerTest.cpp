@@ -0,0 +1,154 @@
+//===-- StateSpillerTest.cpp ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+#define KLEE_UNITTEST
+
+#include "gtest/gtest.h"
+
+#include "Core/AddressSpace.h"
+#include "Core/Context.h"
+#include "Core/ExecutionState.h"
+#include "Core/Memory.h"
+#include "Core/MemoryManager.h"
+#include "Core/StateSpiller.h"
+#include "klee/Expr/ArrayCache.h"
+
+#include <fstream>
+
+using namespace klee;
+
+namespace {
+
+class StateSpillerTest : public ::testing::Test {
+protected:
+  static void SetUpTestCase() { Context::initialize(true, Expr::Int64); }
+};
+
+TEST_F(StateSpillerTest, SuspendAndResume) {
+  ArrayCache arrayCache;
+  MemoryManager memory(&arrayCache);
+  const Array *array = arrayCache.CreateArray("arr", 8);
+  ref<Expr> byte = ReadExpr::create(UpdateList(array, nullptr),
+                                    ConstantExpr::alloc(0, Expr::Int32));
+
+  ExecutionState state;
+  MemoryObject *concrete = memory.allocate(16, false, true, nullptr, 8);
+  ObjectState *os = new ObjectState(concrete);
+  os->initializeToZero();
+  os->write(0, KValue(byte));
+  os->write(8, KValue(ConstantExpr::alloc(concrete->segment, Expr::Int64),
+                      ConstantExpr::alloc(4, Expr::Int64)));
+  state.addressSpace.bindObject(concrete, os);
+
+  MemoryObject *symbolic = memory.allocate(8, false, true, nullptr, 8);
+  ObjectState *sos = new ObjectState(symbolic, array);
+  sos->write(2, KValue(AddExpr::create(byte, ConstantExpr::alloc(1, Expr::Int8))));
+  state.addressSpace.bindObject(symbolic, sos);
+
+  ref<Expr> constraint = UltExpr::create(byte, ConstantExpr::alloc(10, Expr::Int8));
+  state.addConstraint(constraint);
+  state.nondetValues.emplace_back(KValue(byte), true, nullptr, "nondet");
+
+  std::vector<KValue> expected;
+  for (unsigned i = 0; i < 16; ++i)
+    expected.push_back(os->read8(i));
+  for (unsigned i = 0; i < 8; ++i)
+    expected.push_back(sos->read8(i));
+
+  StateSpiller spiller(testing::TempDir() + "/klee-spill-test");
+  ASSERT_TRUE(spiller.suspend(state));
+  EXPECT_TRUE(spiller.isSuspended(state));
+  EXPECT_TRUE(state.constraints.empty());
+  EXPECT_TRUE(state.nondetValues.empty());
+  EXPECT_EQ(state.addressSpace.findObject(concrete), nullptr);
+  EXPECT_EQ(state.getOwnedBytes(), 0u);
+
+  EXPECT_TRUE(spiller.resume(state));
+  EXPECT_FALSE(spiller.isSuspended(state));
+  ASSERT_EQ(state.constraints.size(), 1u);
+  EXPECT_EQ(*state.constraints.begin(), constraint);
+  ASSERT_EQ(state.nondetValues.size(), 1u);
+  EXPECT_EQ(state.nondetValues[0].value.getValue(), byte);
+  EXPECT_EQ(state.nondetValues[0].name, "nondet");
+
+  const ObjectState *restored = state.addressSpace.findObject(concrete);
+  const ObjectState *restoredSymbolic = state.addressSpace.findObject(symbolic);
+  ASSERT_NE(restored, nullptr);
+  ASSERT_NE(restoredSymbolic, nullptr);
+  std::vector<KValue> actual;
+  for (unsigned i = 0; i < 16; ++i)
+    actual.push_back(restored->read8(i));
+  for (unsigned i = 0; i < 8; ++i)
+    actual.push_back(restoredSymbolic->read8(i));
+  for (unsigned i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(actual[i].getSegment(), expected[i].getSegment()) << i;
+    EXPECT_EQ(actual[i].getValue(), expected[i].getValue()) << i;
+  }
+}
+
+TEST_F(StateSpillerTest, SharedObjectsStayBound) {
+  ArrayCache arrayCache;
+  MemoryManager memory(&arrayCache);
+
+  ExecutionState state;
+  MemoryObject *shared = memory.allocate(8, false, true, nullptr, 8);
+  ObjectState *os = new ObjectState(shared);
+  os->initializeToZero();
+  state.addressSpace.bindObject(shared, os);
+  ExecutionState sibling(state);
+
+  MemoryObject *owned = memory.allocate(8, false, true, nullptr, 8);
+  ObjectState *oos = new ObjectState(owned);
+  oos->initializeToZero();
+  state.addressSpace.bindObject(owned, oos);
+  uint64_t ownedBytes = state.getOwnedBytes();
+
+  StateSpiller spiller(testing::TempDir() + "/klee-spill-test");
+  ASSERT_TRUE(spiller.suspend(state));
+  EXPECT_EQ(state.addressSpace.findObject(shared), os);
+  EXPECT_EQ(state.addressSpace.findObject(owned), nullptr);
+
+  EXPECT_TRUE(spiller.resume(state));
+  EXPECT_EQ(state.addressSpace.findObject(shared), os);
+  EXPECT_EQ(sibling.addressSpace.findObject(shared), os);
+  ASSERT_NE(state.addressSpace.findObject(owned), nullptr);
+  EXPECT_EQ(state.getOwnedBytes(), ownedBytes);
+}
+
+TEST_F(StateSpillerTest, TruncatedFileIsNotResumed) {
+  ArrayCache arrayCache;
+  MemoryManager memory(&arrayCache);
+  const Array *array = arrayCache.CreateArray("arr", 8);
+
+  ExecutionState state;
+  MemoryObject *mo = memory.allocate(8, false, true, nullptr, 8);
+  state.addressSpace.bindObject(mo, new ObjectState(mo, array));
+  state.addConstraint(UltExpr::create(
+      ReadExpr::create(UpdateList(array, nullptr),
+                       ConstantExpr::alloc(0, Expr::Int32)),
+      ConstantExpr::alloc(10, Expr::Int8)));
+
+  std::string directory = testing::TempDir() + "/klee-spill-test";
+  StateSpiller spiller(directory);
+  ASSERT_TRUE(spiller.suspend(state));
+
+  std::string path =
+      directory + "/state" + std::to_string(state.getID()) + ".spill";
+  std::ifstream in(path, std::ios::binary);
+  std::string contents((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+  in.close();
+  ASSERT_GT(contents.size(), 16u);
+  std::ofstream(path, std::ios::binary | std::ios::trunc)
+      .write(contents.data(), contents.size() / 2);
+
+  EXPECT_FALSE(spiller.resume(state));
+  EXPECT_FALSE(spiller.isSuspended(state));
+}
+
+} // namespace
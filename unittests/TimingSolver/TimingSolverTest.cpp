@@ -0,0 +1,170 @@
+//===-- TimingSolverTest.cpp ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "Core/TimingSolver.h"
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Statistics/Statistics.h"
+#include "klee/Solver/SolverCmdLine.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/Solver/SolverImpl.h"
+
+using namespace klee;
+
+namespace {
+
+/// Forwards queries to another solver and counts them.
+class CountingSolver : public SolverImpl {
+  std::unique_ptr<Solver> solver;
+
+public:
+  unsigned &calls;
+  CountingSolver(Solver *solver, unsigned &calls)
+      : solver(solver), calls(calls) {}
+
+  bool computeValidity(const Query &query, Solver::Validity &result) override {
+    ++calls;
+    return solver->impl->computeValidity(query, result);
+  }
+  bool computeTruth(const Query &query, bool &isValid) override {
+    ++calls;
+    return solver->impl->computeTruth(query, isValid);
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) override {
+    ++calls;
+    return solver->impl->computeValue(query, result);
+  }
+  bool computeInitialValues(const Query &query,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution) override {
+    ++calls;
+    return solver->impl->computeInitialValues(query, result, hasSolution);
+  }
+  SolverRunStatus getOperationStatusCode() override {
+    return solver->impl->getOperationStatusCode();
+  }
+};
+
+TEST(TimingSolverTest, AnswersFromStateModel) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("x", 1);
+  ref<Expr> x = Expr::createTempRead(array, Expr::Int8);
+  auto constant = [](uint64_t value) {
+    return ConstantExpr::alloc(value, Expr::Int8);
+  };
+
+  unsigned calls = 0;
+  TimingSolver solver(
+      new Solver(new CountingSolver(createCoreSolver(CoreSolverToUse), calls)),
+      /* simplifyExprs= */ true, /* useStateModel= */ true);
+  ConstraintSet constraints;
+  ConstraintManager cm(constraints);
+  cm.addConstraint(UltExpr::create(x, constant(10)));
+  SolverQueryMetaData metaData;
+  const uint64_t hits = theStatisticManager->getValue(stats::queryModelHits);
+
+  // without a model, a validity query is a single query and yields none
+  Solver::Validity validity;
+  ASSERT_TRUE(solver.evaluate(constraints, UltExpr::create(x, constant(5)),
+                              validity, metaData));
+  EXPECT_EQ(Solver::Unknown, validity);
+  EXPECT_EQ(1u, calls);
+
+  // the counterexample of a truth query becomes the model
+  bool result = true;
+  ASSERT_TRUE(solver.mustBeTrue(constraints, UltExpr::create(x, constant(5)),
+                                result, metaData));
+  EXPECT_FALSE(result);
+  EXPECT_EQ(2u, calls);
+
+  // decided by the model
+  ref<ConstantExpr> value;
+  ASSERT_TRUE(solver.getValue(constraints, x, value, metaData));
+  EXPECT_GE(value->getZExtValue(), 5u);
+  EXPECT_LT(value->getZExtValue(), 10u);
+  ASSERT_TRUE(
+      solver.mayBeTrue(constraints, EqExpr::create(value, x), result, metaData));
+  EXPECT_TRUE(result);
+  result = true;
+  ASSERT_TRUE(solver.mustBeTrue(constraints,
+                                Expr::createIsZero(EqExpr::create(value, x)),
+                                result, metaData));
+  EXPECT_FALSE(result);
+  EXPECT_EQ(2u, calls);
+  EXPECT_EQ(hits + 3, theStatisticManager->getValue(stats::queryModelHits));
+
+  // the model leaves a single query for a validity query, which it does
+  // not decide on its own
+  ASSERT_TRUE(solver.evaluate(constraints, UltExpr::create(x, constant(7)),
+                              validity, metaData));
+  EXPECT_EQ(Solver::Unknown, validity);
+  EXPECT_EQ(3u, calls);
+  EXPECT_EQ(hits + 3, theStatisticManager->getValue(stats::queryModelHits));
+
+  // a model violating a new constraint is dropped
+  ASSERT_TRUE(solver.getValue(constraints, x, value, metaData));
+  EXPECT_EQ(3u, calls);
+  cm.addConstraint(Expr::createIsZero(EqExpr::create(value, x)));
+  ref<ConstantExpr> other;
+  ASSERT_TRUE(solver.getValue(constraints, x, other, metaData));
+  EXPECT_EQ(4u, calls);
+  EXPECT_NE(value->getZExtValue(), other->getZExtValue());
+
+  // a query the model does not decide goes to the solver
+  ASSERT_TRUE(solver.mayBeTrue(constraints, EqExpr::create(constant(12), x),
+                               result, metaData));
+  EXPECT_FALSE(result);
+  EXPECT_EQ(5u, calls);
+
+  // without a model, a value only needs the factor of its expression
+  SolverQueryMetaData fresh;
+  ASSERT_TRUE(solver.getValue(constraints, x, other, fresh));
+  EXPECT_EQ(6u, calls);
+  ASSERT_TRUE(solver.getValue(constraints, x, other, fresh));
+  EXPECT_EQ(7u, calls);
+}
+
+TEST(TimingSolverTest, CachesCounterexampleQueries) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("y", 1);
+  ref<Expr> y = Expr::createTempRead(array, Expr::Int8);
+
+  unsigned calls = 0;
+  TimingSolver solver(
+      createCachingSolver(new Solver(
+          new CountingSolver(createCoreSolver(CoreSolverToUse), calls))),
+      /* simplifyExprs= */ true, /* useStateModel= */ true);
+  ConstraintSet constraints;
+  ConstraintManager cm(constraints);
+  cm.addConstraint(UltExpr::create(y, ConstantExpr::alloc(10, Expr::Int8)));
+
+  // a valid query has no counterexample, which the cache remembers
+  ref<Expr> valid = UltExpr::create(y, ConstantExpr::alloc(20, Expr::Int8));
+  bool result = false;
+  for (unsigned i = 0; i != 2; ++i) {
+    SolverQueryMetaData metaData;
+    ASSERT_TRUE(solver.mustBeTrue(constraints, valid, result, metaData));
+    EXPECT_TRUE(result);
+  }
+  EXPECT_EQ(1u, calls);
+
+  // a counterexample decides later truth queries of the cache as well
+  ref<Expr> invalid = UltExpr::create(y, ConstantExpr::alloc(5, Expr::Int8));
+  SolverQueryMetaData metaData;
+  ASSERT_TRUE(solver.mustBeTrue(constraints, invalid, result, metaData));
+  EXPECT_FALSE(result);
+  EXPECT_EQ(2u, calls);
+  ASSERT_TRUE(solver.solver->mustBeTrue(Query(constraints, invalid), result));
+  EXPECT_FALSE(result);
+  EXPECT_EQ(2u, calls);
+}
+
+} // namespace